@@ -27,9 +27,12 @@
 @interface SRKEventBlockHolder : NSObject
 
 @property (nonatomic, copy) SRKEventRegistrationBlock    block;
+@property (nonatomic, copy) SRKEventBatchBlock           batchBlock;
 @property int                                           events;
 @property BOOL                                          useMainThread;
 @property BOOL                                          updateSelf;
-@property (strong) SRKEvent*                             tempEvent;
+@property (strong) dispatch_queue_t                     queue;
+
+- (void)dispatchEvent:(SRKEvent*)event;
 
 @end
@@ -22,7 +22,138 @@
 
 
 #import "SRKEventBlockHolder.h"
+#import "SRKGlobals.h"
+#import "SRKEntity+Private.h"
 
-@implementation SRKEventBlockHolder
+/*
+ *  event delivery, the thread raising an event never waits for the block.  Events are queued onto the block's own serial queue, the main queue or a queue it was
+ *  registered with.  With a coalescing window set, events are held for the window and repeats for the same object or table are merged before being delivered together.
+ */
+
+@implementation SRKEventBlockHolder {
+    NSMutableArray*         pendingEvents;
+    NSMutableDictionary*    pendingTargets;
+}
+
+- (dispatch_queue_t)deliveryQueue {
+    
+    @synchronized (self) {
+        if (!self.queue) {
+            // a queue per block keeps its events in order, without one slow block holding up the others
+            self.queue = self.useMainThread ? dispatch_get_main_queue() : dispatch_queue_create("SharkORM.events", DISPATCH_QUEUE_SERIAL);
+        }
+        return self.queue;
+    }
+    
+}
+
+- (void)deliverEvents:(NSArray<SRKEvent*>*)events {
+    
+    if (self.batchBlock) {
+        self.batchBlock(events);
+    }
+    
+    if (self.block) {
+        for (SRKEvent* e in events) {
+            self.block(e);
+        }
+    }
+    
+}
+
+- (SRKEvent*)eventForDelivery:(SRKEvent*)event {
+    
+    if (!event.entity.threadConfined) {
+        return event;
+    }
+    
+    // a thread confined object can only be read on the thread that raised the event, so the block is given an unconfined copy taken here instead
+    SRKEntity* entity = [event.entity copy];
+    entity.threadConfined = NO;
+    
+    SRKEvent* delivered = [SRKEvent new];
+    delivered.event = event.event;
+    delivered.entity = entity;
+    delivered.entityClass = event.entityClass;
+    delivered.affectedRows = event.affectedRows;
+    delivered.changedProperties = event.changedProperties;
+    
+    return delivered;
+    
+}
+
+- (void)dispatchEvent:(SRKEvent*)event {
+    
+    double window = [[SRKGlobals sharedObject] settings].eventCoalescingWindow;
+    dispatch_queue_t queue = [self deliveryQueue];
+    
+    if (window <= 0) {
+        
+        if (queue == dispatch_get_main_queue() && [NSThread isMainThread]) {
+            // already on the main thread, so delivering it now holds nobody else up
+            [self deliverEvents:@[event]];
+        } else {
+            SRKEvent* delivered = [self eventForDelivery:event];
+            dispatch_async(queue, ^{
+                [self deliverEvents:@[delivered]];
+            });
+        }
+        return;
+        
+    }
+    
+    @synchronized (self) {
+        
+        if (!pendingEvents) {
+            
+            pendingEvents = [NSMutableArray new];
+            pendingTargets = [NSMutableDictionary new];
+            
+            dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(window * NSEC_PER_SEC)), queue, ^{
+                NSArray* events = nil;
+                @synchronized (self) {
+                    events = self->pendingEvents;
+                    self->pendingEvents = nil;
+                    self->pendingTargets = nil;
+                }
+                [self deliverEvents:events];
+            });
+            
+        }
+        
+        id target = event.entity ? [NSValue valueWithNonretainedObject:event.entity] : (event.entityClass ? (id)[event.entityClass description] : [NSNull null]);
+        SRKEvent* last = [pendingTargets objectForKey:target];
+        
+        if (last && last.event == event.event) {
+            
+            // the same thing happening again to the same object or table, so it is folded into the event that is already waiting
+            if (event.entity.threadConfined) {
+                last.entity = [self eventForDelivery:event].entity;
+            }
+            last.affectedRows += event.affectedRows;
+            if (event.changedProperties.count) {
+                NSMutableOrderedSet* properties = [NSMutableOrderedSet orderedSetWithArray:last.changedProperties ?: @[]];
+                [properties addObjectsFromArray:event.changedProperties];
+                last.changedProperties = properties.array;
+            }
+            
+        } else {
+            
+            // the same event object goes to every block that is interested in it, so a copy is held for merging into
+            SRKEvent* pending = [SRKEvent new];
+            pending.event = event.event;
+            pending.entity = [self eventForDelivery:event].entity;
+            pending.entityClass = event.entityClass;
+            pending.affectedRows = event.affectedRows;
+            pending.changedProperties = event.changedProperties;
+            
+            [pendingEvents addObject:pending];
+            [pendingTargets setObject:pending forKey:target];
+            
+        }
+        
+    }
+    
+}
 
 @end
@@ -52,11 +52,6 @@
 	return self;
 }
 
-- (void)executeEventBlock:(SRKEventBlockHolder*)block {
-	block.block(block.tempEvent);
-	block.tempEvent = nil;
-}
-
 - (void)triggerInternalEvent:(SRKEvent*)e {
 	
 	if (self.delegate && [self.delegate conformsToProtocol:@protocol(SRKEventDelegate)]) {
@@ -67,12 +62,7 @@
 	for (SRKEventBlockHolder* bh in registeredEventBlocks) {
 		if (bh.events & e.event) {
 			/* this bit is set */
-			bh.tempEvent = e;
-			if (bh.useMainThread) {
-				[self performSelectorOnMainThread:@selector(executeEventBlock:) withObject:bh waitUntilDone:YES];
-			} else {
-				[self performSelectorInBackground:@selector(executeEventBlock:) withObject:bh];
-			}
+			[bh dispatchEvent:e];
 		}
 	}
 	
@@ -89,6 +79,28 @@
 
 }
 
+- (void)registerBlockForEvents:(enum SharkORMEvent)events withBlock:(SRKEventRegistrationBlock)block onQueue:(dispatch_queue_t)queue {
+	
+	SRKEventBlockHolder* bh = [SRKEventBlockHolder new];
+	bh.events = events;
+	bh.block = block;
+	bh.queue = queue;
+	
+	[registeredEventBlocks addObject:bh];
+	
+}
+
+- (void)registerBlockForEvents:(enum SharkORMEvent)events withBatchBlock:(SRKEventBatchBlock)block onQueue:(dispatch_queue_t)queue {
+	
+	SRKEventBlockHolder* bh = [SRKEventBlockHolder new];
+	bh.events = events;
+	bh.batchBlock = block;
+	bh.queue = queue;
+	
+	[registeredEventBlocks addObject:bh];
+	
+}
+
 - (void)clearAllRegisteredBlocks {
 	registeredEventBlocks = [NSMutableArray new];
 }
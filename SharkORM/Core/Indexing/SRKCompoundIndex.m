@@ -40,6 +40,25 @@
     for (SRKIndexProperty *indexProperty in [self indexProperties]) {
         indexName = [indexName stringByAppendingString:[NSString stringWithFormat:@"_%@_%@", indexProperty.name, [indexProperty getSortOrderIndexName]]];
     }
+    
+    /* plain indexes keep their original names, the variants get a suffix so they can sit alongside a plain index on the same columns */
+    if (self.includedProperties.count) {
+        indexName = [indexName stringByAppendingFormat:@"_inc_%@", [self.includedProperties componentsJoinedByString:@"_"]];
+    }
+    if (self.condition.length) {
+        
+        /* FNV-1a of the condition, NSString's hash is not guaranteed to be stable between releases */
+        uint32_t h = 2166136261u;
+        for (const char* c = self.condition.UTF8String; *c; c++) {
+            h = (h ^ (uint8_t)*c) * 16777619u;
+        }
+        indexName = [indexName stringByAppendingFormat:@"_where_%08x", h];
+        
+    }
+    if (self.unique) {
+        indexName = [indexName stringByAppendingString:@"_unique"];
+    }
+    
     return indexName;
 }
 
@@ -48,7 +67,13 @@
     NSString* delim = @"";
     
     for (SRKIndexProperty *indexProperty in [self indexProperties]) {
-        propertyString = [propertyString stringByAppendingString:[NSString stringWithFormat:@"%@%@ %@", delim, indexProperty.name,[indexProperty getSortOrderString]]];
+        propertyString = [propertyString stringByAppendingString:[NSString stringWithFormat:@"%@%@ %@", delim, indexProperty.expression ? indexProperty.expression : indexProperty.name,[indexProperty getSortOrderString]]];
+        delim = @", ";
+    }
+    
+    /* SQLite has no INCLUDE clause, so covered columns are added on to the end of the key */
+    for (NSString* included in self.includedProperties) {
+        propertyString = [propertyString stringByAppendingString:[NSString stringWithFormat:@"%@%@", delim, included]];
         delim = @", ";
     }
     
@@ -57,6 +82,15 @@
     return propertyString;
 }
 
+-(NSString*) getCreateStatementForTable:(NSString*)tableName {
+    NSString* execSql = [NSString stringWithFormat:@"CREATE %@INDEX %@ ON %@ %@", self.unique ? @"UNIQUE " : @"", [self getIndexName], tableName, [self getPropertyString]];
+    if (self.condition.length) {
+        execSql = [execSql stringByAppendingFormat:@" WHERE %@", self.condition];
+    }
+    execSql = [execSql stringByAppendingString:@";"];
+    return [execSql stringByReplacingOccurrencesOfString:@"*tablename" withString:tableName];
+}
+
 
 - (BOOL) isEqual:(id)object {
     if (object == self) {
@@ -77,6 +77,38 @@
     
 }
 
+- (SRKIndexDefinition*)addIndexWithProperties:(NSArray<SRKIndexProperty*>*)properties include:(NSArray<NSString*>*)includedProperties where:(NSString*)condition unique:(BOOL)unique {
+    
+    NSAssert(!(unique && includedProperties.count), @"Included properties would become part of the unique key, they cannot be used with a unique index");
+    
+    if (!_components) {
+        _components = [NSMutableArray new];
+    }
+    
+    SRKCompoundIndex *index = [[SRKCompoundIndex alloc] initWithProperties:properties];
+    index.includedProperties = includedProperties.count ? includedProperties : nil;
+    index.condition = condition.length ? condition : nil;
+    index.unique = unique;
+    
+    if (![_components containsObject:index]) {
+        [_components addObject:index];
+    }
+    
+    return self;
+    
+}
+
+- (SRKIndexDefinition*)addUnique:(NSArray<NSString*>*)properties {
+    
+    NSMutableArray* indexProperties = [NSMutableArray new];
+    for (NSString* property in properties) {
+        [indexProperties addObject:[[SRKIndexProperty alloc] initWithName:property andOrder:SRKIndexSortOrderAscending]];
+    }
+    
+    return [self addIndexWithProperties:indexProperties include:nil where:nil unique:YES];
+    
+}
+
 - (SRKIndexDefinition*)add:(NSString*)property order:(enum SRKIndexSortOrder)order {
     
     SRKIndexProperty * newProperty = [[SRKIndexProperty alloc] initWithName:property andOrder:order];
@@ -104,15 +136,101 @@
     
 }
 
+- (SRKIndexDefinition*)addSpatialIndexForLatitude:(NSString*)latitudeProperty longitude:(NSString*)longitudeProperty {
+    
+    if (!_spatialIndexes) {
+        _spatialIndexes = [NSMutableArray new];
+    }
+    
+    NSArray* spatial = @[latitudeProperty, longitudeProperty];
+    if (![_spatialIndexes containsObject:spatial]) {
+        [_spatialIndexes addObject:spatial];
+    }
+    
+    return self;
+    
+}
+
+- (SRKIndexDefinition*)addFullTextIndexForProperties:(NSArray<NSString*>*)properties {
+    
+    if (!_fullTextProperties) {
+        _fullTextProperties = [NSMutableArray new];
+    }
+    
+    for (NSString* property in properties) {
+        if (![_fullTextProperties containsObject:property]) {
+            [_fullTextProperties addObject:property];
+        }
+    }
+    
+    return self;
+    
+}
+
 - (void)generateIndexesForTable:(NSString*)tableName forEntity:(NSString*)entity {
     
 	for (SRKCompoundIndex* index in _components) {
-        NSString* execSql = [NSString stringWithFormat:@"CREATE INDEX %@ ON %@ %@;", [index getIndexName], tableName, [index getPropertyString]];
-        execSql = [execSql stringByReplacingOccurrencesOfString:@"*tablename" withString:tableName];
+        NSString* execSql = [index getCreateStatementForTable:tableName];
         
         [SharkSchemaManager.shared schemaAddIndexDefinitionForEntity:entity name:[[index getIndexName] stringByReplacingOccurrencesOfString:@"*tablename" withString:tableName] definition:execSql];
         
 	}
+    
+    /*
+     *  the virtual table indexes are keyed on the rowid of the entity table.  That is only stable when it is the (numeric) primary key, the implicit rowid
+     *  of a string keyed table can be renumbered by a VACUUM which would leave the index pointing at the wrong rows, and a clustered table has none at all.
+     */
+    BOOL virtualIndexes = YES;
+    if ((_spatialIndexes.count || _fullTextProperties.count) && [SharkSchemaManager.shared schemaPrimaryKeyTypeForEntity:entity] == SRK_PROPERTY_TYPE_STRING) {
+        [SharkSchemaManager.shared reportError:[NSString stringWithFormat:@"spatial and full text indexes cannot be created on %@, as it has a string primary key", entity] sql:nil];
+        virtualIndexes = NO;
+    }
+    
+    /*
+     *  spatial indexes are an R*Tree virtual table keyed on the rowid of the entity table, it is populated from the existing rows when created and then kept in step by triggers.
+     *  Points are stored as a zero area box, so the R*Tree can be used as a coarse pre-filter before the exact distancebetween() calculation.
+     *  If the linked SQLite has no R*Tree module the index is not declared, and the spatial queries fall back to a plain range over the columns.
+     */
+    for (NSArray<NSString*>* spatial in (virtualIndexes && sqlite3_compileoption_used("SQLITE_ENABLE_RTREE")) ? _spatialIndexes : nil) {
+        
+        NSString* lat = spatial[0];
+        NSString* lng = spatial[1];
+        NSString* name = [NSString stringWithFormat:SRK_SPATIAL_INDEX_NAME_FORMAT, tableName, lat, lng];
+        
+        NSMutableString* execSql = [NSMutableString new];
+        [execSql appendFormat:SRK_VIRTUAL_INDEX_DROP_FORMAT, name];
+        [execSql appendFormat:@"CREATE VIRTUAL TABLE %@ USING rtree(id, minLat, maxLat, minLng, maxLng); ", name];
+        [execSql appendFormat:@"INSERT INTO %@ SELECT rowid, %@, %@, %@, %@ FROM %@ WHERE %@ IS NOT NULL AND %@ IS NOT NULL; ", name, lat, lat, lng, lng, tableName, lat, lng];
+        [execSql appendFormat:@"CREATE TRIGGER %@_ai AFTER INSERT ON %@ WHEN new.%@ IS NOT NULL AND new.%@ IS NOT NULL BEGIN INSERT OR REPLACE INTO %@ VALUES (new.rowid, new.%@, new.%@, new.%@, new.%@); END; ", name, tableName, lat, lng, name, lat, lat, lng, lng];
+        [execSql appendFormat:@"CREATE TRIGGER %@_au AFTER UPDATE OF %@, %@ ON %@ BEGIN DELETE FROM %@ WHERE id = old.rowid; INSERT INTO %@ SELECT new.rowid, new.%@, new.%@, new.%@, new.%@ WHERE new.%@ IS NOT NULL AND new.%@ IS NOT NULL; END; ", name, lat, lng, tableName, name, name, lat, lat, lng, lng, lat, lng];
+        [execSql appendFormat:@"CREATE TRIGGER %@_ad AFTER DELETE ON %@ BEGIN DELETE FROM %@ WHERE id = old.rowid; END;", name, tableName, name];
+        
+        [SharkSchemaManager.shared schemaAddIndexDefinitionForEntity:entity name:name definition:execSql];
+        
+    }
+    
+    /*
+     *  full text indexes are an external content FTS4 table over the entity table, so the text is not stored twice.  The FTS rows must be removed before the
+     *  content row changes (FTS4 reads the old values back from the content table to find the tokens), and re-added afterwards.
+     */
+    if (virtualIndexes && _fullTextProperties.count) {
+        
+        NSString* name = [NSString stringWithFormat:SRK_FTS_INDEX_NAME_FORMAT, tableName];
+        NSString* columns = [_fullTextProperties componentsJoinedByString:@", "];
+        NSString* values = [NSString stringWithFormat:@"new.%@", [_fullTextProperties componentsJoinedByString:@", new."]];
+        
+        NSMutableString* execSql = [NSMutableString new];
+        [execSql appendFormat:SRK_VIRTUAL_INDEX_DROP_FORMAT, name];
+        [execSql appendFormat:@"CREATE VIRTUAL TABLE %@ USING fts4(content=\"%@\", %@); ", name, tableName, columns];
+        [execSql appendFormat:@"INSERT INTO %@(%@) VALUES ('rebuild'); ", name, name];
+        [execSql appendFormat:@"CREATE TRIGGER %@_bu BEFORE UPDATE OF %@ ON %@ BEGIN DELETE FROM %@ WHERE docid = old.rowid; END; ", name, columns, tableName, name];
+        [execSql appendFormat:@"CREATE TRIGGER %@_bd BEFORE DELETE ON %@ BEGIN DELETE FROM %@ WHERE docid = old.rowid; END; ", name, tableName, name];
+        [execSql appendFormat:@"CREATE TRIGGER %@_au AFTER UPDATE OF %@ ON %@ BEGIN INSERT INTO %@(docid, %@) VALUES (new.rowid, %@); END; ", name, columns, tableName, name, columns, values];
+        [execSql appendFormat:@"CREATE TRIGGER %@_ai AFTER INSERT ON %@ BEGIN INSERT INTO %@(docid, %@) VALUES (new.rowid, %@); END;", name, tableName, name, columns, values];
+        
+        [SharkSchemaManager.shared schemaAddIndexDefinitionForEntity:entity name:name definition:execSql];
+        
+    }
         
 }
 
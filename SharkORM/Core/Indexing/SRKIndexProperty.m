@@ -38,6 +38,15 @@
     return self;
 }
 
+-(id) initWithExpression:(NSString*)expression named:(NSString*)name andOrder:(enum SRKIndexSortOrder)sortOrder {
+    self = [self initWithName:name andOrder:sortOrder];
+    
+    if (self != nil) {
+        _expression = expression;
+    }
+    return self;
+}
+
 -(NSString*) getSortOrderString {
     if (_order == SRKIndexSortOrderAscending) {
         return @"asc";
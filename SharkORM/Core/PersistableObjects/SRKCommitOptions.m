@@ -21,6 +21,7 @@
 //    SOFTWARE.
 
 #import "SharkORM.h"
+#import "SRKDefinitions.h"
 
 @implementation SRKCommitOptions
 
@@ -40,6 +41,23 @@
     self.resetOptionsAfterCommit = NO;
     self.raiseErrors = YES;
     self.triggerEvents = YES;
+    self.conflictPolicy = SRKConflictPolicyFail;
+}
+
+@end
+
+@implementation SRKImportOptions
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        self.batchSize = SRK_IMPORT_DEFAULT_BATCH_SIZE;
+        self.columnMapping = nil;
+        self.conflictPolicy = SRKConflictPolicyFail;
+        self.deferIndexes = NO;
+        self.progress = nil;
+    }
+    return self;
 }
 
 @end
@@ -0,0 +1,377 @@
+//    MIT License
+//
+//    Copyright (c) 2010-2018 SharkSync
+//
+//    Permission is hereby granted, free of charge, to any person obtaining a copy
+//    of this software and associated documentation files (the "Software"), to deal
+//    in the Software without restriction, including without limitation the rights
+//    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the Software is
+//    furnished to do so, subject to the following conditions:
+//
+//    The above copyright notice and this permission notice shall be included in all
+//    copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//    SOFTWARE.
+
+
+
+#import "SRKCommitPlanner.h"
+#import "SRKEntityChain.h"
+#import "SharkORM+Private.h"
+#import "SRKEntity+Private.h"
+#import "SRKTransaction+Private.h"
+#import "SharkSchemaManager.h"
+#import "SRKRegistry.h"
+#import "SRKUtilities.h"
+#import "SRKDefinitions.h"
+
+@interface SRKCommitPlanner ()
+
+@property SRKEntityChain* chain;
+@property NSMapTable* levelForEntity;
+@property NSMutableArray* levels;
+@property NSHashTable* committed;
+@property NSMutableDictionary* relationshipCache;
+@property NSMapTable* deferredRelationships;
+@property NSMapTable* eventTypes;
+@property NSHashTable* vetoed;
+@property NSMutableArray* inserted;
+@property NSMutableArray* updated;
+
+@end
+
+@implementation SRKCommitPlanner
+
+- (instancetype)initWithEntities:(NSArray<SRKEntity*>*)entities {
+    self = [super init];
+    if (self) {
+        self.chain = [SRKEntityChain new];
+        self.levelForEntity = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
+        self.levels = [NSMutableArray new];
+        self.committed = [[NSHashTable alloc] initWithOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality capacity:0];
+        self.relationshipCache = [NSMutableDictionary new];
+        self.inserted = [NSMutableArray new];
+        self.updated = [NSMutableArray new];
+        self.deferredRelationships = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
+        self.eventTypes = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
+        self.vetoed = [[NSHashTable alloc] initWithOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality capacity:0];
+        for (SRKEntity* entity in entities) {
+            [self planEntity:entity];
+        }
+    }
+    return self;
+}
+
+- (NSUInteger)plannedCount {
+    return self.levelForEntity.count;
+}
+
+- (NSArray<SRKEntity*>*)insertedEntities {
+    return self.inserted;
+}
+
+- (NSArray<SRKEntity*>*)updatedEntities {
+    return self.updated;
+}
+
+- (BOOL)didCommit:(SRKEntity*)entity {
+    return [self.committed containsObject:entity];
+}
+
+- (NSArray*)relationshipsForEntity:(SRKEntity*)entity {
+    NSString* entityName = [entity.class description];
+    NSArray* relationships = [self.relationshipCache objectForKey:entityName];
+    if (!relationships) {
+        relationships = [SharkSchemaManager.shared relationshipsForEntity:entityName type:SRK_RELATE_ONETOONE];
+        [self.relationshipCache setObject:relationships ? relationships : @[] forKey:entityName];
+    }
+    return relationships;
+}
+
+- (NSMutableArray*)childrenOfEntity:(SRKEntity*)entity {
+    
+    /* the same rules as a single commit, an existing object only writes related objects which have no key or have outstanding changes (stops cyclical writes) */
+    NSMutableArray* children = [NSMutableArray new];
+    for (SRKEntity* o in entity.embeddedEntities.allValues) {
+        if ([o isKindOfClass:[SRKEntity class]] && !o.sterilised && ![self.chain doesObjectExistInChain:o]) {
+            if (!entity.exists || !o.Id || o.dirty) {
+                [children addObject:o];
+            }
+        }
+    }
+    return children;
+    
+}
+
+- (BOOL)willCommitEntity:(SRKEntity*)entity {
+    
+    /* called as each object is reached, so an object is asked before the objects related to it are written, as it was when each commit wrote its related objects itself.  Classes with their own commit logic ask when they are written */
+    if (![entity.class __supportsBatchedCommit]) {
+        return YES;
+    }
+    
+    enum SharkORMEvent eventType = entity.exists ? SharkORMEventUpdate : SharkORMEventInsert;
+    if (eventType == SharkORMEventInsert ? ![entity entityWillInsert] : ![entity entityWillUpdate]) {
+        // nothing is written for this object, or for anything that was only reached through it
+        [self.vetoed addObject:entity];
+        return NO;
+    }
+    
+    [self.eventTypes setObject:@(eventType) forKey:entity];
+    return YES;
+    
+}
+
+- (void)planEntity:(SRKEntity*)root {
+    
+    if (root.sterilised || [self.chain doesObjectExistInChain:root]) {
+        return;
+    }
+    
+    /* depth first without recursion, so a long chain of related objects cannot exhaust the stack.  Each object is placed once all of its related objects have been */
+    NSMutableArray* path = [NSMutableArray new];
+    NSMutableArray* pending = [NSMutableArray new];
+    
+    [self.chain addObjectToChain:root];
+    [root __addIgnoredEntitiesToObjectChain:self.chain];
+    if (![self willCommitEntity:root]) {
+        return;
+    }
+    [path addObject:root];
+    [pending addObject:[self childrenOfEntity:root]];
+    
+    while (path.count) {
+        
+        NSMutableArray* children = pending.lastObject;
+        SRKEntity* child = children.lastObject;
+        
+        if (child) {
+            
+            [children removeLastObject];
+            if (![self.chain doesObjectExistInChain:child]) {
+                [self.chain addObjectToChain:child];
+                [child __addIgnoredEntitiesToObjectChain:self.chain];
+                if ([self willCommitEntity:child]) {
+                    [path addObject:child];
+                    [pending addObject:[self childrenOfEntity:child]];
+                }
+            }
+            
+        } else {
+            
+            SRKEntity* entity = path.lastObject;
+            [path removeLastObject];
+            [pending removeLastObject];
+            [self placeEntity:entity];
+            
+        }
+        
+    }
+    
+}
+
+- (void)placeEntity:(SRKEntity*)entity {
+    
+    // one level above the highest related object, anything still on the path is part of a cycle and is ignored
+    NSUInteger level = 0;
+    for (SRKEntity* o in entity.embeddedEntities.allValues) {
+        NSNumber* l = [self.levelForEntity objectForKey:o];
+        if (l && l.unsignedIntegerValue + 1 > level) {
+            level = l.unsignedIntegerValue + 1;
+        }
+    }
+    
+    /* a related object which is still on the path has no key yet because of a cycle, so that key is set with a second write once it has been */
+    NSMutableArray* deferred = nil;
+    for (SRKRelationship* r in [self relationshipsForEntity:entity]) {
+        SRKEntity* o = [entity.embeddedEntities objectForKey:r.entityPropertyName];
+        if ([o isKindOfClass:[SRKEntity class]] && !o.Id && ![self.levelForEntity objectForKey:o] && ![self.vetoed containsObject:o] && [self.chain doesObjectExistInChain:o]) {
+            if (!deferred) {
+                deferred = [NSMutableArray new];
+            }
+            [deferred addObject:r];
+        }
+    }
+    if (deferred) {
+        [self.deferredRelationships setObject:deferred forKey:entity];
+    }
+    
+    [self.levelForEntity setObject:@(level) forKey:entity];
+    while (self.levels.count <= level) {
+        [self.levels addObject:[NSMutableArray new]];
+    }
+    [[self.levels objectAtIndex:level] addObject:entity];
+    
+}
+
+- (BOOL)requiresTransaction {
+    
+    /* a single level is written by one commit or one batch, which is atomic by itself.  Anything more takes several writes, which have to stand or fall together */
+    if (self.levels.count > 1 || self.deferredRelationships.count) {
+        return YES;
+    }
+    for (SRKEntity* entity in self.levels.firstObject) {
+        if (![entity.class __supportsBatchedCommit]) {
+            return self.plannedCount > 1;
+        }
+    }
+    return NO;
+    
+}
+
+- (BOOL)execute {
+    
+    if ([SRKTransaction transactionIsInProgress] || ![self requiresTransaction]) {
+        return [self executeLevels];
+    }
+    
+    /* the levels are written within a single transaction, so if any of them fails every level is rolled back and the objects are put back as they were */
+    __block BOOL succeeded = YES;
+    [SRKTransaction transaction:^{
+        if (![self executeLevels]) {
+            [SRKTransaction failTransactionWithCode:SRKTransactionFailed];
+        }
+    } withRollback:^{
+        succeeded = NO;
+        [self.committed removeAllObjects];
+        [self.inserted removeAllObjects];
+        [self.updated removeAllObjects];
+    }];
+    
+    return succeeded;
+    
+}
+
+- (BOOL)executeLevels {
+    
+    BOOL succeeded = YES;
+    NSMutableArray* events = [NSMutableArray new];
+    NSMutableArray* batchWritten = [NSMutableArray new];
+    
+    for (NSArray* level in self.levels) {
+        
+        NSMutableArray* batch = [NSMutableArray new];
+        NSMapTable* statementKeys = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
+        
+        for (SRKEntity* entity in level) {
+            
+            if (entity.sterilised) {
+                continue;
+            }
+            
+            /* classes with their own commit logic (e.g. sync) go through it, everything they relate to is already in the chain so it will not be written twice */
+            if (![entity.class __supportsBatchedCommit]) {
+                BOOL existed = entity.exists;
+                if ([entity __commitRawWithObjectChain:self.chain]) {
+                    [self.committed addObject:entity];
+                    [existed ? self.updated : self.inserted addObject:entity];
+                }
+                continue;
+            }
+            
+            // the will hooks were called whilst the graph was being planned
+            enum SharkORMEvent eventType = [[self.eventTypes objectForKey:entity] intValue];
+            
+            /* check to see if this entity used a string based primary key */
+            if (!entity.Id && [SharkSchemaManager.shared schemaPrimaryKeyTypeForEntity:[entity.class description]] == SRK_PROPERTY_TYPE_STRING) {
+                entity.Id = (id)[SRKUtilities generatePrimaryKeyForClass:entity.class];
+            }
+            
+            // everything this object relates to was written in an earlier level, so the keys are all known now (apart from any in a cycle)
+            NSArray* relationships = [self relationshipsForEntity:entity];
+            NSArray* deferred = [self.deferredRelationships objectForKey:entity];
+            if (deferred) {
+                NSMutableArray* available = [NSMutableArray arrayWithArray:relationships];
+                [available removeObjectsInArray:deferred];
+                relationships = available;
+            }
+            [entity __prepareFieldsForCommitWithRelationships:relationships];
+            
+            [batch addObject:entity];
+            [statementKeys setObject:[NSString stringWithFormat:@"%@|%i|%@", entity.class, eventType, [[entity.modifiedFieldNames sortedArrayUsingSelector:@selector(compare:)] componentsJoinedByString:@","]] forKey:entity];
+            
+        }
+        
+        /* keep objects of the same class and column set together, so each one reuses the statement prepared for the last */
+        [batch sortWithOptions:NSSortStable usingComparator:^NSComparisonResult(SRKEntity* e1, SRKEntity* e2) {
+            return [(NSString*)[statementKeys objectForKey:e1] compare:[statementKeys objectForKey:e2]];
+        }];
+        
+        NSArray* written = nil;
+        if (batch.count > 1) {
+            
+            written = [[SharkORM new] commitObjects:batch];
+            if (!written) {
+                succeeded = NO;
+                break;
+            }
+            [batchWritten addObjectsFromArray:written];
+            
+        } else {
+            
+            NSMutableArray* individual = [NSMutableArray new];
+            for (SRKEntity* entity in batch) {
+                if ([[SharkORM new] commitObject:entity]) {
+                    [individual addObject:entity];
+                } else {
+                    succeeded = NO;
+                }
+            }
+            written = individual;
+            
+        }
+        
+        for (SRKEntity* entity in written) {
+            [self.committed addObject:entity];
+            enum SharkORMEvent eventType = [[self.eventTypes objectForKey:entity] intValue];
+            [eventType == SharkORMEventInsert ? self.inserted : self.updated addObject:entity];
+            SRKEvent* e = [entity __completeCommitWithEventType:eventType];
+            if (e) {
+                [events addObject:e];
+            }
+        }
+        
+    }
+    
+    /* now the rest of the graph has keys, complete the relationships that were part of a cycle */
+    if (succeeded) {
+        for (SRKEntity* entity in self.deferredRelationships.keyEnumerator.allObjects) {
+            if ([self.committed containsObject:entity]) {
+                [entity __prepareFieldsForCommitWithRelationships:[self.deferredRelationships objectForKey:entity]];
+                if ([[SharkORM new] commitObject:entity]) {
+                    // the key written by the second write is a change of its own, so it is raised along with the rest of the graph
+                    SRKEvent* e = [entity __completeCommitWithEventType:SharkORMEventUpdate];
+                    if (e) {
+                        [events addObject:e];
+                    }
+                } else {
+                    succeeded = NO;
+                }
+            }
+        }
+    }
+    
+    /* send out the events for the whole graph in one go, now that it has been committed */
+    if (events.count) {
+        [[SRKRegistry sharedInstance] broadcastEvents:events];
+    }
+    
+    // objects written individually have already had their blocks called by commitObject:, and within a transaction they are called once it has been committed
+    for (SRKEntity* entity in [SRKTransaction transactionIsInProgress] ? nil : batchWritten) {
+        if (entity.commitOptions.postCommitBlock) {
+            entity.commitOptions.postCommitBlock();
+        }
+    }
+    
+    return succeeded;
+    
+}
+
+@end
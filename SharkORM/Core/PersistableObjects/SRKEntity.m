@@ -35,6 +35,7 @@
 #import "SRKUnsupportedObject.h"
 #import "SRKEncryptedObject.h"
 #import "SRKEntityChain.h"
+#import "SRKCommitPlanner.h"
 #import "SRKGlobals.h"
 #import "SRKTransaction+Private.h"
 #import "SRKCommitOptions+Private.h"
@@ -126,13 +127,6 @@ static int obCount=0;
  *  Live entities implement a shared event model and memory space, this is intended for use where you wish to action ORM events in the UI
  */
 
-- (void)executeEventBlock:(SRKEventBlockHolder*)block {
-    @synchronized(block) {
-        block.block(block.tempEvent);
-        block.tempEvent = nil;
-    }
-}
-
 - (void)notifyObjectChanges:(SRKEvent*)e {
     
     if (e.entity == self) {
@@ -158,15 +152,10 @@ static int obCount=0;
     for (SRKEventBlockHolder* bh in self.registeredEventBlocks) {
         if (bh.events & e.event) {
             /* this bit is set */
-            bh.tempEvent = e;
             if (bh.updateSelf) {
                 [self notifyObjectChanges:e];
             }
-            if (bh.useMainThread) {
-                [self performSelectorOnMainThread:@selector(executeEventBlock:) withObject:bh waitUntilDone:YES];
-            } else {
-                [self performSelectorInBackground:@selector(executeEventBlock:) withObject:bh];
-            }
+            [bh dispatchEvent:e];
         }
     }
     
@@ -221,6 +210,10 @@ static int obCount=0;
     return NO;
 }
 
++ (BOOL)entityIsThreadConfined {
+    return NO;
+}
+
 /* the following method will need implementing if you want typed collections */
 
 + (SRKRelationship*)relationshipForProperty:(NSString*)property {
@@ -235,6 +228,10 @@ static int obCount=0;
     return nil;
 }
 
++ (NSArray<NSString*>*)FTSParametersForEntity {
+    return nil;
+}
+
 + (NSArray<NSString*>*)ignoredProperties {
     return nil;
 }
@@ -247,6 +244,10 @@ static int obCount=0;
     return nil;
 }
 
++ (NSArray<NSString*>*)clusteredPrimaryKeyForClass {
+    return nil;
+}
+
 + (void)setRevision:(int)revision {
     [SharkORM setEntityRevision:revision forEntity:[[self class] description] inDatabase:[SharkORM databaseNameForClass:[self class]]];
 }
@@ -951,12 +952,10 @@ static void setPropertyIMP(SRKEntity* self, SEL _cmd, id aValue) {
     
     // we have an asignment/change to a property value, so we need to establish if we are currently within a transaction
     
-    if (!self.transactionInfo && [SRKTransaction transactionIsInProgressForThisThread]) {
+    if ([SRKTransaction transactionIsInProgressForThisThread] && [SRKTransaction entityRequiresRestorePoint:self]) {
         
-        // create a transaction object, which will create a restore point for this object were the transaction to fail
-        SRKTransactionInfo* info = [SRKTransactionInfo new];
-        [info copyObjectValuesIntoRestorePoint:self];
-        self.transactionInfo = info;
+        // create a transaction object, which will create a restore point for this object were the transaction (or the savepoint within it) to fail
+        [SRKTransaction createRestorePointForEntity:self];
         
         [SRKTransaction addReferencedObjectToTransactionList:self];
         
@@ -1056,12 +1055,10 @@ static void setPropertyEntityIMP(SRKEntity* self, SEL _cmd, id aValue) {
     
     // we have an asignment/change to a property value, so we need to establish if we are currently within a transaction
     
-    if (!self.transactionInfo && [SRKTransaction transactionIsInProgressForThisThread]) {
+    if ([SRKTransaction transactionIsInProgressForThisThread] && [SRKTransaction entityRequiresRestorePoint:self]) {
         
-        // create a transaction object, which will create a restore point for this object were the transaction to fail
-        SRKTransactionInfo* info = [SRKTransactionInfo new];
-        [info copyObjectValuesIntoRestorePoint:self];
-        self.transactionInfo = info;
+        // create a transaction object, which will create a restore point for this object were the transaction (or the savepoint within it) to fail
+        [SRKTransaction createRestorePointForEntity:self];
         
         [SRKTransaction addReferencedObjectToTransactionList:self];
         
@@ -1149,12 +1146,10 @@ static void setPropertyEntityCollectionIMP(SRKEntity* self, SEL _cmd, id aValue)
     
     // we have an asignment/change to a property value, so we need to establish if we are currently within a transaction
     
-    if (!self.transactionInfo && [SRKTransaction transactionIsInProgressForThisThread]) {
+    if ([SRKTransaction transactionIsInProgressForThisThread] && [SRKTransaction entityRequiresRestorePoint:self]) {
         
-        // create a transaction object, which will create a restore point for this object were the transaction to fail
-        SRKTransactionInfo* info = [SRKTransactionInfo new];
-        [info copyObjectValuesIntoRestorePoint:self];
-        self.transactionInfo = info;
+        // create a transaction object, which will create a restore point for this object were the transaction (or the savepoint within it) to fail
+        [SRKTransaction createRestorePointForEntity:self];
         
         [SRKTransaction addReferencedObjectToTransactionList:self];
         
@@ -1517,28 +1512,44 @@ static void setPropertyCharPTRIMP(SRKEntity* self, SEL _cmd, char* aValue) {
                 
             }
             
+            /* clustered storage needs the keys to be supplied, so it is only possible for string keyed entities.  It is registered before the indexes, as they depend on the storage */
+            NSArray* clusteredKey = [[self class] clusteredPrimaryKeyForClass];
+            if (clusteredKey.count && [SharkSchemaManager.shared schemaPrimaryKeyTypeForEntity:strClassName] == SRK_PROPERTY_TYPE_STRING) {
+                [SharkSchemaManager.shared schemaSetEntity:strClassName clusteredKey:clusteredKey];
+                if (![clusteredKey isEqualToArray:@[SRK_DEFAULT_PRIMARY_KEY_NAME]]) {
+                    // clustered on a natural key, so the Id still needs to be unique and quick to find
+                    NSString* execSql = [NSString stringWithFormat:@"CREATE UNIQUE INDEX idx_%@_id ON %@ (Id);", strClassName, strClassName];
+                    [SharkSchemaManager.shared schemaAddIndexDefinitionForEntity:strClassName name:[NSString stringWithFormat:@"idx_%@_id", strClassName] definition:execSql];
+                }
+            }
+            
             // generate all the indexes for the entity
             /* ask the class for it's indexes so we can clear them up as well */
             SRKIndexDefinition* idxDef = [[self class] indexDefinitionForEntity];
-            if (idxDef) {
-                
-                if ([self.class uniquePropertiesForClass]) {
-                    NSArray* uniqueProperties = [self.class uniquePropertiesForClass];
-                    if (uniqueProperties.count == 1) {
-                        [idxDef add:[uniqueProperties objectAtIndex:0] order:[[uniqueProperties objectAtIndex:0] isKindOfClass:[NSString class]] ? SRKIndexSortOrderNoCase : SRKIndexSortOrderAscending];
-                    } else if (uniqueProperties.count > 1) {
-                        [idxDef addIndexForProperty:[uniqueProperties objectAtIndex:0] propertyOrder:[[uniqueProperties objectAtIndex:0] isKindOfClass:[NSString class]] ? SRKIndexSortOrderNoCase : SRKIndexSortOrderAscending secondaryProperty:[uniqueProperties objectAtIndex:1] secondaryOrder:[[uniqueProperties objectAtIndex:1] isKindOfClass:[NSString class]] ? SRKIndexSortOrderNoCase : SRKIndexSortOrderAscending];
-                    }
+            
+            NSArray* ftsProperties = [[self class] FTSParametersForEntity];
+            if (ftsProperties.count) {
+                if (!idxDef) {
+                    idxDef = [SRKIndexDefinition new];
+                }
+                [idxDef addFullTextIndexForProperties:ftsProperties];
+            }
+            
+            NSArray* uniqueProperties = [[self class] uniquePropertiesForClass];
+            if (uniqueProperties.count) {
+                if (!idxDef) {
+                    idxDef = [SRKIndexDefinition new];
                 }
+                [idxDef addUnique:uniqueProperties];
+            }
+            
+            if (idxDef) {
                 
                 [idxDef generateIndexesForTable:strClassName forEntity:strClassName];
                 
             }
             
-            // generate the default Primary key index
-            // now create an index for the primary key
-            NSString* execSql = [NSString stringWithFormat:@"CREATE INDEX idx_%@_prikey ON %@ (Id);", strClassName, strClassName];
-            [SharkSchemaManager.shared schemaAddIndexDefinitionForEntity:strClassName name:[NSString stringWithFormat:@"idx_%@_prikey", strClassName] definition:execSql];
+            /* the primary key is the rowid (or has its own automatic index), so there is no separate index for it, any 'idx_<table>_prikey' left from older versions is dropped by the refactor */
             
             
             // now call the database layer to refactor if required
@@ -1635,6 +1646,7 @@ static void setPropertyCharPTRIMP(SRKEntity* self, SEL _cmd, char* aValue) {
         self.dirtyFields = [[NSMutableDictionary alloc] init];
         self.joinedData = [[NSMutableDictionary alloc] init];
         self.preCalculated = nil;
+        _threadConfined = [self.class entityIsThreadConfined];
         
         NSString* entityName = self.class.description;
         
@@ -1683,9 +1695,52 @@ static void setPropertyCharPTRIMP(SRKEntity* self, SEL _cmd, char* aValue) {
 }
 
 
+/*
+ *  thread confined objects, only one thread ever touches the field data so the locks are skipped.  Rather than building a merged copy of the field data after every
+ *  write, reads look in the changed values first and fall through to the field data beneath them.
+ */
+
+#ifdef DEBUG
+#define SRKAssertThreadConfinement() \
+    if (!confinedThread) { \
+        confinedThread = [NSThread currentThread]; \
+    } \
+    NSAssert(confinedThread == [NSThread currentThread], @"thread confined %@ object used from a thread other than the one that owns it", self.class.description);
+#else
+#define SRKAssertThreadConfinement()
+#endif
+
+- (void)setThreadConfined:(BOOL)threadConfined {
+    
+    _threadConfined = threadConfined;
+    self.preCalculated = nil;
+#ifdef DEBUG
+    confinedThread = nil;
+#endif
+    
+}
+
 - (NSObject*)getField:(NSString*)fieldName {
     
-    if (_isLightweightObject && !_isLightweightObjectLoaded) {
+    if (_threadConfined && !(_isLightweightObject && !_isLightweightObjectLoaded)) {
+        
+        SRKAssertThreadConfinement();
+        
+        NSObject* retObject = [_changedValues objectForKey:fieldName];
+        if (retObject == nil) {
+            retObject = [_fieldData objectForKey:fieldName];
+        }
+        if (retObject == nil) {
+            retObject = [_joinedData objectForKey:fieldName];
+        }
+        
+        /* return nil if data layer contains null, caught buy setField */
+        if ([retObject isKindOfClass:[NSNull class]]) {
+            retObject = nil;
+        }
+        return retObject;
+        
+    } else if (_isLightweightObject && !_isLightweightObjectLoaded) {
         
         /* check to see if this field has a value at all, if it does not have a value or even an NSNull then wel need to pull a heavy object from the database */
         @synchronized(_fieldData) {
@@ -1799,6 +1854,11 @@ static void setPropertyCharPTRIMP(SRKEntity* self, SEL _cmd, char* aValue) {
 
 - (void)setJoinedField:(NSString*)fieldName value:(NSObject*)value {
     
+    if (_threadConfined) {
+        [_joinedData setObject:value forKey:fieldName];
+        return;
+    }
+    
     @synchronized(self.joinedData) {
         [self.joinedData setObject:value forKey:fieldName];
     }
@@ -1807,6 +1867,11 @@ static void setPropertyCharPTRIMP(SRKEntity* self, SEL _cmd, char* aValue) {
 
 - (void)setFieldWithoutNotify:(NSString*)fieldName value:(NSObject*)value {
     
+    if (_threadConfined) {
+        [self setFieldConfined:fieldName value:value];
+        return;
+    }
+    
     if (self.preCalculated) {
         @synchronized(self.preCalculated) {
             writingPreCalculated = YES;
@@ -1835,8 +1900,35 @@ static void setPropertyCharPTRIMP(SRKEntity* self, SEL _cmd, char* aValue) {
     
 }
 
+- (void)setFieldConfined:(NSString*)fieldName value:(NSObject*)value {
+    
+    SRKAssertThreadConfinement();
+    
+    if (!value) {
+        value = [NSNull null];
+    }
+    
+    if ([fieldName rangeOfString:@"_$_"].location != NSNotFound) {
+        fieldName = [fieldName stringByReplacingOccurrencesOfString:@"_$_" withString:@"."];
+        [_joinedData setObject:value forKey:fieldName];
+    } else {
+        [_changedValues setObject:value forKey:fieldName];
+        if ([fieldName isEqualToString:SRK_DEFAULT_PRIMARY_KEY_NAME]) {
+            [self setCachedPrimaryKey:value];
+        }
+        [_dirtyFields setObject:@(1) forKey:fieldName];
+        self.dirty = YES;
+    }
+    
+}
+
 - (void)setFieldRaw:(NSString*)fieldName value:(NSObject*)value {
     
+    if (_threadConfined) {
+        [self setFieldConfined:fieldName value:value];
+        return;
+    }
+    
     @synchronized(self.preCalculated) {
         if (self.preCalculated) {
             self.preCalculated = nil;
@@ -1905,6 +1997,10 @@ static void setPropertyCharPTRIMP(SRKEntity* self, SEL _cmd, char* aValue) {
             
             for (NSString* key in [self.changedValues allKeys]) {
                 
+                // inside a transaction, log the value being replaced so a rollback can put it back
+                if (self.transactionInfo) {
+                    [self.transactionInfo recordOriginalValue:[self.fieldData objectForKey:key] forField:key];
+                }
                 [self.fieldData setObject:[self.changedValues objectForKey:key] forKey:key];
                 
             }
@@ -2231,6 +2327,8 @@ static void setPropertyCharPTRIMP(SRKEntity* self, SEL _cmd, char* aValue) {
     
     if(!self.context) {
         
+        /* anything waiting to be group committed has to be written first, otherwise the delete could be overtaken by the insert */
+        [[SRKGlobals sharedObject] flushGroupCommit];
         [self __removeRaw];
         
     }  else {
@@ -2241,11 +2339,7 @@ static void setPropertyCharPTRIMP(SRKEntity* self, SEL _cmd, char* aValue) {
     return YES;
 }
 
-- (BOOL)__commitRawWithObjectChain:(SRKEntityChain *)chain {
-    
-    if (self.sterilised) {
-        return NO;
-    }
+- (void)__addIgnoredEntitiesToObjectChain:(SRKEntityChain *)chain {
     
     // check to see if we have any embedded entities to ignore, if so add them into the object chain so they appear to have already been processed
     if (self.commitOptions.ignoreEntities && self.commitOptions.ignoreEntities.count > 0) {
@@ -2261,87 +2355,147 @@ static void setPropertyCharPTRIMP(SRKEntity* self, SEL _cmd, char* aValue) {
         }
     }
     
+}
+
+- (void)__prepareForCommitWithObjectChain:(SRKEntityChain *)chain {
+    
     if (!self.exists) {
         
-        /* insert */
-        if ([self entityWillInsert]) {
-            
-            /* check to see if this entity used a string based primary key */
-            id currentId = [self Id];
-            if (!currentId && [SharkSchemaManager.shared schemaPrimaryKeyTypeForEntity:[self.class description]] == SRK_PROPERTY_TYPE_STRING) {
-                self.Id = (id)[SRKUtilities generateGUID];
+        /* check to see if any entities have been added into this object, commit them */
+        for (SRKEntity* o in self.embeddedEntities.allValues) {
+            if ([o isKindOfClass:[SRKEntity class]]) {
+                // check to see if this object has already appeard in this chain.
+                if (![chain doesObjectExistInChain:o]) {
+                    [(SRKEntity*)o __commitRawWithObjectChain:[chain addObjectToChain:self]];
+                }
             }
-            
-            /* check to see if any entities have been added into this object, commit them */
-            for (SRKEntity* o in self.embeddedEntities.allValues) {
-                if ([o isKindOfClass:[SRKEntity class]]) {
-                    // check to see if this object has already appeard in this chain.
+        }
+        
+    } else {
+        
+        /* check to see if any entities have been added into this object, commit them, but only if they do not have a PK or any outstanding changes (stops cyclical inserts) */
+        for (SRKEntity* o in self.embeddedEntities.allValues) {
+            if ([o isKindOfClass:[SRKEntity class]]) {
+                if (!o.Id || o.dirty) {
                     if (![chain doesObjectExistInChain:o]) {
-                        [(SRKEntity*)o __commitRawWithObjectChain:[chain addObjectToChain:self]];
+                        [o __commitRawWithObjectChain:[chain addObjectToChain:self]];
                     }
                 }
             }
+        }
+        
+    }
+    
+    [self __prepareFieldsForCommitWithRelationships:[SharkSchemaManager.shared relationshipsForEntity:[self.class description] type:SRK_RELATE_ONETOONE]];
+    
+}
+
+/*
+ *  sets the foreign keys for the one-to-one relationships, which must already have been written, and defaults any primitives of a new object.
+ */
+- (void)__prepareFieldsForCommitWithRelationships:(NSArray*)relationships {
+    
+    for (SRKRelationship* r in relationships) {
+        /* this is a link field that needs to be updated */
+        NSObject* e = [self.embeddedEntities objectForKey:r.entityPropertyName];
+        if(e && [e isKindOfClass:[SRKEntity class]]) {
+            [self setField:[NSString stringWithFormat:@"%@",r.entityPropertyName] value:((SRKEntity*)e).Id];
+            // if the new .Id value is NULL or .sterilized = TRUE then we need to remove this value.
+            if (((SRKEntity*)e).sterilised || ((SRKEntity*)e).Id == nil) {
+                [self.embeddedEntities removeObjectForKey:r.entityPropertyName];
+            }
+        }
+    }
+    
+    if (!self.exists) {
+        
+        /* now we need to populate any fields that are based on primatives with their default values */
+        for (NSString* f in self.fieldNames) {
             
-            for (SRKRelationship* r in [SharkSchemaManager.shared relationshipsForEntity:[self.class description] type:SRK_RELATE_ONETOONE]) {
-                /* this is a link field that needs to be updated */
-                NSObject* e = [self.embeddedEntities objectForKey:r.entityPropertyName];
-                if(e && [e isKindOfClass:[SRKEntity class]]) {
-                    [self setField:[NSString stringWithFormat:@"%@",r.entityPropertyName] value:((SRKEntity*)e).Id];
-                    // if the new .Id value is NULL or .sterilized = TRUE then we need to remove this value.
-                    if (((SRKEntity*)e).sterilised || ((SRKEntity*)e).Id == nil) {
-                        [self.embeddedEntities removeObjectForKey:r.entityPropertyName];
-                    }
-                }
+            int type = (int)[SharkSchemaManager.shared schemaPropertyType:[self.class description] property:f];
+            if ([self.class isTypeAPrimitive:type] && ![self getField:f]) {
+                [self setFieldRaw:f value:@(0)];
             }
             
-            /* now we need to populate any fields that are based on primatives with their default values */
-            for (NSString* f in self.fieldNames) {
-                
-                int type = (int)[SharkSchemaManager.shared schemaPropertyType:[self.class description] property:f];
-                if ([self.class isTypeAPrimitive:type] && ![self getField:f]) {
-                    [self setFieldRaw:f value:@(0)];
-                }
-                
+        }
+        
+    }
+    
+}
+
+/*
+ *  called once the row has been written, returns the event which should be broadcast (if any) so that bulk operations can send them out together.
+ */
+- (SRKEvent*)__completeCommitWithEventType:(enum SharkORMEvent)eventType {
+    
+    self.exists = YES;
+    
+    if (eventType == SharkORMEventInsert) {
+        [self entityDidInsert];
+    } else {
+        [self entityDidUpdate];
+    }
+    
+    // now raise a global event
+    if (!self.transactionInfo) {
+        SRKGlobalEventCallback callback = eventType == SharkORMEventInsert ? [[SRKGlobals sharedObject] getInsertCallback] : [[SRKGlobals sharedObject] getUpdateCallback];
+        if (callback) {
+            callback(self);
+        }
+    }
+    
+    /* now create the live message, which will tigger the local event */
+    SRKEvent* e = nil;
+    if (![[self class] entityDoesNotRaiseEvents] && ![SRKTransaction transactionIsInProgress] && self.commitOptions.triggerEvents) {
+        e = [SRKEvent new];
+        e.event = eventType;
+        e.entity = self;
+        e.changedProperties = self.modifiedFieldNames;
+    }
+    
+    /* clear the modified fields list */
+    @synchronized(self.changedValues) {
+        [self.changedValues removeAllObjects];
+        [self.dirtyFields removeAllObjects];
+        self.dirty = NO;
+    }
+    
+    return e;
+    
+}
+
+- (BOOL)__commitRawWithObjectChain:(SRKEntityChain *)chain {
+    
+    if (self.sterilised) {
+        return NO;
+    }
+    
+    [self __addIgnoredEntitiesToObjectChain:chain];
+    
+    if (!self.exists) {
+        
+        /* insert */
+        if ([self entityWillInsert]) {
+            
+            /* check to see if this entity used a string based primary key */
+            id currentId = [self Id];
+            if (!currentId && [SharkSchemaManager.shared schemaPrimaryKeyTypeForEntity:[self.class description]] == SRK_PROPERTY_TYPE_STRING) {
+                self.Id = (id)[SRKUtilities generatePrimaryKeyForClass:self.class];
             }
             
+            [self __prepareForCommitWithObjectChain:chain];
             
             if([[SharkORM new] commitObject:self]) {
                 
-                self.exists = YES;
-                [self entityDidInsert];
-                
-                // now raise a global event
-                if (!self.transactionInfo) {
-                    SRKGlobalEventCallback callback = [[SRKGlobals sharedObject] getInsertCallback];
-                    if (callback) {
-                        callback(self);
-                    }
-                }
-                
-                /* now send out the live message as well as tiggering the local event */
-                
-                if (![[self class] entityDoesNotRaiseEvents] && ![SRKTransaction transactionIsInProgress] && self.commitOptions.triggerEvents) {
-                    
-                    SRKEvent* e = [SRKEvent new];
-                    e.event = SharkORMEventInsert;
-                    e.entity = self;
-                    e.changedProperties = self.modifiedFieldNames;
+                SRKEvent* e = [self __completeCommitWithEventType:SharkORMEventInsert];
+                if (e) {
                     [[SRKRegistry sharedInstance] broadcast:e];
-                    
-                }
-                
-                /* clear the modified fields list */
-                @synchronized(self.changedValues) {
-                    [self.changedValues removeAllObjects];
-                    [self.dirtyFields removeAllObjects];
-                    self.dirty = NO;
                 }
                 
                 return YES;
                 
             }
             
-            
         }
         
     } else {
@@ -2351,61 +2505,19 @@ static void setPropertyCharPTRIMP(SRKEntity* self, SEL _cmd, char* aValue) {
         /* check to see if this entity used a string based primary key */
         id currentId = [self Id];
         if (!currentId && [SharkSchemaManager.shared schemaPrimaryKeyTypeForEntity:[self.class description]] == SRK_PROPERTY_TYPE_STRING) {
-            self.Id = (id)[SRKUtilities generateGUID];
+            self.Id = (id)[SRKUtilities generatePrimaryKeyForClass:self.class];
         }
         
         if ([self entityWillUpdate]) {
             
-            /* check to see if any entities have been added into this object, commit them, but only if they do not have a PK or any outstanding changes (stops cyclical inserts) */
-            
-            for (SRKEntity* o in self.embeddedEntities.allValues) {
-                if ([o isKindOfClass:[SRKEntity class]]) {
-                    if (!o.Id || o.dirty) {
-                        if (![chain doesObjectExistInChain:o]) {
-                            [o __commitRawWithObjectChain:[chain addObjectToChain:self]];
-                        }
-                    }
-                }
-            }
-            
-            for (SRKRelationship* r in [SharkSchemaManager.shared relationshipsForEntity:[self.class description] type:SRK_RELATE_ONETOONE]) {
-                /* this is a link field that needs to be updated */
-                NSObject* e = [self.embeddedEntities objectForKey:r.entityPropertyName];
-                if(e && [e isKindOfClass:[SRKEntity class]]) {
-                    [self setField:[NSString stringWithFormat:@"%@",r.entityPropertyName] value:((SRKEntity*)e).Id];
-                    // if the new .Id value is NULL or .sterilized = TRUE then we need to remove this value.
-                    if (((SRKEntity*)e).sterilised || ((SRKEntity*)e).Id == nil) {
-                        [self.embeddedEntities removeObjectForKey:r.entityPropertyName];
-                    }
-                }
-            }
+            [self __prepareForCommitWithObjectChain:chain];
             
             if([[SharkORM new] commitObject:self]) {
                 
-                self.exists = YES;
-                [self entityDidUpdate];
-                
-                // now raise a global event
-                if (!self.transactionInfo) {
-                    SRKGlobalEventCallback callback = [[SRKGlobals sharedObject] getUpdateCallback];
-                    if (callback) {
-                        callback(self);
-                    }
-                }
-                /* now send out the live message as well as triggering the local event */
-                if (![[self class] entityDoesNotRaiseEvents] && ![SRKTransaction transactionIsInProgress] && self.commitOptions.triggerEvents) {
-                    SRKEvent* e = [SRKEvent new];
-                    e.event = SharkORMEventUpdate;
-                    e.entity = self;
-                    e.changedProperties = self.modifiedFieldNames;
+                SRKEvent* e = [self __completeCommitWithEventType:SharkORMEventUpdate];
+                if (e) {
                     [[SRKRegistry sharedInstance] broadcast:e];
                 }
-                /* clear the modified fields list */
-                @synchronized(self.changedValues) {
-                    [self.changedValues removeAllObjects];
-                    [self.dirtyFields removeAllObjects];
-                    self.dirty = NO;
-                }
                 
                 return YES;
                 
@@ -2419,35 +2531,254 @@ static void setPropertyCharPTRIMP(SRKEntity* self, SEL _cmd, char* aValue) {
     
 }
 
-- (BOOL)commit {
++ (BOOL)__supportsBatchedCommit {
+    /* classes which have their own commit logic (e.g. sync) need each commit to go through it */
+    return [self instanceMethodForSelector:@selector(__commitRawWithObjectChain:)] == [SRKEntity instanceMethodForSelector:@selector(__commitRawWithObjectChain:)];
+}
+
++ (NSArray*)commitAll:(NSArray<SRKEntity*>*)entities {
+    
+    NSMutableArray* planned = [NSMutableArray new];
+    
+    for (SRKEntity* entity in entities) {
+        
+        /* objects within a transaction, context or with their own commit logic (e.g. sync) take the normal path so they behave exactly as they always have */
+        if ([SRKTransaction transactionIsInProgress] || entity.context || ![entity.class __supportsBatchedCommit]) {
+            [entity commit];
+            continue;
+        }
+        
+        [planned addObject:entity];
+        
+    }
+    
+    if (planned.count) {
+        
+        /* the whole graph, including related objects, is ordered and written a level at a time with each level batched per class */
+        SRKCommitPlanner* planner = [[SRKCommitPlanner alloc] initWithEntities:planned];
+        if (![planner execute]) {
+            return nil;
+        }
+        
+    }
     
-    /* make a unique test if neccesary */
-    NSArray* uniqueProperties = [self.class uniquePropertiesForClass];
-    if (uniqueProperties) {
-        NSMutableString* queryString = [NSMutableString new];
-        NSMutableArray* propertyValues = [NSMutableArray new];
-        for (NSString* property in uniqueProperties) {
-            if (!(queryString.length == 0)) {
-                [queryString appendString:@" AND "];
+    NSMutableArray* ids = [NSMutableArray new];
+    for (SRKEntity* entity in entities) {
+        [ids addObject:entity.exists && entity.Id ? entity.Id : [NSNull null]];
+    }
+    
+    return ids;
+    
+}
+
++ (BOOL)removeAll:(NSArray<SRKEntity*>*)entities {
+    
+    /* anything waiting to be group committed has to be written first, otherwise the deletes could be overtaken by the inserts */
+    [[SRKGlobals sharedObject] flushGroupCommit];
+    
+    BOOL succeded = YES;
+    NSMutableArray* batch = [NSMutableArray new];
+    
+    for (SRKEntity* entity in entities) {
+        
+        /* objects within a transaction or context, or with their own removal logic, take the normal path */
+        if ([SRKTransaction transactionIsInProgress] || entity.context || [entity methodForSelector:@selector(__removeRaw)] != [SRKEntity instanceMethodForSelector:@selector(__removeRaw)]) {
+            succeded = [entity remove] && succeded;
+            continue;
+        }
+        
+        if ((entity.sterilised && !entity.isLightweightObject) || !entity.reflectedPrimaryKeyValue) {
+            continue;
+        }
+        
+        if ([entity entityWillDelete]) {
+            [batch addObject:entity];
+        }
+        
+    }
+    
+    if (batch.count) {
+        
+        if (![[SharkORM new] removeObjects:batch]) {
+            return NO;
+        }
+        
+        NSMutableArray* events = [NSMutableArray new];
+        SRKGlobalEventCallback callback = [[SRKGlobals sharedObject] getDeleteCallback];
+        
+        for (SRKEntity* entity in batch) {
+            
+            [entity entityDidDelete];
+            if (callback) {
+                callback(entity);
             }
-            [queryString appendString:[NSString stringWithFormat:@" %@ = ? ", property]];
-            [propertyValues addObject:[self getField:property] ? [self getField:property] : [NSNull null]];
+            
+            entity.exists = NO;
+            
+            if (![[entity class] entityDoesNotRaiseEvents] && entity.commitOptions.triggerEvents) {
+                SRKEvent* e = [SRKEvent new];
+                e.event = SharkORMEventDelete;
+                e.entity = entity;
+                e.changedProperties = nil;
+                [events addObject:e];
+            }
+            
+            /* clear the modified fields list */
+            @synchronized(entity.changedValues) {
+                [entity.changedValues removeAllObjects];
+                [entity.dirtyFields removeAllObjects];
+                entity.dirty = NO;
+            }
+            
+        }
+        
+        if (events.count) {
+            [[SRKRegistry sharedInstance] broadcastEvents:events];
         }
-        if (self.exists) {
-            [queryString appendString:@" AND Id != ?"];
-            [propertyValues addObject:self.Id];
+        
+        /* now remove the primary keys now the events have been broadcast */
+        for (SRKEntity* entity in batch) {
+            entity.Id = nil;
+            if (entity.commitOptions.postRemoveBlock) {
+                entity.commitOptions.postRemoveBlock();
+            }
         }
-        if (queryString.length != 0) {
+        
+    }
+    
+    return succeded;
+    
+}
+
++ (BOOL)upsert:(SRKEntity*)entity onConflict:(NSArray<NSString*>*)conflictProperties update:(NSArray<NSString*>*)updateProperties {
+    return [self upsertAll:@[entity] onConflict:conflictProperties update:updateProperties where:nil];
+}
+
++ (BOOL)upsert:(SRKEntity*)entity onConflict:(NSArray<NSString*>*)conflictProperties update:(NSArray<NSString*>*)updateProperties where:(NSString*)condition {
+    return [self upsertAll:@[entity] onConflict:conflictProperties update:updateProperties where:condition];
+}
+
++ (BOOL)upsertAll:(NSArray<SRKEntity*>*)entities onConflict:(NSArray<NSString*>*)conflictProperties update:(NSArray<NSString*>*)updateProperties where:(NSString*)condition {
+    
+    /* queued commits have to reach the table before the conflict target is checked against it */
+    [[SRKGlobals sharedObject] flushGroupCommit];
+    
+    NSMutableArray* batch = [NSMutableArray new];
+    
+    for (SRKEntity* entity in entities) {
+        
+        if (entity.sterilised || entity.context) {
+            continue;
+        }
+        
+        if (![entity entityWillInsert]) {
+            continue;
+        }
+        
+        /* check to see if this entity used a string based primary key */
+        if (!entity.Id && [SharkSchemaManager.shared schemaPrimaryKeyTypeForEntity:[entity.class description]] == SRK_PROPERTY_TYPE_STRING) {
+            entity.Id = (id)[SRKUtilities generatePrimaryKeyForClass:entity.class];
+        }
+        
+        SRKEntityChain* chain = [SRKEntityChain new];
+        [entity __addIgnoredEntitiesToObjectChain:chain];
+        [entity __prepareForCommitWithObjectChain:chain];
+        [batch addObject:entity];
+        
+    }
+    
+    if (!batch.count) {
+        return YES;
+    }
+    
+    NSArray* outcomes = [[SharkORM new] upsertObjects:batch onConflict:conflictProperties update:updateProperties where:condition];
+    if (!outcomes) {
+        return NO;
+    }
+    
+    NSMutableArray* events = [NSMutableArray new];
+    for (NSUInteger i = 0; i < batch.count; i++) {
+        
+        SRKEntity* entity = [batch objectAtIndex:i];
+        int outcome = [[outcomes objectAtIndex:i] intValue];
+        
+        if (outcome == SharkORMEventInsert) {
+            
+            /* a brand new row, so the object is now exactly what is in the database */
+            [entity setBase];
+            if ([SharkORM getSettings].defaultManagedObjects) {
+                [entity setManagedObjectDomain:[SharkORM getSettings].defaultObjectDomain];
+            }
+            SRKEvent* e = [entity __completeCommitWithEventType:SharkORMEventInsert];
+            if (e) {
+                [events addObject:e];
+            }
+            
+        } else {
+            
+            /* the object now refers to the row it was merged into, so a later commit updates that row rather than inserting another */
+            entity.exists = YES;
+            
+            /* the row may hold values the upsert did not overwrite, so the object takes on what was actually stored and has nothing left to write */
+            SRKEntity* stored = entity.Id ? [[[[entity.class query] where:@"Id = ?" parameters:@[entity.Id]] limit:1] fetch].firstObject : nil;
+            for (NSString* field in stored.fieldNames) {
+                [entity setField:field value:[stored getField:field]];
+            }
+            [entity setBase];
+            @synchronized(entity.changedValues) {
+                [entity.dirtyFields removeAllObjects];
+                entity.dirty = NO;
+            }
             
         }
-        if ([[[self.class query] where:queryString parameters:propertyValues] count]) {
-            return NO;
+        
+        if (outcome == SharkORMEventUpdate && ![[entity class] entityDoesNotRaiseEvents] && ![SRKTransaction transactionIsInProgress] && entity.commitOptions.triggerEvents) {
+            
+            /* an existing row was merged into */
+            SRKEvent* e = [SRKEvent new];
+            e.event = SharkORMEventUpdate;
+            e.entity = entity;
+            e.entityClass = entity.class;
+            e.changedProperties = updateProperties;
+            [events addObject:e];
+            
         }
+        
+    }
+    
+    if (events.count) {
+        [[SRKRegistry sharedInstance] broadcastEvents:events];
     }
     
+    return YES;
+    
+}
+
++ (uint64_t)importFromFile:(NSString*)filePath format:(SRKImportFormat)format options:(SRKImportOptions*)options {
+    
+    return [[SharkORM new] importFile:filePath format:format intoClass:self options:options ? options : [SRKImportOptions new]];
+    
+}
+
+- (BOOL)commit {
+    
+    /* unique properties are enforced by a UNIQUE index, so a duplicate is picked up from the result of the write itself rather than a query beforehand */
     if(!self.context) {
         
-        [self __commitRawWithObjectChain:[SRKEntityChain new]];
+        if ([[SRKGlobals sharedObject] groupCommitEnabled] && ![SRKTransaction transactionIsInProgressForThisThread] && ![[SRKGlobals sharedObject] isGroupCommitWriter] && !self.threadConfined && [self.class __supportsBatchedCommit]) {
+            /* written along with everything else pending when the group commit window closes, the postCommitBlock is executed once it has been.  Thread confined objects are written here instead, as the group commit queue is not their thread */
+            [[SRKGlobals sharedObject] enqueueGroupCommit:self];
+            return YES;
+        }
+        
+        if ([self.class __supportsBatchedCommit]) {
+            /* the object and everything related to it is planned as a graph, rather than committing each related object recursively */
+            SRKCommitPlanner* planner = [[SRKCommitPlanner alloc] initWithEntities:@[self]];
+            [planner execute];
+            return [planner didCommit:self];
+        }
+        
+        return [self __commitRawWithObjectChain:[SRKEntityChain new]];
         
     } else {
         
@@ -27,6 +27,7 @@
 @interface SRKEntityChain ()
 
 @property NSMutableArray* objects;
+@property NSHashTable* members;
 @property NSMutableArray* postCommitalObjectsToUpdate;
 @property NSMutableArray* postCommitalPropertiesToSet;
 @property NSMutableArray* postCommitalObjectsToBeSetIntoProperties;
@@ -39,6 +40,8 @@
     self = [super init];
     if (self) {
         self.objects = [NSMutableArray new];
+        // membership is by identity, so big graphs do not need to compare against every object in the chain
+        self.members = [[NSHashTable alloc] initWithOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality capacity:0];
         self.postCommitalObjectsToUpdate = [NSMutableArray new];
         self.postCommitalPropertiesToSet = [NSMutableArray new];
         self.postCommitalObjectsToBeSetIntoProperties = [NSMutableArray new];
@@ -49,12 +52,13 @@
 - (instancetype)addObjectToChain:(SRKEntity*)o {
     if (![self doesObjectExistInChain:o]) {
         [self.objects addObject:o];
+        [self.members addObject:o];
     }
     return self;
 }
 
 - (BOOL)doesObjectExistInChain:(SRKEntity*)o {
-    return [self.objects containsObject:o];
+    return [self.members containsObject:o];
 }
 
 - (BOOL)isOriginatingObject:(SRKEntity*)o {
@@ -389,6 +389,16 @@
 	
 }
 
+- (SRKQuery*)captureChanges {
+    self.captureChangedRows = YES;
+    return self;
+}
+
+- (SRKQuery*)threadConfined {
+	self.threadConfinedObjects = YES;
+	return self;
+}
+
 - (SRKQuery*)limit:(int)limit {
 	self.limitOf = limit;
 	return self;
@@ -466,6 +476,157 @@
 	return self;
 }
 
+/* spatial methods */
+
+- (SRKQuery*)withinBoundingBoxFromLatitude:(double)minLatitude longitude:(double)minLongitude toLatitude:(double)maxLatitude longitude:(double)maxLongitude latitudeProperty:(NSString*)latitudeProperty longitudeProperty:(NSString*)longitudeProperty {
+    
+    NSString* table = [self.classDecl description];
+    NSString* spatialIndex = [NSString stringWithFormat:SRK_SPATIAL_INDEX_NAME_FORMAT, table, latitudeProperty, longitudeProperty];
+    
+    NSMutableArray* params = [NSMutableArray new];
+    NSString* condition = [NSString stringWithFormat:@"%@.%@ BETWEEN ? AND ?", table, latitudeProperty];
+    [params addObjectsFromArray:@[@(minLatitude), @(maxLatitude)]];
+    
+    /* a box which crosses the antimeridian is split into two longitude ranges */
+    BOOL wraps = minLongitude > maxLongitude;
+    if (wraps) {
+        condition = [condition stringByAppendingFormat:@" AND (%@.%@ >= ? OR %@.%@ <= ?)", table, longitudeProperty, table, longitudeProperty];
+        [params addObjectsFromArray:@[@(minLongitude), @(maxLongitude)]];
+    } else {
+        condition = [condition stringByAppendingFormat:@" AND %@.%@ BETWEEN ? AND ?", table, longitudeProperty];
+        [params addObjectsFromArray:@[@(minLongitude), @(maxLongitude)]];
+    }
+    
+    if ([SharkSchemaManager.shared schemaIndexDefinitionsForEntity:table][spatialIndex]) {
+        
+        /* pre-filter with the R*Tree, it stores 32bit floats rounded outwards so the exact comparison above is still required */
+        NSString* rtree = nil;
+        if (wraps) {
+            rtree = [NSString stringWithFormat:@"%@.rowid IN (SELECT id FROM %@ WHERE maxLat >= ? AND minLat <= ? AND (maxLng >= ? OR minLng <= ?))", table, spatialIndex];
+        } else {
+            rtree = [NSString stringWithFormat:@"%@.rowid IN (SELECT id FROM %@ WHERE maxLat >= ? AND minLat <= ? AND maxLng >= ? AND minLng <= ?)", table, spatialIndex];
+        }
+        condition = [NSString stringWithFormat:@"%@ AND %@", rtree, condition];
+        [params insertObjects:@[@(minLatitude), @(maxLatitude), @(minLongitude), @(maxLongitude)] atIndexes:[NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, 4)]];
+        
+    }
+    
+    return [self addCondition:condition parameters:params];
+    
+}
+
+- (SRKQuery*)withinRadius:(double)metres ofLatitude:(double)latitude longitude:(double)longitude latitudeProperty:(NSString*)latitudeProperty longitudeProperty:(NSString*)longitudeProperty {
+    
+    /* work out the bounding box of the circle, with a little slack for the approximations made in distancebetween() */
+    double latDelta = (metres / (SRK_SPATIAL_EARTH_RADIUS * M_PI / 180.0)) * 1.01;
+    double minLat = MAX(-90.0, latitude - latDelta);
+    double maxLat = MIN(90.0, latitude + latDelta);
+    
+    double minLng = -180.0;
+    double maxLng = 180.0;
+    double cosLat = cos(MAX(fabs(minLat), fabs(maxLat)) * M_PI / 180.0);
+    if (cosLat > 0.000001) {
+        double lngDelta = latDelta / cosLat;
+        if (lngDelta < 180.0) {
+            minLng = longitude - lngDelta;
+            maxLng = longitude + lngDelta;
+            if (minLng < -180.0) {
+                minLng += 360.0;
+            }
+            if (maxLng > 180.0) {
+                maxLng -= 360.0;
+            }
+        }
+    }
+    
+    [self withinBoundingBoxFromLatitude:minLat longitude:minLng toLatitude:maxLat longitude:maxLng latitudeProperty:latitudeProperty longitudeProperty:longitudeProperty];
+    
+    NSString* table = [self.classDecl description];
+    return [self addCondition:[NSString stringWithFormat:@"distancebetween(%@.%@, %@.%@, ?, ?) <= ?", table, latitudeProperty, table, longitudeProperty] parameters:@[@(latitude), @(longitude), @(metres)]];
+    
+}
+
+/* full text methods */
+
+- (SRKQuery*)match:(NSString*)expression {
+    
+    NSString* table = [self.classDecl description];
+    NSString* ftsTable = [NSString stringWithFormat:SRK_FTS_INDEX_NAME_FORMAT, table];
+    
+    if (!self.fullTextJoins) {
+        self.fullTextJoins = [NSMutableArray new];
+    }
+    
+    /*
+     *  the full text table is joined once, with the rank worked out alongside each match, rather than running the MATCH again for every row when ordering.  Only the docid and
+     *  rank are exposed so the columns of the entity are never ambiguous.  The join comes ahead of the bound parameters, so the expression is quoted into the statement.
+     */
+    NSString* alias = [NSString stringWithFormat:@"srk_fts_%lu", (unsigned long)self.fullTextJoins.count];
+    char* quoted = sqlite3_mprintf("%Q", expression.UTF8String);
+    [self.fullTextJoins addObject:[NSString stringWithFormat:@" JOIN (SELECT docid, ftsrank(matchinfo(%@, 'pcx')) AS srk_rank FROM %@ WHERE %@ MATCH %s) AS %@ ON %@.docid = %@.rowid ", ftsTable, ftsTable, ftsTable, quoted, alias, alias, table]];
+    sqlite3_free(quoted);
+    
+    /* order by relevance ahead of any other ordering */
+    NSString* rank = [NSString stringWithFormat:@"%@.srk_rank DESC", alias];
+    
+    if ([self.orderBy isEqualToString:SRK_DEFAULT_ORDER]) {
+        self.orderBy = rank;
+    } else {
+        self.orderBy = [NSString stringWithFormat:@"%@,%@", rank, self.orderBy];
+    }
+    
+    return self;
+    
+}
+
+/* additional conditions, these are kept apart from the where clause so they survive subsequent calls to where: */
+
+- (SRKQuery*)addCondition:(NSString*)condition parameters:(NSArray*)parameters {
+    
+    if (!self.conditions) {
+        self.conditions = [NSMutableArray new];
+        self.conditionParameters = [NSMutableArray new];
+    }
+    
+    [self.conditions addObject:[NSString stringWithFormat:@"(%@)", condition]];
+    if (parameters) {
+        [self.conditionParameters addObjectsFromArray:parameters];
+    }
+    
+    return self;
+    
+}
+
+- (NSString*)compiledWhereClause {
+    
+    if (!self.conditions.count) {
+        return self.whereClause;
+    }
+    
+    NSString* conditions = [self.conditions componentsJoinedByString:@" AND "];
+    if (!self.whereClause || [self.whereClause isEqualToString:SRK_DEFAULT_CONDITION]) {
+        return conditions;
+    }
+    
+    return [NSString stringWithFormat:@"(%@) AND %@", self.whereClause, conditions];
+    
+}
+
+- (NSArray*)compiledParameters {
+    
+    if (!self.conditionParameters.count) {
+        return self.parameters;
+    }
+    
+    NSMutableArray* params = [NSMutableArray new];
+    if (self.parameters) {
+        [params addObjectsFromArray:self.parameters];
+    }
+    [params addObjectsFromArray:self.conditionParameters];
+    return params;
+    
+}
+
 /* execution methods */
 
 - (id)fetchSpecificValueWithQuery:(NSString *)query {
@@ -662,6 +823,51 @@
 	
 }
 
+- (void)broadcastSetEvent:(enum SharkORMEvent)eventType affectedRows:(uint64_t)affected primaryKeys:(NSArray*)primaryKeys values:(NSDictionary*)values {
+    
+    if (!affected || [self.classDecl entityDoesNotRaiseEvents]) {
+        return;
+    }
+    
+    SRKEvent* e = [SRKEvent new];
+    e.event = eventType;
+    e.entityClass = self.classDecl;
+    e.affectedRows = affected;
+    e.changedProperties = values.allKeys;
+    [[SRKRegistry sharedInstance] broadcastSetEvent:e primaryKeys:primaryKeys values:values];
+    
+}
+
+- (uint64_t)deleteAll {
+    
+    /* the rows matched have to include anything still waiting to be group committed */
+    [[SRKGlobals sharedObject] flushGroupCommit];
+    
+    NSArray* primaryKeys = nil;
+    uint64_t affected = [[SharkORM new] deleteForQuery:self primaryKeys:self.captureChangedRows ? &primaryKeys : nil];
+    [self broadcastSetEvent:SharkORMEventDelete affectedRows:affected primaryKeys:primaryKeys values:nil];
+    return affected;
+    
+}
+
+- (uint64_t)updateSet:(NSDictionary<NSString*,id>*)values {
+    
+    /* the rows matched have to include anything still waiting to be group committed */
+    [[SRKGlobals sharedObject] flushGroupCommit];
+    
+    NSArray* primaryKeys = nil;
+    uint64_t affected = [[SharkORM new] updateForQuery:self values:values primaryKeys:self.captureChangedRows ? &primaryKeys : nil];
+    [self broadcastSetEvent:SharkORMEventUpdate affectedRows:affected primaryKeys:primaryKeys values:values];
+    return affected;
+    
+}
+
+- (uint64_t)exportTo:(NSOutputStream*)stream format:(SRKExportFormat)format {
+	
+	return [[SharkORM new] exportForQuery:self toStream:stream format:format];
+	
+}
+
 - (double)sumOf:(NSString*)propertyName {
 	
 	return [[SharkORM new] fetchSumForQuery:self field:propertyName];
@@ -32,6 +32,8 @@
 
 + (SRKRegistry*)sharedInstance;
 - (void)broadcast:(SRKEvent*)event;
+- (void)broadcastEvents:(NSArray<SRKEvent*>*)events;
+- (void)broadcastSetEvent:(SRKEvent*)event primaryKeys:(NSArray*)primaryKeys values:(NSDictionary*)values;
 - (void)registerHandler:(SRKEventHandler*)handler;
 - (void)deregisterHandler:(SRKEventHandler*)handler;
 - (void)registerObject:(SRKEntity*)object;
@@ -31,7 +31,7 @@
 @interface SRKRegistry ()
 
 @property (strong, nonatomic) NSMutableDictionary*     tableEventRegistry;
-@property (strong, nonatomic) NSMutableArray*          objectRegistry;
+@property (strong, nonatomic) NSMutableDictionary*     objectRegistry;
 
 @end
 
@@ -52,7 +52,7 @@ static SRKRegistry* this = nil;
 	
 	self = [super init];
 	if (self) {
-		self.objectRegistry = [NSMutableArray new];
+		self.objectRegistry = [NSMutableDictionary new];
 		self.tableEventRegistry = [NSMutableDictionary new];
 	}
 	
@@ -69,15 +69,50 @@ static SRKRegistry* this = nil;
 	
 }
 
-- (void)freeObjects:(NSArray*)spentObjects {
-	static BOOL active = NO;
-	if (!active) {
-		active = YES;
-		@synchronized(self.objectRegistry) {
-			[self.objectRegistry removeObjectsInArray:spentObjects];
+/*
+ *  live objects are indexed by table and primary key, each key holding the instances of that record as zeroing weak references.  An event only ever looks at
+ *  the instances of the record it is about, and an object that is deallocated simply drops out of its table.
+ */
+
+- (NSString*)registryKeyForTable:(NSString*)table primaryKey:(id)primaryKey {
+	return [NSString stringWithFormat:@"%@|%@", table, primaryKey];
+}
+
+- (NSArray*)liveObjectsForTable:(NSString*)table primaryKey:(id)primaryKey {
+	
+	@synchronized(self.objectRegistry) {
+		
+		NSHashTable* instances = [self.objectRegistry objectForKey:[self registryKeyForTable:table primaryKey:primaryKey]];
+		NSMutableArray* objects = [NSMutableArray new];
+		for (SRKEntity* obj in instances.allObjects) {
+			/* an object whose primary key has since changed is no longer a twin of this record */
+			if ([obj.reflectedPrimaryKeyValue isEqual:primaryKey]) {
+				[objects addObject:obj];
+			}
 		}
-		active = NO;
+		return objects;
+		
+	}
+	
+}
+
+- (void)addLiveObject:(SRKEntity*)object {
+	
+	NSString* key = [self registryKeyForTable:[[object class] description] primaryKey:object.reflectedPrimaryKeyValue];
+	NSHashTable* instances = [self.objectRegistry objectForKey:key];
+	if (!instances) {
+		/* compared by pointer, every instance of the record is held however a subclass defines equality */
+		instances = [NSHashTable hashTableWithOptions:NSPointerFunctionsWeakMemory | NSPointerFunctionsObjectPointerPersonality];
+		[self.objectRegistry setObject:instances forKey:key];
 	}
+	[instances addObject:object];
+	
+	/* the key is remembered, as the primary key may have changed or gone by the time the object is removed */
+	if (!object.registryKeys) {
+		object.registryKeys = [NSMutableSet new];
+	}
+	[object.registryKeys addObject:key];
+	
 }
 
 - (void)broadcast:(SRKEvent *)event {
@@ -86,52 +121,25 @@ static SRKRegistry* this = nil;
 	
 	// managed object domains are dealt with first as the subsequent notifications may rely on the changes in objects already being present
 	
-	NSMutableArray* freedObjects = [NSMutableArray new];
 	NSMutableArray* triggerableEventObjects = [NSMutableArray new];
 	
 	SRKEntity* thisEventEntity = event.entity;
 	
 	if ((event.event == SharkORMEventUpdate || event.event == SharkORMEventDelete) && thisEventEntity.reflectedPrimaryKeyValue) {
-		@synchronized(self.objectRegistry) {
+		
+		for (SRKEntity* obj in [self liveObjectsForTable:[[thisEventEntity class] description] primaryKey:thisEventEntity.reflectedPrimaryKeyValue]) {
 			
-			NSString* eventTable = [[thisEventEntity class] description];
-			for (SRKRegistryEntry* o in self.objectRegistry) {
-				
-				SRKEntity* thisObject = o.entity;
-				
-				if (thisObject) {
-					
-					NSNumber *thisId = thisObject.reflectedPrimaryKeyValue;
-					NSNumber *eventId = thisEventEntity.reflectedPrimaryKeyValue;
-					
-					if (thisId) {
-						if ([o.sourceTable isEqualToString:eventTable]) {
-							/* if it's not the same kind of primary key, then they can't be compared anyway */
-							if ([thisId isKindOfClass:eventId.class]) {
-								if (([thisId isKindOfClass:[NSNumber class]] && thisId.unsignedLongLongValue == eventId.unsignedLongLongValue) || ([thisId isKindOfClass:[NSString class]] && [((NSString*)thisId) isEqualToString:(NSString*)eventId])) {
-									
-									SRKEntity* obj = o.entity;
-									
-									/* check for a domain match */
-									if (o.entity.managedObjectDomain && thisEventEntity.managedObjectDomain && [o.entity.managedObjectDomain isEqualToString:thisEventEntity.managedObjectDomain]) {
-										
-										[obj notifyObjectChanges:event];
-        
-									}
-									
-									if (obj.registeredEventBlocks.count > 0) {
-										[triggerableEventObjects addObject:obj];
-									}
-									
-								}
-							}
-						}
-					}
-				} else {
-					[freedObjects addObject:o];
-				}
+			/* check for a domain match, thread confined objects can't be changed from here as this may not be their thread */
+			if (!obj.threadConfined && obj.managedObjectDomain && thisEventEntity.managedObjectDomain && [obj.managedObjectDomain isEqualToString:thisEventEntity.managedObjectDomain]) {
+				[obj notifyObjectChanges:event];
+			}
+			
+			if (obj.registeredEventBlocks.count > 0) {
+				[triggerableEventObjects addObject:obj];
 			}
+			
 		}
+		
 	}
 	
 	/* trigger any events that we have put by, block may modify the event objects so we can't do it with a lock around the array */
@@ -147,8 +155,103 @@ static SRKRegistry* this = nil;
 		}
 	}
 	
-	if (freedObjects.count > 0) {
-		[self performSelectorInBackground:@selector(freeObjects:) withObject:freedObjects];
+}
+
+- (void)broadcastEvents:(NSArray<SRKEvent*>*)events {
+	
+	/* a batch of events from a bulk operation, each event only looks up the live instances of its own record */
+	
+	NSMutableArray* triggerableEventObjects = [NSMutableArray new];
+	NSMutableArray* triggerableEvents = [NSMutableArray new];
+	
+	for (SRKEvent* event in events) {
+		
+		if ((event.event == SharkORMEventUpdate || event.event == SharkORMEventDelete) && event.entity.reflectedPrimaryKeyValue) {
+			
+			for (SRKEntity* obj in [self liveObjectsForTable:[event.entity.class description] primaryKey:event.entity.reflectedPrimaryKeyValue]) {
+				
+				/* check for a domain match, thread confined objects can't be changed from here as this may not be their thread */
+				if (!obj.threadConfined && obj.managedObjectDomain && event.entity.managedObjectDomain && [obj.managedObjectDomain isEqualToString:event.entity.managedObjectDomain]) {
+					[obj notifyObjectChanges:event];
+				}
+				
+				if (obj.registeredEventBlocks.count > 0) {
+					[triggerableEventObjects addObject:obj];
+					[triggerableEvents addObject:event];
+				}
+				
+			}
+			
+		}
+		
+	}
+	
+	/* trigger any events that we have put by, block may modify the event objects so we can't do it with a lock around the array */
+	for (NSUInteger i = 0; i < triggerableEventObjects.count; i++) {
+		[[triggerableEventObjects objectAtIndex:i] triggerInternalEvent:[triggerableEvents objectAtIndex:i]];
+	}
+	
+	// table events
+	@synchronized(self.tableEventRegistry) {
+		for (SRKEvent* event in events) {
+			for (SRKRegistryEntry* o in [self.tableEventRegistry objectForKey:[event.entity.class description]]) {
+				SRKEventHandler* h = o.tableEventHandler;
+				[h triggerInternalEvent:event];
+			}
+		}
+	}
+	
+}
+
+- (void)broadcastSetEvent:(SRKEvent*)event primaryKeys:(NSArray*)primaryKeys values:(NSDictionary*)values {
+	
+	/* an event from a set based update/delete, there is no entity so the table handlers get a single event with the affected row count.  If the primary keys were captured then any live objects are brought up to date and notified individually */
+	
+	NSMutableArray* triggerableEventObjects = [NSMutableArray new];
+	NSString* eventTable = [event.entityClass description];
+	
+	for (id primaryKey in primaryKeys) {
+		
+		for (SRKEntity* obj in [self liveObjectsForTable:eventTable primaryKey:primaryKey]) {
+			
+			/* thread confined objects can't be changed from here as this may not be their thread */
+			if (!obj.threadConfined) {
+				for (NSString* property in values.allKeys) {
+					id value = [values objectForKey:property];
+					if ([value isKindOfClass:[SRKEntity class]]) {
+						value = ((SRKEntity*)value).Id;
+					} else if ([value isKindOfClass:[NSNull class]]) {
+						value = nil;
+					}
+					[obj setFieldRaw:property value:value];
+				}
+			}
+			
+			if (obj.registeredEventBlocks.count > 0) {
+				[triggerableEventObjects addObject:obj];
+			}
+			
+		}
+		
+	}
+	
+	/* trigger any events that we have put by, block may modify the event objects so we can't do it with a lock around the array */
+	for (SRKEntity* obj in triggerableEventObjects) {
+		SRKEvent* e = [SRKEvent new];
+		e.event = event.event;
+		e.entity = obj;
+		e.entityClass = event.entityClass;
+		e.affectedRows = 1;
+		e.changedProperties = event.changedProperties;
+		[obj triggerInternalEvent:e];
+	}
+	
+	// table events
+	@synchronized(self.tableEventRegistry) {
+		for (SRKRegistryEntry* o in [self.tableEventRegistry objectForKey:[event.entityClass description]]) {
+			SRKEventHandler* h = o.tableEventHandler;
+			[h triggerInternalEvent:event];
+		}
 	}
 	
 }
@@ -161,15 +264,8 @@ static SRKRegistry* this = nil;
 		return;
 	}
 	
-	/* create the storage object, needed to maintain a weak reference to the SRKObject */
-	
-	SRKRegistryEntry* o = [SRKRegistryEntry new];
-	o.entity = object;
-	o.sourceTable = [[object class] description];
-	o.tableEventHandler = nil;
-	
 	@synchronized(self.objectRegistry) {
-		[self.objectRegistry addObject:o];
+		[self addLiveObject:object];
 	}
 	
 }
@@ -185,15 +281,8 @@ static SRKRegistry* this = nil;
 			if (object.reflectedPrimaryKeyValue) {
 				
 				/* an object without an ID cannot be placed into the registry, as it can have no twins */
-				/* create the storage object, needed to maintain a weak reference to the SRKObject */
-				
-				SRKRegistryEntry* o = [SRKRegistryEntry new];
-				o.entity = object;
-				o.sourceTable = [[object class] description];
-				o.tableEventHandler = nil;
 				[object rawSetManagedObjectDomain:domain];
-				
-				[self.objectRegistry addObject:o];
+				[self addLiveObject:object];
 				
 			}
 		}
@@ -228,31 +317,21 @@ static SRKRegistry* this = nil;
 
 - (void)remove:(SRKEntity *)object {
 	
-	/* create the storage object, needed to maintain a weak reference to the SRKObject */
-	
-	SRKRegistryEntry* o = [SRKRegistryEntry new];
-	o.sourceTable = [[object class] description];
-	o.tableEventHandler = nil;
-	
-	NSMutableArray* freedObjects = [NSMutableArray new];
-	
 	@synchronized(self.objectRegistry) {
 		
-		for (SRKRegistryEntry* o in self.objectRegistry) {
-			
-			SRKEntity* obj = o.entity;
-			if (!obj || obj == object) {
-				[freedObjects addObject:o];
+		/* removed by the keys it was registered under, a deleted object no longer has a primary key to look itself up by */
+		for (NSString* key in object.registryKeys) {
+			/* when called from dealloc the weak reference has already gone, so this only has to drop the record once nothing is left alive for it */
+			NSHashTable* instances = [self.objectRegistry objectForKey:key];
+			[instances removeObject:object];
+			if (instances && instances.allObjects.count == 0) {
+				[self.objectRegistry removeObjectForKey:key];
 			}
-			
 		}
+		object.registryKeys = nil;
 		
 	}
 	
-	if (freedObjects.count > 0) {
-		[self performSelectorInBackground:@selector(freeObjects:) withObject:freedObjects];
-	}
-	
 }
 
 - (void)deregisterHandler:(SRKEventHandler *)handler {
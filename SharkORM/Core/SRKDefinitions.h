@@ -71,6 +71,20 @@
 
 #define SRK_DEFAULT_PRIMARY_KEY_NAME				@"Id"
 
+#define SRK_SPATIAL_INDEX_NAME_FORMAT           @"%@_rtree_%@_%@"
+#define SRK_FTS_INDEX_NAME_FORMAT               @"%@_fts"
+#define SRK_VIRTUAL_INDEX_DROP_FORMAT           @"DROP TRIGGER IF EXISTS %1$@_ai; DROP TRIGGER IF EXISTS %1$@_au; DROP TRIGGER IF EXISTS %1$@_ad; DROP TRIGGER IF EXISTS %1$@_bu; DROP TRIGGER IF EXISTS %1$@_bd; DROP TABLE IF EXISTS %1$@; "
+#define SRK_SPATIAL_EARTH_RADIUS                6378100.0
+#define SRK_BUSY_DEFAULT_TIMEOUT                10.0
+#define SRK_BUSY_DEFAULT_MAXIMUM_BACKOFF        0.1
+#define SRK_BUSY_INITIAL_BACKOFF                0.001
+#define SRK_BUSY_HISTOGRAM_BUCKETS              5
+#define SRK_GROUP_COMMIT_DEFAULT_MAXIMUM_ROWS   500
+#define SRK_DEFAULT_READ_CONNECTIONS            4
+#define SRK_IMPORT_DEFAULT_BATCH_SIZE           5000
+#define SRK_IMPORT_READ_BUFFER_SIZE             65536
+#define SRK_EXPORT_WRITE_BUFFER_SIZE            65536
+
 #define SuppressPerformSelectorLeakWarning(Stuff) \
 do { \
 _Pragma("clang diagnostic push") \
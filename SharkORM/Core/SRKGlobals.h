@@ -36,6 +36,29 @@
 - (void)removeHandleForName:(NSString*)key;
 - (void)addHandle:(void*)handle forDBName:(NSString*)dbHandle;
 
+// read only connections, opened alongside the writer in WAL mode.  A connection is checked out by one thread at a time, so they are opened without SQLite's own mutex
+- (void)addReadHandle:(void*)handle forDBName:(NSString*)dbName;
+- (void*)checkoutReadHandleForName:(NSString*)dbName;
+- (void)checkinReadHandle:(void*)handle forName:(NSString*)dbName;
+- (BOOL)hasReadHandlesForName:(NSString*)dbName;
+- (void)closeReadHandlesForName:(NSString*)dbName;
+
+// prepared statements, cached per database and only ever used whilst holding the write lock
+- (void*)cachedStatementForSQL:(NSString*)sql inDatabase:(NSString*)dbName;
+- (void)clearStatementCacheForDatabase:(NSString*)dbName;
+
+// group commit, pending entities are written together in a single transaction from a serial writer queue
+- (BOOL)groupCommitEnabled;
+- (BOOL)isGroupCommitWriter;
+- (void)enqueueGroupCommit:(SRKEntity*)entity;
+- (void)flushGroupCommit;
+
+// lock contention statistics
+- (void)recordBusyWait:(NSTimeInterval)wait after:(NSTimeInterval)waited;
+- (void)recordBusyTimeoutAfter:(NSTimeInterval)waited;
+- (SRKBusyStatistics*)busyStatistics;
+- (void)resetBusyStatistics;
+
 // delegate object
 - (void)setDelegate:(id<SRKDelegate>)delegate;
 - (id<SRKDelegate>)delegate;
@@ -43,8 +66,9 @@
 // settings
 - (SRKSettings*)settings;
 
-// locks
-- (id)writeLockObject;
+// locks, one per database as each has a single shared writer handle
+- (id)writeLockObjectForDatabase:(NSString*)dbName;
+- (void)performWithWriteLockForDatabases:(NSArray<NSString*>*)databases block:(void (^)(void))block;
 
 // global event callbacks
 - (void)setInsertCallback:(SRKGlobalEventCallback)callback;
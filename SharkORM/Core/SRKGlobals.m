@@ -23,6 +23,13 @@
 #import "SRKGlobals.h"
 #import "SharkORM.h"
 #import "Sqlite3.h"
+#import "SRKDefinitions.h"
+#import "SRKEntity+Private.h"
+#import "SRKEntityChain.h"
+#import "SRKSQLiteHandle.h"
+#import "SRKTransaction+Private.h"
+
+static void* SRKGroupCommitQueueKey = &SRKGroupCommitQueueKey;
 
 @interface SRKGlobals ()
 
@@ -32,12 +39,20 @@
 @property (strong) NSMutableDictionary*     sharkTableSchemas;
 @property (strong) NSMutableDictionary*     sharkPrimaryKeys;
 @property (strong) NSMutableDictionary*     sharkPrimaryTypes;
-@property (strong) NSObject*                SRK_LOCK_WRITE;
+@property (strong) NSMutableDictionary*     writeLocks;
 @property (strong) id<SRKDelegate>          ormDelegate;
 @property (copy) SRKGlobalEventCallback     insertCallbackBlock;
 @property (copy) SRKGlobalEventCallback     updateCallbackBlock;
 @property (copy) SRKGlobalEventCallback     deleteCallbackBlock;
 @property (strong) NSMutableDictionary*     fqnClassNames;
+@property (strong) NSMutableDictionary*     statementCache;
+@property (strong) NSMutableDictionary*     readHandles;
+@property (strong) NSMutableDictionary*     idleReadHandles;
+@property (strong) SRKBusyStatistics*       busyStats;
+@property (strong) NSMutableArray*          groupCommitEntities;
+@property (strong) NSHashTable*             groupCommitMembers;
+@property (strong) dispatch_queue_t         groupCommitQueue;
+@property BOOL                              groupCommitScheduled;
 
 @end
 
@@ -57,8 +72,8 @@
     self = [super init];
     if(self){
         _handles = malloc(255*sizeof(sqlite3*));
-        if (!_SRK_LOCK_WRITE) {
-            _SRK_LOCK_WRITE = [NSObject new];
+        if (!_writeLocks) {
+            _writeLocks = [NSMutableDictionary new];
         }
         
         if (!_databaseHandleIndex) {
@@ -81,6 +96,20 @@
         if (!_fqnClassNames) {
             _fqnClassNames = [[NSMutableDictionary alloc] init];
         }
+        
+        if (!_statementCache) {
+            _statementCache = [[NSMutableDictionary alloc] init];
+        }
+        
+        _readHandles = [NSMutableDictionary new];
+        _idleReadHandles = [NSMutableDictionary new];
+        
+        [self resetBusyStatistics];
+        
+        _groupCommitEntities = [NSMutableArray new];
+        _groupCommitMembers = [NSHashTable hashTableWithOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality];
+        _groupCommitQueue = dispatch_queue_create("SharkORM.groupcommit", DISPATCH_QUEUE_SERIAL);
+        dispatch_queue_set_specific(_groupCommitQueue, SRKGroupCommitQueueKey, SRKGroupCommitQueueKey, NULL);
     }
     return self;
 }
@@ -125,8 +154,82 @@
 }
 
 - (void)addHandle:(void*)handle forDBName:(NSString*)dbName {
-    self.handles[[self countOfHandles]] = handle;
-    [self.databaseHandleIndex setObject:@(self.databaseHandleIndex.allKeys.count) forKey:dbName];
+    @synchronized (self.databaseHandleIndex) {
+        self.handles[[self countOfHandles]] = handle;
+        [self.databaseHandleIndex setObject:@(self.databaseHandleIndex.allKeys.count) forKey:dbName];
+    }
+}
+
+- (void)addReadHandle:(void*)handle forDBName:(NSString*)dbName {
+    
+    @synchronized (_readHandles) {
+        
+        if (![_readHandles objectForKey:dbName]) {
+            [_readHandles setObject:[NSMutableArray new] forKey:dbName];
+            [_idleReadHandles setObject:[NSMutableArray new] forKey:dbName];
+        }
+        
+        SRKSQLiteHandle* h = [[SRKSQLiteHandle alloc] initWithHandle:handle];
+        [[_readHandles objectForKey:dbName] addObject:h];
+        [[_idleReadHandles objectForKey:dbName] addObject:h];
+        
+    }
+    
+}
+
+- (void*)checkoutReadHandleForName:(NSString*)dbName {
+    
+    /* there is no waiting for a reader, if they are all in use the caller falls back to the writer connection */
+    @synchronized (_readHandles) {
+        
+        NSMutableArray* idle = [_idleReadHandles objectForKey:dbName];
+        SRKSQLiteHandle* h = idle.lastObject;
+        if (!h) {
+            return NULL;
+        }
+        [idle removeLastObject];
+        return h.databaseHandle;
+        
+    }
+    
+}
+
+- (void)checkinReadHandle:(void*)handle forName:(NSString*)dbName {
+    
+    @synchronized (_readHandles) {
+        
+        for (SRKSQLiteHandle* h in [_readHandles objectForKey:dbName]) {
+            if (h.databaseHandle == handle) {
+                [[_idleReadHandles objectForKey:dbName] addObject:h];
+                break;
+            }
+        }
+        
+    }
+    
+}
+
+- (BOOL)hasReadHandlesForName:(NSString*)dbName {
+    
+    @synchronized (_readHandles) {
+        return [[_readHandles objectForKey:dbName] count] > 0;
+    }
+    
+}
+
+- (void)closeReadHandlesForName:(NSString*)dbName {
+    
+    @synchronized (_readHandles) {
+        
+        /* anything still checked out becomes a zombie, which SQLite will close once its last statement has been finalized */
+        for (SRKSQLiteHandle* h in [_readHandles objectForKey:dbName]) {
+            sqlite3_close_v2(h.databaseHandle);
+        }
+        [_readHandles removeObjectForKey:dbName];
+        [_idleReadHandles removeObjectForKey:dbName];
+        
+    }
+    
 }
 
 - (void)setDelegate:(id<SRKDelegate>)delegate {
@@ -158,12 +261,257 @@
     }
 }
 
+- (void*)cachedStatementForSQL:(NSString*)sql inDatabase:(NSString*)dbName {
+    
+    @synchronized (_statementCache) {
+        
+        NSMutableDictionary* statements = [_statementCache objectForKey:dbName];
+        if (!statements) {
+            statements = [NSMutableDictionary new];
+            [_statementCache setObject:statements forKey:dbName];
+        }
+        
+        NSValue* cached = [statements objectForKey:sql];
+        if (cached) {
+            return cached.pointerValue;
+        }
+        
+        sqlite3_stmt* statement = NULL;
+        if (sqlite3_prepare_v3([self handleForName:dbName], sql.UTF8String, -1, SQLITE_PREPARE_PERSISTENT, &statement, NULL) != SQLITE_OK) {
+            sqlite3_finalize(statement);
+            return NULL;
+        }
+        
+        [statements setObject:[NSValue valueWithPointer:statement] forKey:sql];
+        return statement;
+        
+    }
+    
+}
+
+- (void)clearStatementCacheForDatabase:(NSString*)dbName {
+    
+    @synchronized (_statementCache) {
+        
+        NSMutableDictionary* statements = [_statementCache objectForKey:dbName];
+        for (NSValue* cached in statements.allValues) {
+            sqlite3_finalize(cached.pointerValue);
+        }
+        [_statementCache removeObjectForKey:dbName];
+        
+    }
+    
+}
+
+- (BOOL)groupCommitEnabled {
+    return self.settings.groupCommitWindow > 0;
+}
+
+- (BOOL)isGroupCommitWriter {
+    return dispatch_get_specific(SRKGroupCommitQueueKey) != NULL;
+}
+
+- (void)enqueueGroupCommit:(SRKEntity*)entity {
+    
+    SRKSettings* settings = self.settings;
+    BOOL writeNow = NO;
+    
+    @synchronized (self.groupCommitEntities) {
+        
+        /* repeat commits of the same object are merged, it is written with whatever values it has when the group is written */
+        if (![self.groupCommitMembers containsObject:entity]) {
+            [self.groupCommitMembers addObject:entity];
+            [self.groupCommitEntities addObject:entity];
+        }
+        
+        if (settings.groupCommitMaximumRows > 0 && self.groupCommitEntities.count >= settings.groupCommitMaximumRows) {
+            writeNow = YES;
+        } else if (!self.groupCommitScheduled) {
+            self.groupCommitScheduled = YES;
+            dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(settings.groupCommitWindow * NSEC_PER_SEC)), self.groupCommitQueue, ^{
+                [self writeGroupCommit];
+            });
+        }
+        
+    }
+    
+    if (writeNow) {
+        dispatch_async(self.groupCommitQueue, ^{
+            [self writeGroupCommit];
+        });
+    }
+    
+}
+
+- (void)writeGroupCommit {
+    
+    NSArray* batch = nil;
+    @synchronized (self.groupCommitEntities) {
+        batch = [self.groupCommitEntities copy];
+        [self.groupCommitEntities removeAllObjects];
+        [self.groupCommitMembers removeAllObjects];
+        self.groupCommitScheduled = NO;
+    }
+    
+    if (!batch.count) {
+        return;
+    }
+    
+    if (![SRKEntity commitAll:batch]) {
+        /* one bad row shouldn't lose everybody else's changes, so fall back to writing them one at a time */
+        for (SRKEntity* entity in batch) {
+            [entity __commitRawWithObjectChain:[SRKEntityChain new]];
+        }
+    }
+    
+}
+
+- (void)flushGroupCommit {
+    
+    if (![self groupCommitEnabled]) {
+        return;
+    }
+    
+    /*
+     *  the queue was flushed when the transaction began, anything queued since then was committed by another thread outside of it and must not
+     *  be pulled into (and rolled back with) this transaction.  It is written by the writer queue once the transaction has finished.
+     */
+    if ([SRKTransaction transactionIsInProgressForThisThread]) {
+        return;
+    }
+    
+    if ([self isGroupCommitWriter]) {
+        [self writeGroupCommit];
+    } else {
+        dispatch_sync(self.groupCommitQueue, ^{
+            [self writeGroupCommit];
+        });
+    }
+    
+}
+
+static int busyHistogramBucket(NSTimeInterval wait) {
+    
+    /* buckets go up in powers of 10 from 1ms, the last one catches everything else */
+    int bucket = 0;
+    double limit = 0.001;
+    while (bucket < SRK_BUSY_HISTOGRAM_BUCKETS - 1 && wait >= limit) {
+        bucket++;
+        limit *= 10;
+    }
+    return bucket;
+    
+}
+
+- (void)recordBusyWait:(NSTimeInterval)wait after:(NSTimeInterval)waited {
+    
+    @synchronized (self) {
+        
+        /*
+         *  recorded as each retry is made, so the statistics are up to date as soon as the wait ends however the statement was run.  The first retry
+         *  is a new contention event, after that the event moves up the histogram as its total wait grows.
+         */
+        NSMutableArray* histogram = [self.busyStats.waitHistogram mutableCopy];
+        if (waited == 0) {
+            self.busyStats.contentionEvents++;
+        } else {
+            int previous = busyHistogramBucket(waited);
+            [histogram replaceObjectAtIndex:previous withObject:@([[histogram objectAtIndex:previous] unsignedLongLongValue] - 1)];
+        }
+        int bucket = busyHistogramBucket(waited + wait);
+        [histogram replaceObjectAtIndex:bucket withObject:@([[histogram objectAtIndex:bucket] unsignedLongLongValue] + 1)];
+        self.busyStats.waitHistogram = histogram;
+        
+        self.busyStats.retries++;
+        self.busyStats.totalWaitTime += wait;
+        
+    }
+    
+}
+
+- (void)recordBusyTimeoutAfter:(NSTimeInterval)waited {
+    
+    @synchronized (self) {
+        
+        self.busyStats.timeouts++;
+        if (waited == 0) {
+            /* gave up without a single retry, so the event has not been counted yet */
+            self.busyStats.contentionEvents++;
+            NSMutableArray* histogram = [self.busyStats.waitHistogram mutableCopy];
+            [histogram replaceObjectAtIndex:0 withObject:@([[histogram objectAtIndex:0] unsignedLongLongValue] + 1)];
+            self.busyStats.waitHistogram = histogram;
+        }
+        
+    }
+    
+}
+
+- (SRKBusyStatistics*)busyStatistics {
+    
+    SRKBusyStatistics* snapshot = [SRKBusyStatistics new];
+    @synchronized (self) {
+        snapshot.contentionEvents = self.busyStats.contentionEvents;
+        snapshot.retries = self.busyStats.retries;
+        snapshot.timeouts = self.busyStats.timeouts;
+        snapshot.totalWaitTime = self.busyStats.totalWaitTime;
+        snapshot.waitHistogram = [self.busyStats.waitHistogram copy];
+    }
+    return snapshot;
+    
+}
+
+- (void)resetBusyStatistics {
+    
+    SRKBusyStatistics* stats = [SRKBusyStatistics new];
+    NSMutableArray* histogram = [NSMutableArray new];
+    for (int i = 0; i < SRK_BUSY_HISTOGRAM_BUCKETS; i++) {
+        [histogram addObject:@(0)];
+    }
+    stats.waitHistogram = histogram;
+    @synchronized (self) {
+        self.busyStats = stats;
+    }
+    
+}
+
 - (void)removeHandleForName:(NSString*)key {
     [self.databaseHandleIndex removeObjectForKey:key];
 }
 
-- (id)writeLockObject {
-    return self.SRK_LOCK_WRITE;
+- (id)writeLockObjectForDatabase:(NSString*)dbName {
+    
+    /* each database has a single writer handle, so writes to different databases have nothing to be kept apart from and only wait on their own database */
+    NSString* key = dbName ? dbName : @"";
+    @synchronized (self.writeLocks) {
+        NSObject* lock = [self.writeLocks objectForKey:key];
+        if (!lock) {
+            lock = [NSObject new];
+            [self.writeLocks setObject:lock forKey:key];
+        }
+        return lock;
+    }
+    
+}
+
+static void performWithWriteLocks(NSArray<NSString*>* databases, NSUInteger index, void (^block)(void)) {
+    
+    if (index == databases.count) {
+        block();
+        return;
+    }
+    
+    @synchronized ([[SRKGlobals sharedObject] writeLockObjectForDatabase:[databases objectAtIndex:index]]) {
+        performWithWriteLocks(databases, index + 1, block);
+    }
+    
+}
+
+- (void)performWithWriteLockForDatabases:(NSArray<NSString*>*)databases block:(void (^)(void))block {
+    
+    /* the locks are always taken in the same order, so two batches over the same databases can't each be holding one that the other is waiting for */
+    NSArray* ordered = [[[NSSet setWithArray:databases] allObjects] sortedArrayUsingSelector:@selector(compare:)];
+    performWithWriteLocks(ordered, 0, block);
+    
 }
 
 - (NSMutableDictionary*)tableSchemas {
@@ -23,6 +23,7 @@
 
 
 #import "SharkORM.h"
+#import "SRKDefinitions.h"
 
 @implementation SRKSettings
 
@@ -42,6 +43,13 @@
 		self.encryptionKey = @"bvzdsrthjnbvcxdfrtyuijbvcxdrtyuhjbvcxdfsdfghjcfhjw45678iuojkbnvcxfe5678uijhvgcf";
 		self.retainLightweightObjects = NO;
 		self.sqliteJournalingMode = @"WAL";
+		self.busyTimeout = SRK_BUSY_DEFAULT_TIMEOUT;
+		self.busyMaximumBackoff = SRK_BUSY_DEFAULT_MAXIMUM_BACKOFF;
+		self.groupCommitWindow = 0;
+		self.groupCommitMaximumRows = SRK_GROUP_COMMIT_DEFAULT_MAXIMUM_ROWS;
+		self.primaryKeyFormat = SRKPrimaryKeyFormatUUID;
+		self.readConnections = SRK_DEFAULT_READ_CONNECTIONS;
+		self.eventCoalescingWindow = 0;
 		
 	}
 	return self;
@@ -29,6 +29,9 @@
 @interface SRKUtilities : NSObject
 
 + (NSString*)generateGUID;
++ (NSString*)generateTimeOrderedGUID;
++ (NSString*)generateULID;
++ (NSString*)generatePrimaryKeyForClass:(Class)entityClass;
 - (NSString *)originalColumnName:(NSString *)columnName;
 - (NSString *)normalizedColumnName:(NSString *)columnName;
 - (NSString *)propertyNameFromSelector:(SEL)selector forObject:(SRKEntity*)object;
@@ -35,6 +35,101 @@
     
 }
 
+static uint64_t srkLastKeyTime = 0;
+static unsigned char srkLastKeyBytes[16];
+
+/* fills 'bytes' with a 48 bit millisecond timestamp followed by random data, if called again within the same millisecond the random portion is incremented instead so keys are always ascending */
+static void srkTimeOrderedBytes(unsigned char* bytes) {
+    
+    @synchronized([SRKUtilities class]) {
+        
+        uint64_t now = (uint64_t)([[NSDate date] timeIntervalSince1970] * 1000);
+        
+        if (now <= srkLastKeyTime) {
+            
+            // same (or an earlier, the clock went backwards) millisecond, so carry on from the last key
+            for (int i = 15; i >= 6; i--) {
+                if (++srkLastKeyBytes[i] != 0) {
+                    break;
+                }
+            }
+            
+        } else {
+            
+            srkLastKeyTime = now;
+            for (int i = 0; i < 6; i++) {
+                srkLastKeyBytes[i] = (unsigned char)(now >> (40 - (i * 8)));
+            }
+            arc4random_buf(&srkLastKeyBytes[6], 10);
+            // leave headroom in the counter, so that a run of keys within the same millisecond does not overflow
+            srkLastKeyBytes[6] &= 0x7F;
+            
+        }
+        
+        memcpy(bytes, srkLastKeyBytes, 16);
+        
+    }
+    
+}
+
++ (NSString*)generateTimeOrderedGUID {
+    
+    /* UUIDv7 layout, the version and variant bits overwrite part of the counter so they are set after the ordering has been decided */
+    unsigned char b[16];
+    srkTimeOrderedBytes(b);
+    b[6] = 0x70 | (b[6] >> 4);
+    b[8] = 0x80 | (b[8] & 0x3F);
+    
+    return [NSString stringWithFormat:@"%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x", b[0], b[1], b[2], b[3], b[4], b[5], b[6], b[7], b[8], b[9], b[10], b[11], b[12], b[13], b[14], b[15]];
+    
+}
+
++ (NSString*)generateULID {
+    
+    /* 128 bits encoded as 26 characters of Crockford's base32, the first character only carries 3 bits */
+    static const char* alphabet = "0123456789ABCDEFGHJKMNPQRSTVWXYZ";
+    unsigned char b[16];
+    srkTimeOrderedBytes(b);
+    
+    char ulid[27];
+    for (int c = 0; c < 26; c++) {
+        int value = 0;
+        for (int n = (c * 5) - 2; n < (c * 5) + 3; n++) {
+            value <<= 1;
+            if (n >= 0) {
+                value |= (b[n / 8] >> (7 - (n % 8))) & 1;
+            }
+        }
+        ulid[c] = alphabet[value];
+    }
+    ulid[26] = 0;
+    
+    return [NSString stringWithUTF8String:ulid];
+    
+}
+
++ (NSString*)generatePrimaryKeyForClass:(Class)entityClass {
+    
+    SRKSettings* settings = [SharkORM getSettings];
+    
+    if (settings.primaryKeyGenerator) {
+        NSString* key = settings.primaryKeyGenerator(entityClass);
+        if (key) {
+            return key;
+        }
+    }
+    
+    switch (settings.primaryKeyFormat) {
+        case SRKPrimaryKeyFormatUUIDv7:
+            return [SRKUtilities generateTimeOrderedGUID];
+        case SRKPrimaryKeyFormatULID:
+            return [SRKUtilities generateULID];
+        default:
+            return [SRKUtilities generateGUID];
+    }
+    
+}
+
 - (id)sqlite3_column_objc:(sqlite3_stmt *)stmt column:(int)i {
     
     /* detect the column type and convert to an objective_c object */
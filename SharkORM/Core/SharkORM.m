@@ -64,6 +64,352 @@ typedef enum : int {
 
 @end
 
+@implementation SRKBusyStatistics
+
+@end
+
+/*
+ *  busy handling, rather than spinning on SQLITE_BUSY the connection waits with an exponential backoff up to the configured maximum wait, after which the
+ *  statement fails and the error is passed back to the caller.  Each retry is recorded in the statistics as it is made, the wait so far is kept per thread.
+ *  Only the database's own write lock is held whilst a writer waits, so writers to other databases carry on.
+ */
+
+static __thread double srkBusyWaitTime = 0;
+
+static int srkBusyHandler(void* context, int count) {
+    
+    if (count == 0) {
+        /* a new contention event */
+        srkBusyWaitTime = 0;
+    }
+    
+    SRKSettings* settings = [[SRKGlobals sharedObject] settings];
+    double delay = MIN(SRK_BUSY_INITIAL_BACKOFF * (double)(1 << MIN(count, 16)), settings.busyMaximumBackoff);
+    
+    if (srkBusyWaitTime + delay > settings.busyTimeout) {
+        [[SRKGlobals sharedObject] recordBusyTimeoutAfter:srkBusyWaitTime];
+        return 0;
+    }
+    
+    usleep((useconds_t)(delay * 1000000));
+    [[SRKGlobals sharedObject] recordBusyWait:delay after:srkBusyWaitTime];
+    srkBusyWaitTime += delay;
+    
+    return 1;
+    
+}
+
+/*
+ *  bulk import, records are handed over one at a time and buffered into a batch of bound values, each batch is then written within its own transaction using a
+ *  single cached INSERT.  Nothing is held beyond the current batch, so memory use does not depend on the size of the source.  No entities are created, so no entity events are raised.
+ */
+
+static BOOL srkParseDateTime(const char* s, int length, double* result);
+
+@interface SRKBulkImport : NSObject
+
+@property uint64_t imported;
+@property uint64_t bytesRead;
+@property uint64_t totalBytes;
+@property BOOL failed;
+
+- (instancetype)initWithClass:(Class)classDecl options:(SRKImportOptions*)options;
+- (BOOL)addRecord:(NSDictionary*)record;
+- (BOOL)finish;
+
+@end
+
+@implementation SRKBulkImport {
+    Class                   entityClass;
+    NSString*               entityName;
+    NSString*               databaseName;
+    SRKImportOptions*       importOptions;
+    NSArray*                columns;
+    NSMutableDictionary*    columnIndexes;
+    NSMutableDictionary*    resolvedKeys;
+    NSSet*                  dateColumns;
+    NSString*               insertSql;
+    NSMutableArray*         batch;
+    NSMutableDictionary*    droppedIndexes;
+    BOOL                    stringPrimaryKey;
+}
+
+- (instancetype)initWithClass:(Class)classDecl options:(SRKImportOptions*)options {
+    
+    self = [super init];
+    if (self) {
+        
+        /* referencing the class makes sure the table exists and is up to date */
+        entityClass = classDecl;
+        entityName = [classDecl description];
+        databaseName = [SharkORM databaseNameForClass:classDecl];
+        importOptions = options;
+        batch = [NSMutableArray new];
+        resolvedKeys = [NSMutableDictionary new];
+        columnIndexes = [NSMutableDictionary new];
+        droppedIndexes = [NSMutableDictionary new];
+        stringPrimaryKey = ([SharkSchemaManager.shared schemaPrimaryKeyTypeForEntity:entityName] == SRK_PROPERTY_TYPE_STRING);
+        
+        /* encrypted values have to pass through an entity to be written, so they can not be imported */
+        NSArray* encryptedProperties = [classDecl encryptedPropertiesForClass];
+        NSMutableArray* importable = [NSMutableArray new];
+        NSMutableSet* dates = [NSMutableSet new];
+        for (NSString* property in [SharkSchemaManager.shared schemaPropertiesForEntity:entityName]) {
+            if ([encryptedProperties containsObject:property]) {
+                continue;
+            }
+            [columnIndexes setObject:@(importable.count) forKey:property];
+            [importable addObject:property];
+            if ([SharkSchemaManager.shared schemaPropertyType:entityName property:property] == SRK_PROPERTY_TYPE_DATE) {
+                [dates addObject:property];
+            }
+        }
+        columns = importable;
+        dateColumns = dates;
+        
+        NSMutableArray* placeholders = [NSMutableArray arrayWithCapacity:columns.count];
+        for (NSUInteger i = 0; i < columns.count; i++) {
+            [placeholders addObject:@"?"];
+        }
+        NSString* policy = options.conflictPolicy == SRKConflictPolicyReplace ? @" OR REPLACE" : options.conflictPolicy == SRKConflictPolicyIgnore ? @" OR IGNORE" : @"";
+        insertSql = [NSString stringWithFormat:@"INSERT%@ INTO %@ (%@) VALUES (%@);", policy, entityName, [columns componentsJoinedByString:@", "], [placeholders componentsJoinedByString:@", "]];
+        
+        /* anything sitting in the group commit queue goes first, so the import can't overtake it */
+        [[SRKGlobals sharedObject] flushGroupCommit];
+        
+        /* maintaining the secondary indexes row by row is far slower than building them once at the end.  Unique indexes are left alone as they enforce the conflict policy, and within a transaction the indexes are left as they are */
+        [SRKTransaction blockUntilTransactionFinishedForDatabase:databaseName];
+        if (options.deferIndexes && ![SRKTransaction transactionIsInProgress]) {
+            NSDictionary* indexes = [SharkSchemaManager.shared schemaIndexDefinitionsForEntity:entityName];
+            for (NSString* name in indexes.allKeys) {
+                if ([[indexes objectForKey:name] hasPrefix:@"CREATE INDEX "]) {
+                    [SharkORM executeSQL:[NSString stringWithFormat:@"DROP INDEX IF EXISTS %@;", name] inDatabase:databaseName];
+                    [droppedIndexes setObject:[indexes objectForKey:name] forKey:name];
+                }
+            }
+        }
+        
+    }
+    return self;
+    
+}
+
+- (NSString*)columnForKey:(NSString*)key {
+    
+    /* keys are resolved once, through the mapping if there is one and then by a case insensitive match against the properties */
+    id column = [resolvedKeys objectForKey:key];
+    if (!column) {
+        NSString* mapped = [importOptions.columnMapping objectForKey:key];
+        column = mapped ? mapped : key;
+        if (![columnIndexes objectForKey:column]) {
+            column = [NSNull null];
+            for (NSString* property in columns) {
+                if ([property caseInsensitiveCompare:mapped ? mapped : key] == NSOrderedSame) {
+                    column = property;
+                    break;
+                }
+            }
+        }
+        [resolvedKeys setObject:column forKey:key];
+    }
+    
+    return [column isKindOfClass:[NSNull class]] ? nil : column;
+    
+}
+
+- (BOOL)addRecord:(NSDictionary*)record {
+    
+    if (self.failed) {
+        return NO;
+    }
+    
+    NSMutableArray* values = [NSMutableArray arrayWithCapacity:columns.count];
+    for (NSUInteger i = 0; i < columns.count; i++) {
+        [values addObject:[NSNull null]];
+    }
+    
+    BOOL populated = NO;
+    for (NSString* key in record) {
+        
+        NSString* column = [self columnForKey:key];
+        id value = [record objectForKey:key];
+        
+        if (!column) {
+            continue;
+        }
+        
+        if ([value isKindOfClass:[NSString class]] && [dateColumns containsObject:column] && [[SharkORM getSettings] useEpochDates]) {
+            double epoch = 0;
+            const char* text = [(NSString*)value UTF8String];
+            if (srkParseDateTime(text, (int)strlen(text), &epoch)) {
+                value = @(epoch);
+            }
+        }
+        
+        [values replaceObjectAtIndex:[[columnIndexes objectForKey:column] unsignedIntegerValue] withObject:value];
+        populated = YES;
+        
+    }
+    
+    if (!populated) {
+        return YES;
+    }
+    
+    NSNumber* pkIndex = [columnIndexes objectForKey:SRK_DEFAULT_PRIMARY_KEY_NAME];
+    if (stringPrimaryKey && pkIndex && [[values objectAtIndex:pkIndex.unsignedIntegerValue] isKindOfClass:[NSNull class]]) {
+        [values replaceObjectAtIndex:pkIndex.unsignedIntegerValue withObject:[SRKUtilities generatePrimaryKeyForClass:entityClass]];
+    }
+    
+    [batch addObject:values];
+    if (batch.count >= MAX(importOptions.batchSize, 1)) {
+        return [self writeBatch];
+    }
+    
+    return YES;
+    
+}
+
+- (BOOL)writeBatch {
+    
+    if (!batch.count) {
+        return !self.failed;
+    }
+    
+    BOOL succeeded = YES;
+    uint64_t written = 0;
+    NSString* errorMessage = nil;
+    
+    // the following will block if there is a transaction occouring for anything other than a current transaction block
+    [SRKTransaction blockUntilTransactionFinishedForDatabase:databaseName];
+    
+    BOOL inTransaction = [SRKTransaction transactionIsInProgress];
+    if (inTransaction) {
+        
+        // within a transaction the batches become part of it, so are committed or rolled back along with everything else
+        if ([SRKTransaction currentTransactionStatus] != SRKTransactionPassed || ![SRKTransaction startTransactionForDatabaseConnection:databaseName]) {
+            [batch removeAllObjects];
+            self.failed = YES;
+            return NO;
+        }
+        
+    }
+    
+    @synchronized([[SRKGlobals sharedObject] writeLockObjectForDatabase:databaseName]) {
+        
+        SharkORM* orm = [SharkORM new];
+        sqlite3* databaseHandle = [SharkORM handleForDatabase:databaseName];
+        
+        /* another thread's transaction may have the shared handle open since we last checked, the batch cannot be kept apart from it so it fails */
+        BOOL beginFailed = (!inTransaction && ![SharkORM executeSQL:@"BEGIN IMMEDIATE TRANSACTION" inDatabase:databaseName errorMessage:&errorMessage]);
+        if (beginFailed) {
+            succeeded = NO;
+        }
+        
+        /* replaced rows need their delete triggers to fire, to keep any virtual table indexes in step */
+        BOOL recursiveTriggers = (succeeded && importOptions.conflictPolicy == SRKConflictPolicyReplace && [SharkSchemaManager.shared schemaEntityHasVirtualIndexes:entityName]);
+        if (recursiveTriggers) {
+            sqlite3_exec(databaseHandle, "PRAGMA recursive_triggers = ON;", 0, 0, 0);
+        }
+        
+        for (NSArray* values in succeeded ? batch : nil) {
+            if ([orm executeCachedStatement:insertSql values:values inDatabase:databaseName errorMessage:&errorMessage] != SQLITE_DONE) {
+                succeeded = NO;
+                break;
+            }
+            written += sqlite3_changes(databaseHandle);
+        }
+        
+        if (recursiveTriggers) {
+            sqlite3_exec(databaseHandle, "PRAGMA recursive_triggers = OFF;", 0, 0, 0);
+        }
+        
+        if (!inTransaction && !beginFailed) {
+            [SharkORM executeSQL:succeeded ? @"COMMIT" : @"ROLLBACK" inDatabase:databaseName];
+        }
+        
+    }
+    
+    [batch removeAllObjects];
+    
+    if (!succeeded) {
+        
+        self.failed = YES;
+        if (inTransaction) {
+            [SRKTransaction failTransactionWithCode:SRKTransactionFailed];
+        }
+        
+        if ([[SRKGlobals sharedObject] delegate] && [[[SRKGlobals sharedObject] delegate] respondsToSelector:@selector(databaseError:)]) {
+            SRKError* e = [SRKError new];
+            e.sqlQuery = insertSql;
+            e.errorMessage = errorMessage;
+            [[[SRKGlobals sharedObject] delegate] databaseError:e];
+        }
+        
+        return NO;
+        
+    }
+    
+    self.imported += written;
+    if (importOptions.progress) {
+        importOptions.progress(self.imported, self.bytesRead, self.totalBytes);
+    }
+    
+    return YES;
+    
+}
+
+- (BOOL)finish {
+    
+    BOOL succeeded = [self writeBatch];
+    
+    /* indexes are put back whatever happened, as the rows from the earlier batches remain */
+    for (NSString* name in droppedIndexes.allKeys) {
+        [SharkORM executeSQL:[droppedIndexes objectForKey:name] inDatabase:databaseName];
+    }
+    [droppedIndexes removeAllObjects];
+    
+    /* there is no entity for each row, so the table handlers get a single event with the number of rows */
+    if (self.imported && ![entityClass entityDoesNotRaiseEvents]) {
+        SRKEvent* e = [SRKEvent new];
+        e.event = SharkORMEventInsert;
+        e.entityClass = entityClass;
+        e.affectedRows = self.imported;
+        [[SRKRegistry sharedInstance] broadcastSetEvent:e primaryKeys:nil values:nil];
+    }
+    
+    return succeeded;
+    
+}
+
+@end
+
+/*
+ *  read snapshots, whilst a snapshot block is running its thread has one read connection pinned per database in an open read transaction.  WAL keeps every
+ *  query on that connection looking at the database as it was at the first read, however much is committed in the meantime.
+ */
+
+#define SRKReadSnapshotKey @"SRKReadSnapshot"
+
+@interface SRKReadSnapshot : NSObject
+
+@property (strong) NSMutableDictionary*     handles;
+@property (strong) NSMutableSet*            openedDatabases;
+
+@end
+
+@implementation SRKReadSnapshot
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        self.handles = [NSMutableDictionary new];
+        self.openedDatabases = [NSMutableSet new];
+    }
+    return self;
+}
+
+@end
+
 @implementation SharkORM
 
 + (SRKConfiguration *)setStartupConfiguration:(SRKConfigurationBlock)configBlock {
@@ -86,101 +432,78 @@ typedef enum : int {
 
 + (void)migrateFromLegacyCoredataFile:(NSString*)filePath tables:(NSArray<NSString*>*)tablesToConvert {
     
-    NSMutableDictionary* results = [NSMutableDictionary new];
-    
-    sqlite3* tempDb;
-    sqlite3_open(filePath.UTF8String, &tempDb);
-    if (tempDb) {
+    sqlite3* tempDb = NULL;
+    if (sqlite3_open_v2(filePath.UTF8String, &tempDb, SQLITE_OPEN_READONLY, NULL) == SQLITE_OK) {
         
         for (NSString* currentT in tablesToConvert) {
             
             @autoreleasepool {
                 
-                /* get a list of tables form this database */
-                sqlite3_stmt* tableList = nil;
-                if (sqlite3_prepare_v2(tempDb, [NSString stringWithFormat:@"SELECT DISTINCT tbl_name FROM sqlite_master WHERE tbl_name ='%@';",[NSString stringWithFormat:@"Z%@", currentT.uppercaseString]].UTF8String, -1, &tableList, nil) == SQLITE_OK) {
-                    
-                    while (sqlite3_step(tableList) == SQLITE_ROW) {
-                        
-                        NSString* currentTable = (NSString*)[[SRKUtilities new] sqlite3_column_objc:tableList column:0];
-                        [results setObject:[NSMutableArray new] forKey:currentTable];
-                        
-                        /* now get all the data */
-                        sqlite3_stmt* tableContents = nil;
-                        if (sqlite3_prepare_v2(tempDb, [NSString stringWithFormat:@"SELECT * FROM %@;", currentTable].UTF8String, -1, &tableContents, nil) == SQLITE_OK) {
-                            
-                            while (sqlite3_step(tableContents) == SQLITE_ROW) {
-                                
-                                NSMutableDictionary* record = [NSMutableDictionary new];
-                                
-                                for (int i=0; i < sqlite3_column_count(tableContents); i++) {
-                                    
-                                    NSString* key = [NSString stringWithUTF8String:sqlite3_column_name(tableContents, i)];
-                                    SRKUtilities* dba = [SRKUtilities new];
-                                    key = [dba normalizedColumnName:key];
-                                    
-                                    NSObject* value = [[SRKUtilities new] sqlite3_column_objc:tableContents column:i];
-                                    [record setObject:value forKey:key];
-                                    
-                                }
-                                
-                                NSMutableArray* thisArray = [results objectForKey:currentTable];
-                                [thisArray addObject:record];
-                                
-                            }
-                            
-                        }
-                        
-                    }
-                    
+                NSString* currentTableName = currentT;
+                if (!NSClassFromString(currentTableName)) {
+                    currentTableName = [[SRKGlobals sharedObject] getFQNameForClass:currentT];
                 }
-                sqlite3_finalize(tableList);
-                
-                
-                /* now go through the specified tables to convert them */
-                
-                /* we need to perform all of these writes within a single transaction */
-                SRKContext* context = [SRKContext new];
                 
+                Class entityClass = NSClassFromString(currentTableName);
+                if (!entityClass) {
+                    continue;
+                }
                 
                 /* remove all existing data in these tables */
-                NSString* currentTableName = currentT;
-                if (!NSClassFromString(currentTableName)) {
-                    currentTableName = [[SRKGlobals sharedObject] getFQNameForClass:currentT];
+                [[entityClass query] deleteAll];
+                
+                /* CoreData prefixes the upper cased names with a 'Z' */
+                NSMutableDictionary* mapping = [NSMutableDictionary new];
+                for (NSString* currentField in [SharkSchemaManager.shared schemaPropertiesForEntity:[entityClass description]]) {
+                    [mapping setObject:currentField forKey:[NSString stringWithFormat:@"Z%@", currentField.uppercaseString]];
                 }
                 
-                [[[NSClassFromString(currentTableName) query] fetchLightweight] remove];
+                SRKImportOptions* options = [SRKImportOptions new];
+                options.columnMapping = mapping;
                 
-                NSArray* oldTableData = [results objectForKey:[NSString stringWithFormat:@"Z%@", currentT.uppercaseString]];
-                if (oldTableData) {
-                    for (NSDictionary* record in oldTableData) {
-                        
+                /* the rows are streamed straight from the old table into the import, rather than loading the whole table first */
+                sqlite3_stmt* tableContents = nil;
+                if (sqlite3_prepare_v2(tempDb, [NSString stringWithFormat:@"SELECT * FROM Z%@;", currentT.uppercaseString].UTF8String, -1, &tableContents, nil) == SQLITE_OK) {
+                    
+                    SRKBulkImport* import = [[SRKBulkImport alloc] initWithClass:entityClass options:options];
+                    SRKUtilities* dba = [SRKUtilities new];
+                    
+                    NSMutableArray* keys = [NSMutableArray new];
+                    for (int i=0; i < sqlite3_column_count(tableContents); i++) {
+                        [keys addObject:[NSString stringWithUTF8String:sqlite3_column_name(tableContents, i)]];
+                    }
+                    
+                    BOOL more = YES;
+                    while (more) {
                         @autoreleasepool {
-                            /* create a new SRKObject based on this class */
-                            SRKEntity* newRecord = [NSClassFromString(currentTableName) new];
-                            if (newRecord) {
-                                for (NSString* currentField in newRecord.fieldNames) {
-                                    
-                                    id value = [record objectForKey:[NSString stringWithFormat:@"Z%@", currentField.uppercaseString]];
-                                    if (!value) {
-                                        value = [NSNull null];
-                                    }
-                                    
-                                    [newRecord setFieldRaw:currentField value:value];
-                                    
+                            for (NSUInteger row = 0; row < options.batchSize && more; row++) {
+                                
+                                if (sqlite3_step(tableContents) != SQLITE_ROW) {
+                                    more = NO;
+                                    break;
+                                }
+                                
+                                NSMutableDictionary* record = [NSMutableDictionary new];
+                                for (NSUInteger i=0; i < keys.count; i++) {
+                                    id value = [dba sqlite3_column_objc:tableContents column:(int)i];
+                                    [record setObject:value ? value : [NSNull null] forKey:[keys objectAtIndex:i]];
                                 }
-                                [context addEntityToContext:newRecord];
+                                more = [import addRecord:record];
+                                
                             }
                         }
-                        
                     }
+                    
+                    [import finish];
+                    
                 }
-                
-                [context commit];
+                sqlite3_finalize(tableContents);
                 
             }
         }
+        
     }
+    sqlite3_close(tempDb);
     
 }
 
@@ -210,6 +533,18 @@ typedef enum : int {
     [[SRKGlobals sharedObject] setDeleteCallback:callback];
 }
 
++ (SRKBusyStatistics *)busyStatistics {
+    return [[SRKGlobals sharedObject] busyStatistics];
+}
+
++ (void)resetBusyStatistics {
+    [[SRKGlobals sharedObject] resetBusyStatistics];
+}
+
++ (void)flush {
+    [[SRKGlobals sharedObject] flushGroupCommit];
+}
+
 +(sqlite3 *)defaultHandleForDatabase {
     
     return (sqlite3*)[[SRKGlobals sharedObject] defaultHandle];
@@ -256,6 +591,19 @@ typedef enum : int {
     return [SharkORM getSettings].defaultDatabaseName;
 }
 
++(NSArray<NSString*>*)databaseNamesForEntities:(NSArray<SRKEntity*>*)entities {
+    
+    NSMutableArray* names = [NSMutableArray new];
+    for (SRKEntity* entity in entities) {
+        NSString* dbName = [SharkORM databaseNameForClass:entity.class];
+        if (dbName && ![names containsObject:dbName]) {
+            [names addObject:dbName];
+        }
+    }
+    return names;
+    
+}
+
 +(void)openDatabaseNamed:(NSString *)dbName {
     
     // bail if there is no databaseName passed in
@@ -267,54 +615,65 @@ typedef enum : int {
         return;
     }
     
-    @synchronized([[SRKGlobals sharedObject] writeLockObject]) {
-        
-        sqlite3* dbHandle = nil;
-        dbHandle = [[SRKGlobals sharedObject] handleForName:dbName];
-        
-        if (dbHandle) {
-            sqlite3_close(dbHandle);
-            dbHandle = nil;
-        }
-        
-        /* open for user and join the system database */
+    /* the write locks are per database, but opening one also refactors the shared schema so databases are still opened one at a time */
+    @synchronized([SharkORM class]) {
         
-        if (!dbHandle) {
+        @synchronized([[SRKGlobals sharedObject] writeLockObjectForDatabase:dbName]) {
             
-            sqlite3_open([[[[SRKGlobals sharedObject] settings].databaseLocation stringByAppendingPathComponent: [NSString stringWithFormat:@"%@.db", dbName]] UTF8String], &dbHandle); // double pointer to allow void* casts later on!
+            sqlite3* dbHandle = nil;
+            dbHandle = [[SRKGlobals sharedObject] handleForName:dbName];
             
-#ifdef DEBUG
-            NSLog(@"%s",[[[[SRKGlobals sharedObject] settings].databaseLocation stringByAppendingPathComponent: [NSString stringWithFormat:@"%@.db", dbName]] UTF8String]);
-#endif
+            if (dbHandle) {
+                sqlite3_close(dbHandle);
+                dbHandle = nil;
+            }
             
-            sqlite3_exec(dbHandle, [NSString stringWithFormat:@"PRAGMA journal_mode=%@; PRAGMA default_cache_size = 200; PRAGMA cache_size = 200;", [[SRKGlobals sharedObject] settings].sqliteJournalingMode].UTF8String, 0, 0, 0);
+            /* open for user and join the system database */
             
-            /* now store the handle within the void** array */
-            [[SRKGlobals sharedObject] addHandle:dbHandle forDBName:dbName];
-            [SharkORM registerSqliteExtensionsInDatabase:dbName];
+            NSString* databasePath = [[[SRKGlobals sharedObject] settings].databaseLocation stringByAppendingPathComponent: [NSString stringWithFormat:@"%@.db", dbName]];
             
-            if (dbHandle) {
+            if (!dbHandle) {
                 
-                /* create the revision table */
-                sqlite3_exec(dbHandle, "CREATE TABLE IF NOT EXISTS _schemaRevision (revision INTEGER);", nil, nil, nil);
-                sqlite3_exec(dbHandle, "CREATE TABLE IF NOT EXISTS _entityRevision (entityName TEXT,revision INTEGER);", nil, nil, nil);
+                sqlite3_open([databasePath UTF8String], &dbHandle); // double pointer to allow void* casts later on!
+                sqlite3_busy_handler(dbHandle, srkBusyHandler, NULL);
                 
+#ifdef DEBUG
+                NSLog(@"%s",[databasePath UTF8String]);
+#endif
+                
+                sqlite3_exec(dbHandle, [NSString stringWithFormat:@"PRAGMA journal_mode=%@; PRAGMA default_cache_size = 200; PRAGMA cache_size = 200;", [[SRKGlobals sharedObject] settings].sqliteJournalingMode].UTF8String, 0, 0, 0);
+                
+                /* now store the handle within the void** array */
+                [[SRKGlobals sharedObject] addHandle:dbHandle forDBName:dbName];
+                [SharkORM registerSqliteExtensionsInDatabase:dbName];
+                
+                if (dbHandle) {
+                    
+                    /* create the revision table */
+                    sqlite3_exec(dbHandle, "CREATE TABLE IF NOT EXISTS _schemaRevision (revision INTEGER);", nil, nil, nil);
+                    sqlite3_exec(dbHandle, "CREATE TABLE IF NOT EXISTS _entityRevision (entityName TEXT,revision INTEGER);", nil, nil, nil);
+                    
+                }
+                else
+                {
+                    /* database failed to open, raise an error */
+                    sqlite3_errmsg(dbHandle);
+                }
             }
-            else
-            {
-                /* database failed to open, raise an error */
-                sqlite3_errmsg(dbHandle);
-            }
+            
+            /* now cache the system relationships for a performance improvement, only one relationship per table for this implementation */
+            [SharkORM registerSystemExtensions:dbHandle];
+            
+            // now the database is opened, refactor it based on the current entity schema in memory
+            [SharkSchemaManager.shared schemaUpdateMissingDatabaseEntries:[[SRKGlobals sharedObject] defaultDatabaseName]];
+            [SharkSchemaManager.shared refactorDatabase:dbName];
+            
+            // queries get their own connections, opened once the schema is in place
+            [SharkORM openReadConnectionsForDatabase:dbName path:databasePath];
+            
         }
         
-        /* now cache the system relationships for a performance improvement, only one relationship per table for this implementation */
-        [SharkORM registerSystemExtensions:dbHandle];
-        
-        // now the database is opened, refactor it based on the current entity schema in memory
-        [SharkSchemaManager.shared schemaUpdateMissingDatabaseEntries:[[SRKGlobals sharedObject] defaultDatabaseName]];
-        [SharkSchemaManager.shared refactorDatabase:dbName];
-        
-    };
+    }
     
     /* now notify the delegate that the database has opened */
     if ([[SRKGlobals sharedObject] delegate]) {
@@ -364,9 +723,48 @@ void spatialCalc(sqlite3_context *context, int argc, sqlite3_value **argv)
     }
 }
 
+void ftsRank(sqlite3_context *context, int argc, sqlite3_value **argv);
+
+/*
+ *  scores a full text match from the output of matchinfo(table, 'pcx'), each phrase hit in a column is weighted by how rare that phrase is across the whole
+ *  table, so documents which contain the less common search terms float to the top.
+ */
+void ftsRank(sqlite3_context *context, int argc, sqlite3_value **argv)
+{
+    const unsigned int* matchinfo = (const unsigned int*)sqlite3_value_blob(argv[0]);
+    int bytes = sqlite3_value_bytes(argv[0]);
+    
+    if (!matchinfo || bytes < (int)(sizeof(unsigned int) * 2)) {
+        sqlite3_result_double(context, 0);
+        return;
+    }
+    
+    unsigned int phrases = matchinfo[0];
+    unsigned int columns = matchinfo[1];
+    if (bytes < (int)(sizeof(unsigned int) * (2 + (phrases * columns * 3)))) {
+        sqlite3_result_double(context, 0);
+        return;
+    }
+    
+    double score = 0;
+    for (unsigned int p = 0; p < phrases; p++) {
+        const unsigned int* phraseinfo = &matchinfo[2 + (p * columns * 3)];
+        for (unsigned int c = 0; c < columns; c++) {
+            unsigned int hits = phraseinfo[(c * 3)];
+            unsigned int globalHits = phraseinfo[(c * 3) + 1];
+            if (hits > 0 && globalHits > 0) {
+                score += (double)hits / (double)globalHits;
+            }
+        }
+    }
+    
+    sqlite3_result_double(context, score);
+}
+
 + (void)registerSystemExtensions:(sqlite3*)thisDb {
     
     sqlite3_create_function(thisDb, "distancebetween", 4, SQLITE_ANY, NULL, &spatialCalc, 0, 0);
+    sqlite3_create_function(thisDb, "ftsrank", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, NULL, &ftsRank, 0, 0);
     
 }
 
@@ -451,6 +849,10 @@ void spatialCalc(sqlite3_context *context, int argc, sqlite3_value **argv)
 }
 
 +(void)executeSQL:(NSString*)sql inDatabase:(NSString *)dbName {
+    [self executeSQL:sql inDatabase:dbName errorMessage:nil];
+}
+
++(BOOL)executeSQL:(NSString*)sql inDatabase:(NSString *)dbName errorMessage:(NSString**)errorMessage {
     sqlite3* handle = nil;
     if (!dbName) {
         /* get the default database */
@@ -461,46 +863,106 @@ void spatialCalc(sqlite3_context *context, int argc, sqlite3_value **argv)
     char* error = 0;
     sqlite3_exec(handle, [sql UTF8String], nil, nil, &error);
     if (error) {
+        if (errorMessage) {
+            *errorMessage = [NSString stringWithUTF8String:error];
+        }
         free(error);
+        return NO;
     }
+    return YES;
 }
 
-void dateFromString(sqlite3_context *context, int argc, sqlite3_value **argv)
-{
-    switch( sqlite3_value_type(argv[0]) )
-    {
-        case SQLITE_TEXT:
-        {
-            const char* date = (const char*)sqlite3_value_text(argv[0]);
-            NSString* strVal = [NSString stringWithUTF8String:date];
-            NSNumber* numVal = [NSNumber numberWithInt:0];
-            
-            /* check to see if this field is a valid full date */
-            NSDateFormatter *dateFormat = [[NSDateFormatter alloc] init];
-            [dateFormat setDateFormat:@"yyyy-MM-dd HH:mm:ss"];
-            NSDate* dValue = [dateFormat dateFromString:(NSString*)strVal];
-            if (dValue) {
-                if ([dValue isKindOfClass:[NSDate class]]) {
-                    numVal = [NSNumber numberWithDouble:[dValue timeIntervalSince1970]];
-                } else {
-                    numVal = [NSNumber numberWithInt:0];
-                }
-                
-            }
+/*
+ *  dateFromString / stringFromDate are called once per row, so they parse and format the fixed "yyyy-MM-dd HH:mm:ss" layout
+ *  directly on the stack rather than spinning up an NSDateFormatter (and the autoreleased strings that go with it) each time.
+ *  Values are interpreted in the local timezone, which is what the formatter used to default to.  That makes the result depend on the device's
+ *  timezone rather than just the argument, so the functions must not be registered as deterministic (SQLite may reuse their results in indexes).
+ */
+
+static int srkParseDigits(const char* s, int count) {
+    int v = 0;
+    for (int i = 0; i < count; i++) {
+        if (s[i] < '0' || s[i] > '9') {
+            return -1;
+        }
+        v = (v * 10) + (s[i] - '0');
+    }
+    return v;
+}
+
+static BOOL srkParseDateTime(const char* s, int length, double* result) {
+    
+    /* yyyy-MM-dd HH:mm:ss */
+    if (!s || length < 19) {
+        return NO;
+    }
+    if (s[4] != '-' || s[7] != '-' || s[10] != ' ' || s[13] != ':' || s[16] != ':') {
+        return NO;
+    }
+    
+    int year = srkParseDigits(s, 4);
+    int month = srkParseDigits(s + 5, 2);
+    int day = srkParseDigits(s + 8, 2);
+    int hour = srkParseDigits(s + 11, 2);
+    int minute = srkParseDigits(s + 14, 2);
+    int second = srkParseDigits(s + 17, 2);
+    
+    if (year < 0 || month < 1 || month > 12 || day < 1 || day > 31 || hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 59) {
+        return NO;
+    }
+    
+    struct tm t;
+    memset(&t, 0, sizeof(t));
+    t.tm_year = year - 1900;
+    t.tm_mon = month - 1;
+    t.tm_mday = day;
+    t.tm_hour = hour;
+    t.tm_min = minute;
+    t.tm_sec = second;
+    t.tm_isdst = -1;
+    
+    time_t epoch = mktime(&t);
+    if (epoch == (time_t)-1) {
+        return NO;
+    }
+    
+    /* mktime normalises out of range values (e.g. 31st Feb), the formatter would have rejected those */
+    if (t.tm_mday != day || t.tm_mon != month - 1) {
+        return NO;
+    }
+    
+    *result = (double)epoch;
+    return YES;
+    
+}
+
+static int srkFormatDateTime(double value, char* buffer, size_t size) {
+    
+    time_t epoch = (time_t)floor(value);
+    struct tm t;
+    if (!localtime_r(&epoch, &t)) {
+        return 0;
+    }
+    return (int)strftime(buffer, size, "%Y-%m-%d %H:%M:%S", &t);
+    
+}
+
+void dateFromString(sqlite3_context *context, int argc, sqlite3_value **argv)
+{
+    switch( sqlite3_value_type(argv[0]) )
+    {
+        case SQLITE_TEXT:
+        {
+            const char* date = (const char*)sqlite3_value_text(argv[0]);
+            int length = sqlite3_value_bytes(argv[0]);
+            double retVal = 0;
             
-            double retVal = [numVal doubleValue];
-            if (retVal == 0) {
-                
-                sqlite3_result_null(context);
-                break;
-                
-            } else {
-                
+            if (srkParseDateTime(date, length, &retVal) && retVal != 0) {
                 sqlite3_result_double(context, retVal);
-                break;
-                
+            } else {
+                sqlite3_result_null(context);
             }
-            
+            break;
         }
         default:
         {
@@ -517,33 +979,15 @@ void stringFromDate(sqlite3_context *context, int argc, sqlite3_value **argv)
     switch( sqlite3_value_numeric_type(argv[0]) )
     {
         case SQLITE_FLOAT:
-        {
-            double date = sqlite3_value_double(argv[0]);
-            
-            NSDate * dte = [NSDate dateWithTimeIntervalSince1970:(double)date];
-            
-            /* check to see if this field is a valid full date */
-            NSDateFormatter *dateFormat = [[NSDateFormatter alloc] init];
-            [dateFormat setDateFormat:@"yyyy-MM-dd HH:mm:ss"];
-            NSString* dValue = [dateFormat stringFromDate:dte];
-            
-            sqlite3_result_text(context, [dValue UTF8String], -1, NULL);
-            
-            break;
-        }
         case SQLITE_INTEGER:
         {
-            unsigned int date = sqlite3_value_int(argv[0]);
-            
-            NSDate * dte = [NSDate dateWithTimeIntervalSince1970:(double)date];
-            
-            /* check to see if this field is a valid full date */
-            NSDateFormatter *dateFormat = [[NSDateFormatter alloc] init];
-            [dateFormat setDateFormat:@"yyyy-MM-dd HH:mm:ss"];
-            NSString* dValue = [dateFormat stringFromDate:dte];
-            
-            sqlite3_result_text(context, [dValue UTF8String], -1, NULL);
-            
+            char buffer[32];
+            int length = srkFormatDateTime(sqlite3_value_double(argv[0]), buffer, sizeof(buffer));
+            if (length) {
+                sqlite3_result_text(context, buffer, length, SQLITE_TRANSIENT);
+            } else {
+                sqlite3_result_null(context);
+            }
             break;
         }
         default:
@@ -555,8 +999,142 @@ void stringFromDate(sqlite3_context *context, int argc, sqlite3_value **argv)
 }
 
 +(void)registerSqliteExtensionsInDatabase:(NSString*)dbName {
-    sqlite3_create_function([SharkORM handleForDatabase:dbName], "dateFromString", 1, SQLITE_ANY, NULL, &dateFromString, 0, 0);
-    sqlite3_create_function([SharkORM handleForDatabase:dbName], "stringFromDate", 1, SQLITE_ANY, NULL, &stringFromDate, 0, 0);
+    [SharkORM registerSqliteExtensionsOnHandle:[SharkORM handleForDatabase:dbName]];
+}
+
++(void)registerSqliteExtensionsOnHandle:(sqlite3*)handle {
+    sqlite3_create_function(handle, "dateFromString", 1, SQLITE_UTF8, NULL, &dateFromString, 0, 0);
+    sqlite3_create_function(handle, "stringFromDate", 1, SQLITE_UTF8, NULL, &stringFromDate, 0, 0);
+}
+
+/*
+ *  read only connections, these are only opened when the database is in WAL mode, as otherwise a reader would block the writer.  Each one is only ever used by the thread
+ *  which has it checked out, so they are opened without SQLite's own mutex.
+ */
++(void)openReadConnectionsForDatabase:(NSString*)dbName path:(NSString*)path {
+    
+    sqlite3* dbHandle = [[SRKGlobals sharedObject] handleForName:dbName];
+    sqlite3_stmt* statement = nil;
+    BOOL wal = NO;
+    
+    if (sqlite3_prepare_v2(dbHandle, "PRAGMA journal_mode;", -1, &statement, nil) == SQLITE_OK && sqlite3_step(statement) == SQLITE_ROW) {
+        const char* mode = (const char*)sqlite3_column_text(statement, 0);
+        wal = (mode && sqlite3_stricmp(mode, "wal") == 0);
+    }
+    sqlite3_finalize(statement);
+    
+    if (!wal) {
+        return;
+    }
+    
+    for (NSUInteger i = 0; i < [[SRKGlobals sharedObject] settings].readConnections; i++) {
+        
+        sqlite3* readHandle = [SharkORM openReadConnectionWithPath:path];
+        if (!readHandle) {
+            break;
+        }
+        [[SRKGlobals sharedObject] addReadHandle:readHandle forDBName:dbName];
+        
+    }
+    
+}
+
++(sqlite3*)openReadConnectionWithPath:(NSString*)path {
+    
+    sqlite3* readHandle = nil;
+    if (sqlite3_open_v2([path UTF8String], &readHandle, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK) {
+        sqlite3_close(readHandle);
+        return NULL;
+    }
+    
+    sqlite3_busy_handler(readHandle, srkBusyHandler, NULL);
+    sqlite3_exec(readHandle, "PRAGMA cache_size = 200;", 0, 0, 0);
+    [SharkORM registerSqliteExtensionsOnHandle:readHandle];
+    [SharkORM registerSystemExtensions:readHandle];
+    
+    return readHandle;
+    
+}
+
++(void)readSnapshot:(SRKReadSnapshotBlock)block {
+    
+    if (!block) {
+        return;
+    }
+    
+    NSMutableDictionary* threadDictionary = [[NSThread currentThread] threadDictionary];
+    
+    // a nested snapshot is already looking at a consistent database, and a transaction has to see its own changes
+    if ([threadDictionary objectForKey:SRKReadSnapshotKey] || [SRKTransaction transactionIsInProgress]) {
+        block();
+        return;
+    }
+    
+    // anything waiting in the group commit queue was committed before the snapshot, so it needs to be visible within it
+    [[SRKGlobals sharedObject] flushGroupCommit];
+    
+    SRKReadSnapshot* snapshot = [SRKReadSnapshot new];
+    [threadDictionary setObject:snapshot forKey:SRKReadSnapshotKey];
+    
+    // the readers are released even if the block throws, one left open would stop the WAL from ever being checkpointed
+    @try {
+        
+        block();
+        
+    } @finally {
+        
+        [threadDictionary removeObjectForKey:SRKReadSnapshotKey];
+        
+        for (NSString* dbName in snapshot.handles.allKeys) {
+            sqlite3* readHandle = [[snapshot.handles objectForKey:dbName] pointerValue];
+            sqlite3_exec(readHandle, "COMMIT;", 0, 0, 0);
+            if ([snapshot.openedDatabases containsObject:dbName]) {
+                sqlite3_close_v2(readHandle);
+            } else {
+                [[SRKGlobals sharedObject] checkinReadHandle:readHandle forName:dbName];
+            }
+        }
+        
+    }
+    
+}
+
++(sqlite3*)snapshotHandleForDatabase:(NSString*)dbName {
+    
+    SRKReadSnapshot* snapshot = [[[NSThread currentThread] threadDictionary] objectForKey:SRKReadSnapshotKey];
+    if (!snapshot || [SRKTransaction transactionIsInProgress]) {
+        return NULL;
+    }
+    
+    NSValue* pinned = [snapshot.handles objectForKey:dbName];
+    if (pinned) {
+        return [pinned pointerValue];
+    }
+    
+    // without read connections the database is not in WAL mode, and a reader held open would block the writer
+    if (![[SRKGlobals sharedObject] hasReadHandlesForName:dbName]) {
+        return NULL;
+    }
+    
+    // the connection is held for the whole block, so if the pool is in use a connection of our own is opened rather than waiting for one
+    sqlite3* readHandle = [[SRKGlobals sharedObject] checkoutReadHandleForName:dbName];
+    if (!readHandle) {
+        const char* path = sqlite3_db_filename([SharkORM handleForDatabase:dbName], "main");
+        readHandle = path ? [SharkORM openReadConnectionWithPath:[NSString stringWithUTF8String:path]] : NULL;
+        if (!readHandle) {
+            return NULL;
+        }
+        [snapshot.openedDatabases addObject:dbName];
+    }
+    
+    // the snapshot is taken by the first read within the transaction, rather than BEGIN, so read straight away
+    sqlite3_exec(readHandle, "BEGIN;", 0, 0, 0);
+    sqlite3_exec(readHandle, "SELECT 1 FROM sqlite_master LIMIT 1;", 0, 0, 0);
+    
+    [snapshot.handles setObject:[NSValue valueWithPointer:readHandle] forKey:dbName];
+    
+    return readHandle;
+    
 }
 
 /*
@@ -566,7 +1144,10 @@ void stringFromDate(sqlite3_context *context, int argc, sqlite3_value **argv)
 
 
 +(void)closeDatabaseNamed:(NSString*)dbName {
+    [[SRKGlobals sharedObject] flushGroupCommit];
     if ([SharkORM handleForDatabase:dbName]) {
+        [[SRKGlobals sharedObject] clearStatementCacheForDatabase:dbName];
+        [[SRKGlobals sharedObject] closeReadHandlesForName:dbName];
         sqlite3_close([SharkORM handleForDatabase:dbName]);
         [[SRKGlobals sharedObject] removeHandleForName:dbName];
     }
@@ -574,13 +1155,16 @@ void stringFromDate(sqlite3_context *context, int argc, sqlite3_value **argv)
 
 + (SRKRawResults *)rawQuery:(NSString *)sql {
     
+    /* raw sql may read or write any table, so it has to see everything that has been committed so far */
+    [[SRKGlobals sharedObject] flushGroupCommit];
+    
     SRKRawResults* returnValue = [SRKRawResults new];
     returnValue.rawResults = [NSMutableArray new];
     
     sqlite3_stmt* statement;
     sqlite3* dbHandle = [SharkORM defaultHandleForDatabase];
     
-    [SRKTransaction blockUntilTransactionFinished];
+    [SRKTransaction blockUntilTransactionFinishedForDatabase:[[SRKGlobals sharedObject] defaultDatabaseName]];
     
     int prepareResult = sqlite3_prepare_v2(dbHandle, [sql UTF8String], (int)sql.length, &statement, NULL);
     if (prepareResult == SQLITE_OK) {
@@ -664,143 +1248,230 @@ void stringFromDate(sqlite3_context *context, int argc, sqlite3_value **argv)
 
 #pragma mark - object entity support
 
+- (NSString*)insertStatementForEntity:(NSString*)entityName columns:(NSArray<NSString*>*)columns conflictPolicy:(SRKConflictPolicy)policy {
+    
+    NSMutableArray* placeholders = [NSMutableArray arrayWithCapacity:columns.count];
+    for (NSUInteger i = 0; i < columns.count; i++) {
+        [placeholders addObject:@"?"];
+    }
+    return [NSString stringWithFormat:@"INSERT%@ INTO %@ (%@) VALUES (%@);", policy == SRKConflictPolicyReplace ? @" OR REPLACE" : @"", entityName, [columns componentsJoinedByString:@", "], [placeholders componentsJoinedByString:@", "]];
+    
+}
+
+- (NSString*)updateStatementForEntity:(NSString*)entityName columns:(NSArray<NSString*>*)columns conflictPolicy:(SRKConflictPolicy)policy {
+    
+    return [NSString stringWithFormat:@"UPDATE%@ %@ SET %@ = ? WHERE %@ = ?;", policy == SRKConflictPolicyReplace ? @" OR REPLACE" : @"", entityName, [columns componentsJoinedByString:@" = ?, "], SRK_DEFAULT_PRIMARY_KEY_NAME];
+    
+}
+
+- (NSMutableArray*)valuesForEntity:(SRKEntity*)entity columns:(NSArray<NSString*>*)columns {
+    
+    NSMutableArray* values = [NSMutableArray arrayWithCapacity:columns.count + 1];
+    for (NSString* key in columns) {
+        id value = [entity getField:key];
+        [values addObject:value ? value : [NSNull null]];
+    }
+    return values;
+    
+}
+
+/*
+ *  binds & steps one of the cached statements, it is left reset with its bindings cleared ready for the next caller.  Must be called whilst holding the write lock.
+ *  Returns SQLITE_DONE on success, otherwise the extended result code with the message in errorMessage.
+ */
+- (int)executeCachedStatement:(NSString*)sql values:(NSArray*)values inDatabase:(NSString*)databaseName errorMessage:(NSString**)errorMessage {
+    
+    sqlite3* databaseHandle = [SharkORM handleForDatabase:databaseName];
+    sqlite3_stmt* statement = [[SRKGlobals sharedObject] cachedStatementForSQL:sql inDatabase:databaseName];
+    
+    if (!statement) {
+        if (errorMessage) {
+            *errorMessage = [NSString stringWithUTF8String:sqlite3_errmsg(databaseHandle)];
+        }
+        return sqlite3_extended_errcode(databaseHandle);
+    }
+    
+    [[SRKUtilities new] bindParameters:values toStatement:statement];
+    
+    /* SQLITE_BUSY is dealt with by the busy handler, by the time it gets here the timeout has been reached.  Table locks (SQLITE_LOCKED) don't go through the handler, so back off in the same way */
+    int result = sqlite3_step(statement);
+    int lockedRetries = 0;
+    while (result == SQLITE_LOCKED && srkBusyHandler(NULL, lockedRetries++)) {
+        sqlite3_reset(statement);
+        result = sqlite3_step(statement);
+    }
+    
+    if (result == SQLITE_DONE || result == SQLITE_ROW) {
+        result = SQLITE_DONE;
+    } else {
+        result = sqlite3_extended_errcode(databaseHandle);
+        if (errorMessage) {
+            *errorMessage = [NSString stringWithUTF8String:sqlite3_errmsg(databaseHandle)];
+        }
+    }
+    
+    sqlite3_reset(statement);
+    sqlite3_clear_bindings(statement);
+    
+    return result;
+    
+}
+
+/*
+ *  checks for a row with the entity's primary key, using a cached statement.  Must be called whilst holding the write lock.
+ */
+- (BOOL)rowExistsForEntity:(SRKEntity*)entity inDatabase:(NSString*)databaseName {
+    
+    sqlite3_stmt* statement = [[SRKGlobals sharedObject] cachedStatementForSQL:[NSString stringWithFormat:@"SELECT 1 FROM %@ WHERE Id = ?;", [entity.class description]] inDatabase:databaseName];
+    if (!statement || !entity.reflectedPrimaryKeyValue) {
+        return NO;
+    }
+    
+    [[SRKUtilities new] bindParameters:@[entity.reflectedPrimaryKeyValue] toStatement:statement];
+    BOOL exists = (sqlite3_step(statement) == SQLITE_ROW);
+    sqlite3_reset(statement);
+    sqlite3_clear_bindings(statement);
+    
+    return exists;
+    
+}
+
+/*
+ *  writes a single entity using the cached INSERT / UPDATE statements, it does not deal with transactions, events or the state of the entity.  Must be called whilst holding the write lock.
+ */
+- (int)writeEntity:(SRKEntity*)entity inDatabase:(NSString*)databaseNameForClass sql:(NSString**)sql errorMessage:(NSString**)errorMessage {
+    
+    NSString* className = [entity.class description];
+    NSInteger priKeyType = [SharkORM primaryKeyType:className];
+    sqlite3* databaseHandle = [SharkORM handleForDatabase:databaseNameForClass];
+    SRKConflictPolicy policy = entity.commitOptions.conflictPolicy;
+    int result = SQLITE_DONE;
+    
+    /* a REPLACE only fires the delete triggers of the rows it removes when recursive triggers are on, the virtual table indexes rely on those so they are switched on for just this write */
+    BOOL recursiveTriggers = (policy == SRKConflictPolicyReplace && [SharkSchemaManager.shared schemaEntityHasVirtualIndexes:className]);
+    if (recursiveTriggers) {
+        sqlite3_exec(databaseHandle, "PRAGMA recursive_triggers = ON;", 0, 0, 0);
+    }
+    
+    if (entity.exists) {
+        
+        /* only write the columns which have actually changed, rather than re-writing the whole row and every index entry */
+        NSSet* dirtyFields = [NSSet setWithArray:[entity modifiedFieldNames]];
+        NSMutableArray* keys = [NSMutableArray new];
+        for (NSString* key in [entity fieldNames]) {
+            if ([dirtyFields containsObject:key] && ![key isEqualToString:SRK_DEFAULT_PRIMARY_KEY_NAME]) {
+                [keys addObject:key];
+            }
+        }
+        
+        if (keys.count) {
+            
+            *sql = [self updateStatementForEntity:className columns:keys conflictPolicy:policy];
+            NSMutableArray* values = [self valuesForEntity:entity columns:keys];
+            [values addObject:entity.reflectedPrimaryKeyValue ? entity.reflectedPrimaryKeyValue : [NSNull null]];
+            result = [self executeCachedStatement:*sql values:values inDatabase:databaseNameForClass errorMessage:errorMessage];
+            
+            if (result == SQLITE_DONE && sqlite3_changes(databaseHandle) == 0) {
+                
+                /* the row has gone from underneath us, so put it back as the previous INSERT OR REPLACE would have done */
+                *sql = [self insertStatementForEntity:className columns:[entity fieldNames] conflictPolicy:policy];
+                result = [self executeCachedStatement:*sql values:[self valuesForEntity:entity columns:[entity fieldNames]] inDatabase:databaseNameForClass errorMessage:errorMessage];
+                
+            }
+            
+        }
+        
+    } else {
+        
+        *sql = [self insertStatementForEntity:className columns:[entity fieldNames] conflictPolicy:policy];
+        result = [self executeCachedStatement:*sql values:[self valuesForEntity:entity columns:[entity fieldNames]] inDatabase:databaseNameForClass errorMessage:errorMessage];
+        
+        /* a table clustered on a natural key raises the same error when that key is duplicated, but the Id is new so there is no row to update in place */
+        NSArray* clusteredKey = [SharkSchemaManager.shared schemaClusteredKeyForEntity:className];
+        BOOL conflictOnId = (!clusteredKey || [clusteredKey isEqualToArray:@[SRK_DEFAULT_PRIMARY_KEY_NAME]]);
+        
+        if (result == SQLITE_CONSTRAINT_PRIMARYKEY && conflictOnId && [entity fieldNames].count > 1) {
+            
+            /* new object which has been given the Id of an existing row, update it in place rather than delete & re-insert */
+            NSMutableArray* keys = [[entity fieldNames] mutableCopy];
+            [keys removeObject:SRK_DEFAULT_PRIMARY_KEY_NAME];
+            *sql = [self updateStatementForEntity:className columns:keys conflictPolicy:policy];
+            NSMutableArray* values = [self valuesForEntity:entity columns:keys];
+            [values addObject:entity.reflectedPrimaryKeyValue];
+            result = [self executeCachedStatement:*sql values:values inDatabase:databaseNameForClass errorMessage:errorMessage];
+            
+            if (result == SQLITE_DONE && sqlite3_changes(databaseHandle) == 0) {
+                // nothing was written, so the commit has to fail rather than report the object as stored
+                result = SQLITE_CONSTRAINT_PRIMARYKEY;
+                if (errorMessage) {
+                    *errorMessage = [NSString stringWithFormat:@"PRIMARY KEY constraint failed: no %@ row with Id %@ to update", className, entity.reflectedPrimaryKeyValue];
+                }
+            }
+            
+        } else if (result == SQLITE_DONE && priKeyType == SRK_PROPERTY_TYPE_NUMBER) {
+            
+            [entity setField:SRK_DEFAULT_PRIMARY_KEY_NAME value:@(sqlite3_last_insert_rowid(databaseHandle))];
+            
+        }
+        
+    }
+    
+    if (recursiveTriggers) {
+        sqlite3_exec(databaseHandle, "PRAGMA recursive_triggers = OFF;", 0, 0, 0);
+    }
+    
+    return result;
+    
+}
+
 -(BOOL)commitObject:(SRKEntity *)entity {
     
     BOOL        succeded = NO;
     
     @autoreleasepool {
         
-        NSInteger   priKeyType = [SharkORM primaryKeyType:[entity.class description]];
-        
-        NSString*   className = [entity.class description];
         NSString*   databaseNameForClass = [SharkORM databaseNameForClass:entity.class];
-        sqlite3*    databaseHandle = [SharkORM handleForDatabase:databaseNameForClass];
         
         // the following will block if there is a transaction occouring for anything other than a current transaction block
-        [SRKTransaction blockUntilTransactionFinished];
+        [SRKTransaction blockUntilTransactionFinishedForDatabase:databaseNameForClass];
         
         if ([SRKTransaction transactionIsInProgress]) {
             
-            // check to see if there was an error within the transaction so far and return if there was.
-            if ([SRKTransaction currentTransactionStatus] != SRKTransactionPassed) {
+            // check to see if there was an error within the transaction so far, or the database is held by another transaction, and return if there was.
+            if ([SRKTransaction currentTransactionStatus] != SRKTransactionPassed || ![SRKTransaction startTransactionForDatabaseConnection:databaseNameForClass]) {
                 return NO;
             }
             
             // this means we are currently within a transaction, so we need to create an information object to describe what is happening before the commit
-            if (!entity.transactionInfo) {
-                SRKTransactionInfo* info = [SRKTransactionInfo new];
-                info.eventType = entity.exists ? EventUpdate : EventInsert;
-                [info copyObjectValuesIntoRestorePoint:entity];
-                entity.transactionInfo = info;
-            } else {
-                entity.transactionInfo.eventType = entity.exists ? EventUpdate : EventInsert;
+            if ([SRKTransaction entityRequiresRestorePoint:entity]) {
+                [SRKTransaction createRestorePointForEntity:entity];
             }
+            entity.transactionInfo.eventType = entity.exists ? EventUpdate : EventInsert;
             
-            [SRKTransaction startTransactionForDatabaseConnection:databaseNameForClass];
             [SRKTransaction addReferencedObjectToTransactionList:entity];
             
         }
         
-        @synchronized([[SRKGlobals sharedObject] writeLockObject]) {
+        @synchronized([[SRKGlobals sharedObject] writeLockObjectForDatabase:databaseNameForClass]) {
             
-            sqlite3_stmt* statement;
+            NSString* errorMessage = nil;
+            NSString* sql = nil;
+            int result = [self writeEntity:entity inDatabase:databaseNameForClass sql:&sql errorMessage:&errorMessage];
             
-            NSString* fieldNames = @"";
-            NSString* placeholders = @"";
-            NSMutableArray* keys = [[NSMutableArray alloc] init];
-            for (NSString* key in [entity fieldNames]) {
-                
-                [keys addObject:key];
+            if (result == SQLITE_DONE) {
                 
-                if ([fieldNames length]) {
-                    fieldNames = [fieldNames stringByAppendingString:@", "];
-                    placeholders = [placeholders stringByAppendingString:@", "];
+                if (!entity.exists) {
+                    /* now we need to register this object with the default registry, first check to see if the user wants a default domain */
+                    entity.exists = YES;
+                    if ([SharkORM getSettings].defaultManagedObjects) {
+                        [entity setManagedObjectDomain:[SharkORM getSettings].defaultObjectDomain];
+                    }
                 }
+                succeded = YES;
                 
-                fieldNames = [fieldNames stringByAppendingString:key];
-                placeholders = [placeholders stringByAppendingString:@"?"];
-                
-            }
-            
-            NSString* sql = [NSString stringWithFormat:@"INSERT OR REPLACE INTO %@ (%@) VALUES (%@);", className , fieldNames, placeholders];
-            
-            if (sqlite3_prepare_v2([SharkORM handleForDatabase:databaseNameForClass], [sql UTF8String], (int)sql.length, &statement, NULL) == SQLITE_OK) {
-                
-                /* now bind the data into the table */
-                
-                NSMutableArray* values = [NSMutableArray new];
-                for (NSString* key in keys) {
-                    id value = [entity getField:key];
-                    [values addObject:value ? value : [NSNull null]];
-                }
+            } else if (result == SQLITE_CONSTRAINT_UNIQUE && entity.commitOptions.conflictPolicy == SRKConflictPolicyIgnore) {
                 
-                [[SRKUtilities new] bindParameters:values toStatement:statement];
-                
-                bool keepTrying = YES;
-                while (keepTrying) {
-                    int result = sqlite3_step(statement);
-                    switch (result) {
-                        case SQLITE_DONE:
-                        {
-                            keepTrying = NO;
-                            if (priKeyType == SRK_PROPERTY_TYPE_NUMBER) {
-                                if (!entity.exists) {
-                                    [entity setField:SRK_DEFAULT_PRIMARY_KEY_NAME value:@(sqlite3_last_insert_rowid(databaseHandle))];
-                                }
-                            }
-                            if (!entity.exists) {
-                                /* now we need to register this object with the default registry, first check to see if the user wants a default domain */
-                                entity.exists = YES;
-                                if ([SharkORM getSettings].defaultManagedObjects) {
-                                    [entity setManagedObjectDomain:[SharkORM getSettings].defaultObjectDomain];
-                                }
-                            }
-                            succeded = YES;
-                            
-                        }
-                            break;
-                        case SQLITE_LOCKED:
-                        {
-                            NSString* err = [NSString stringWithUTF8String:sqlite3_errmsg(databaseHandle)];
-                            NSLog(@"%@", err);
-                            sleep(0.1);
-                            sqlite3_reset(statement);
-                        }
-                            break;
-                        case SQLITE_BUSY:
-                        {
-                            NSString* err = [NSString stringWithUTF8String:sqlite3_errmsg(databaseHandle)];
-                            NSLog(@"%@", err);
-                            sleep(0.1);
-                            sqlite3_reset(statement);
-                        }
-                            break;
-                        default:
-                        {
-                            
-                            // check we are not ignoring errors in the commit options.
-                            if (entity.commitOptions.raiseErrors) {
-                                
-                                if (entity.transactionInfo) {
-                                    // we are in a transaction, and it's gone south so mark the transaction as failed
-                                    [SRKTransaction failTransactionWithCode:SRKTransactionFailed];
-                                }
-                                
-                                /* error in prepare statement */
-                                if ([[SRKGlobals sharedObject] delegate] && [[[SRKGlobals sharedObject] delegate] respondsToSelector:@selector(databaseError:)]) {
-                                    
-                                    SRKError* e = [SRKError new];
-                                    e.sqlQuery = sql;
-                                    e.errorMessage = [NSString stringWithUTF8String:sqlite3_errmsg(databaseHandle)];
-                                    [[[SRKGlobals sharedObject] delegate] databaseError:e];
-                                    
-                                }
-                            }
-                            
-                        }
-                            break;
-                    }
-                }
+                /* the row would have duplicated a unique key, and the developer has asked for that to be quietly skipped */
                 
             } else {
                 
@@ -812,22 +1483,20 @@ void stringFromDate(sqlite3_context *context, int argc, sqlite3_value **argv)
                         [SRKTransaction failTransactionWithCode:SRKTransactionFailed];
                     }
                     
-                    // an error occoured
-                    /* error in prepare statement */
+                    /* error in prepare or step */
                     if ([[SRKGlobals sharedObject] delegate] && [[[SRKGlobals sharedObject] delegate] respondsToSelector:@selector(databaseError:)]) {
                         
                         SRKError* e = [SRKError new];
                         e.sqlQuery = sql;
-                        e.errorMessage = [NSString stringWithUTF8String:sqlite3_errmsg(databaseHandle)];
+                        e.errorMessage = errorMessage;
                         [[[SRKGlobals sharedObject] delegate] databaseError:e];
                         
                     }
                     
                 }
+                
             }
             
-            sqlite3_finalize(statement);
-            
         }
         
         [entity setBase];
@@ -843,6 +1512,432 @@ void stringFromDate(sqlite3_context *context, int argc, sqlite3_value **argv)
     
 }
 
+-(NSArray*)commitObjects:(NSArray<SRKEntity*>*)entities {
+    
+    __block BOOL    succeded = YES;
+    NSMutableArray* written = [NSMutableArray new];
+    NSMutableArray* previousIds = [NSMutableArray new];
+    
+    @autoreleasepool {
+        
+        // the following will block if there is a transaction occouring for anything other than a current transaction block
+        [SRKTransaction blockUntilTransactionFinishedForEntities:entities];
+        
+        BOOL inTransaction = [SRKTransaction transactionIsInProgress];
+        if (inTransaction) {
+            
+            if ([SRKTransaction currentTransactionStatus] != SRKTransactionPassed) {
+                return nil;
+            }
+            
+            /* the databases are locked for the transaction up front, waiting on another transaction whilst holding the write lock would stall every writer */
+            for (SRKEntity* entity in entities) {
+                if (![SRKTransaction startTransactionForDatabaseConnection:[SharkORM databaseNameForClass:entity.class]]) {
+                    return nil;
+                }
+            }
+            
+            /* the objects are registered with the transaction in the same way as a commit, so a rollback puts them back in step with the database */
+            for (SRKEntity* entity in entities) {
+                if ([SRKTransaction entityRequiresRestorePoint:entity]) {
+                    [SRKTransaction createRestorePointForEntity:entity];
+                }
+                entity.transactionInfo.eventType = entity.exists ? EventUpdate : EventInsert;
+                [SRKTransaction addReferencedObjectToTransactionList:entity];
+            }
+            
+        }
+        
+        /* group the entities by class and by the set of columns being written, so each cached statement is re-bound for a run of rows rather than flip-flopping between statements */
+        NSMutableDictionary* groups = [NSMutableDictionary new];
+        NSMutableArray* groupOrder = [NSMutableArray new];
+        for (SRKEntity* entity in entities) {
+            NSString* columns = entity.exists ? [[[entity modifiedFieldNames] sortedArrayUsingSelector:@selector(compare:)] componentsJoinedByString:@","] : @"*";
+            NSString* key = [NSString stringWithFormat:@"%@|%@", [entity.class description], columns];
+            if (![groups objectForKey:key]) {
+                [groups setObject:[NSMutableArray new] forKey:key];
+                [groupOrder addObject:key];
+            }
+            [[groups objectForKey:key] addObject:entity];
+        }
+        
+        [[SRKGlobals sharedObject] performWithWriteLockForDatabases:[SharkORM databaseNamesForEntities:entities] block:^{
+            
+            NSMutableArray* databases = [NSMutableArray new];
+            NSString* errorMessage = nil;
+            NSString* sql = nil;
+            SRKEntity* failedEntity = nil;
+            
+            for (NSString* key in groupOrder) {
+                
+                for (SRKEntity* entity in [groups objectForKey:key]) {
+                    
+                    NSString* databaseNameForClass = [SharkORM databaseNameForClass:entity.class];
+                    if (![databases containsObject:databaseNameForClass]) {
+                        /* within a transaction the batch is a savepoint, so a failure part way through does not leave half of it behind */
+                        sql = inTransaction ? @"SAVEPOINT srk_batch" : @"BEGIN IMMEDIATE TRANSACTION";
+                        if (![SharkORM executeSQL:sql inDatabase:databaseNameForClass errorMessage:&errorMessage]) {
+                            // a transaction on another thread has opened the shared handle since we checked, the batch cannot be kept apart from it
+                            failedEntity = entity;
+                            succeded = NO;
+                            break;
+                        }
+                        [databases addObject:databaseNameForClass];
+                    }
+                    
+                    [previousIds addObject:entity.exists || !entity.Id ? [NSNull null] : entity.Id];
+                    [written addObject:entity];
+                    
+                    int result = [self writeEntity:entity inDatabase:databaseNameForClass sql:&sql errorMessage:&errorMessage];
+                    if (result == SQLITE_CONSTRAINT_UNIQUE && entity.commitOptions.conflictPolicy == SRKConflictPolicyIgnore) {
+                        /* skipped as a duplicate, so it plays no further part in the batch */
+                        [previousIds removeLastObject];
+                        [written removeLastObject];
+                    } else if (result != SQLITE_DONE) {
+                        failedEntity = entity;
+                        succeded = NO;
+                        break;
+                    }
+                    
+                }
+                
+                if (!succeded) {
+                    break;
+                }
+                
+            }
+            
+            for (NSString* database in databases) {
+                if (!inTransaction) {
+                    [SharkORM executeSQL:succeded ? @"COMMIT" : @"ROLLBACK" inDatabase:database];
+                } else {
+                    if (!succeded) {
+                        [SharkORM executeSQL:@"ROLLBACK TO srk_batch" inDatabase:database];
+                    }
+                    [SharkORM executeSQL:@"RELEASE srk_batch" inDatabase:database];
+                }
+            }
+            
+            if (!succeded) {
+                
+                if (inTransaction && failedEntity.commitOptions.raiseErrors) {
+                    // we are in a transaction, and it's gone south so mark the transaction as failed
+                    [SRKTransaction failTransactionWithCode:SRKTransactionFailed];
+                }
+                
+                /* the whole batch has been rolled back, so new objects must not keep an Id which was handed out within it */
+                for (NSUInteger i = 0; i < written.count; i++) {
+                    SRKEntity* entity = [written objectAtIndex:i];
+                    if (!entity.exists) {
+                        id previousId = [previousIds objectAtIndex:i];
+                        [entity setField:SRK_DEFAULT_PRIMARY_KEY_NAME value:[previousId isKindOfClass:[NSNull class]] ? nil : previousId];
+                    }
+                }
+                
+                if (failedEntity.commitOptions.raiseErrors && [[SRKGlobals sharedObject] delegate] && [[[SRKGlobals sharedObject] delegate] respondsToSelector:@selector(databaseError:)]) {
+                    
+                    SRKError* e = [SRKError new];
+                    e.sqlQuery = sql;
+                    e.errorMessage = errorMessage;
+                    [[[SRKGlobals sharedObject] delegate] databaseError:e];
+                    
+                }
+                
+            }
+            
+        }];
+        
+        if (!succeded) {
+            return nil;
+        }
+        
+        for (SRKEntity* entity in written) {
+            if (!entity.exists) {
+                entity.exists = YES;
+                if ([SharkORM getSettings].defaultManagedObjects) {
+                    [entity setManagedObjectDomain:[SharkORM getSettings].defaultObjectDomain];
+                }
+            }
+            [entity setBase];
+        }
+        
+    }
+    
+    return written;
+    
+}
+
+- (NSString*)upsertStatementForEntity:(NSString*)entityName columns:(NSArray<NSString*>*)columns conflict:(NSArray<NSString*>*)conflictColumns update:(NSArray<NSString*>*)updateColumns where:(NSString*)condition {
+    
+    NSMutableString* sql = [[self insertStatementForEntity:entityName columns:columns conflictPolicy:SRKConflictPolicyFail] mutableCopy];
+    [sql deleteCharactersInRange:NSMakeRange(sql.length - 1, 1)];
+    [sql appendFormat:@" ON CONFLICT(%@) DO ", [conflictColumns componentsJoinedByString:@", "]];
+    
+    if (!updateColumns.count) {
+        [sql appendString:@"NOTHING;"];
+        return sql;
+    }
+    
+    NSMutableArray* assignments = [NSMutableArray new];
+    for (NSString* column in updateColumns) {
+        [assignments addObject:[NSString stringWithFormat:@"%@ = excluded.%@", column, column]];
+    }
+    [sql appendFormat:@"UPDATE SET %@", [assignments componentsJoinedByString:@", "]];
+    if (condition.length) {
+        [sql appendFormat:@" WHERE %@", condition];
+    }
+    [sql appendString:@";"];
+    
+    return sql;
+    
+}
+
+/*
+ *  the primary key of the row holding the same values as the entity in the given columns, used to find the row an upsert conflicted with.  Must be called whilst holding the write lock.
+ */
+- (id)primaryKeyForEntity:(SRKEntity*)entity matching:(NSArray<NSString*>*)columns inDatabase:(NSString*)databaseName {
+    
+    NSMutableArray* conditions = [NSMutableArray new];
+    for (NSString* column in columns) {
+        [conditions addObject:[NSString stringWithFormat:@"%@ = ?", column]];
+    }
+    
+    NSString* sql = [NSString stringWithFormat:@"SELECT %@ FROM %@ WHERE %@;", SRK_DEFAULT_PRIMARY_KEY_NAME, [entity.class description], [conditions componentsJoinedByString:@" AND "]];
+    sqlite3_stmt* statement = [[SRKGlobals sharedObject] cachedStatementForSQL:sql inDatabase:databaseName];
+    if (!statement) {
+        return nil;
+    }
+    
+    id key = nil;
+    [[SRKUtilities new] bindParameters:[self valuesForEntity:entity columns:columns] toStatement:statement];
+    if (sqlite3_step(statement) == SQLITE_ROW) {
+        key = [[SRKUtilities new] sqlite3_column_objc:statement column:0];
+    }
+    sqlite3_reset(statement);
+    sqlite3_clear_bindings(statement);
+    
+    return key;
+    
+}
+
+/*
+ *  INSERT ... ON CONFLICT DO UPDATE for each entity, only the row an object was merged into is read back.  Returns the event type for each entity (0 where the row was left alone), or nil if the batch failed & was rolled back.
+ */
+-(NSArray*)upsertObjects:(NSArray<SRKEntity*>*)entities onConflict:(NSArray<NSString*>*)conflictProperties update:(NSArray<NSString*>*)updateProperties where:(NSString*)condition {
+    
+    __block BOOL    succeded = YES;
+    NSMutableArray* outcomes = [NSMutableArray new];
+    
+    /* queued commits have to reach the table before the conflict target is checked against it */
+    [[SRKGlobals sharedObject] flushGroupCommit];
+    
+    // the following will block if there is a transaction occouring for anything other than a current transaction block
+    [SRKTransaction blockUntilTransactionFinishedForEntities:entities];
+    
+    BOOL inTransaction = [SRKTransaction transactionIsInProgress];
+    if (inTransaction) {
+        
+        if ([SRKTransaction currentTransactionStatus] != SRKTransactionPassed) {
+            return nil;
+        }
+        
+        /* the databases are locked for the transaction up front, waiting on another transaction whilst holding the write lock would stall every writer */
+        for (SRKEntity* entity in entities) {
+            if (![SRKTransaction startTransactionForDatabaseConnection:[SharkORM databaseNameForClass:entity.class]]) {
+                return nil;
+            }
+        }
+        
+        /* the objects are registered with the transaction in the same way as a commit, so a rollback puts them back in step with the database */
+        for (SRKEntity* entity in entities) {
+            if ([SRKTransaction entityRequiresRestorePoint:entity]) {
+                [SRKTransaction createRestorePointForEntity:entity];
+            }
+            entity.transactionInfo.eventType = entity.exists ? EventUpdate : EventInsert;
+            [SRKTransaction addReferencedObjectToTransactionList:entity];
+        }
+        
+    }
+    
+    [[SRKGlobals sharedObject] performWithWriteLockForDatabases:[SharkORM databaseNamesForEntities:entities] block:^{
+        
+        NSMutableArray* databases = [NSMutableArray new];
+        NSMutableDictionary* statements = [NSMutableDictionary new];
+        NSString* errorMessage = nil;
+        NSString* sql = nil;
+        
+        for (SRKEntity* entity in entities) {
+            
+            NSString* className = [entity.class description];
+            NSString* databaseNameForClass = [SharkORM databaseNameForClass:entity.class];
+            sqlite3* databaseHandle = [SharkORM handleForDatabase:databaseNameForClass];
+            
+            if (![databases containsObject:databaseNameForClass]) {
+                sql = @"BEGIN IMMEDIATE TRANSACTION";
+                if (!inTransaction && ![SharkORM executeSQL:sql inDatabase:databaseNameForClass errorMessage:&errorMessage]) {
+                    // a transaction on another thread has opened the shared handle since we checked, the batch cannot be kept apart from it
+                    succeded = NO;
+                } else {
+                    [databases addObject:databaseNameForClass];
+                }
+            }
+            
+            if (succeded) {
+                
+                sql = [statements objectForKey:className];
+                if (!sql) {
+                    sql = [self upsertStatementForEntity:className columns:[entity fieldNames] conflict:conflictProperties update:updateProperties where:condition];
+                    [statements setObject:sql forKey:className];
+                }
+                
+                /* a DO UPDATE leaves the last insert rowid alone, so clearing it tells us which of the two actually happened */
+                sqlite3_set_last_insert_rowid(databaseHandle, 0);
+                
+                if ([self executeCachedStatement:sql values:[self valuesForEntity:entity columns:[entity fieldNames]] inDatabase:databaseNameForClass errorMessage:&errorMessage] != SQLITE_DONE) {
+                    succeded = NO;
+                }
+                
+            }
+            
+            if (!succeded) {
+                
+                if (entity.commitOptions.raiseErrors) {
+                    
+                    if (inTransaction) {
+                        [SRKTransaction failTransactionWithCode:SRKTransactionFailed];
+                    }
+                    
+                    if ([[SRKGlobals sharedObject] delegate] && [[[SRKGlobals sharedObject] delegate] respondsToSelector:@selector(databaseError:)]) {
+                        SRKError* e = [SRKError new];
+                        e.sqlQuery = sql;
+                        e.errorMessage = errorMessage;
+                        [[[SRKGlobals sharedObject] delegate] databaseError:e];
+                    }
+                    
+                }
+                
+                break;
+                
+            }
+            
+            sqlite3_int64 rowid = sqlite3_last_insert_rowid(databaseHandle);
+            if (rowid == 0 && sqlite3_changes(databaseHandle) != 0 && [SharkSchemaManager.shared schemaClusteredKeyForEntity:className]) {
+                /* WITHOUT ROWID tables never set the last insert rowid, the row only carries this object's (new) Id if it was inserted */
+                rowid = [self rowExistsForEntity:entity inDatabase:databaseNameForClass] ? 1 : 0;
+            }
+            if (sqlite3_changes(databaseHandle) == 0) {
+                [outcomes addObject:@(0)];
+            } else if (rowid != 0) {
+                if ([SharkORM primaryKeyType:className] == SRK_PROPERTY_TYPE_NUMBER) {
+                    [entity setField:SRK_DEFAULT_PRIMARY_KEY_NAME value:@(rowid)];
+                }
+                [outcomes addObject:@(SharkORMEventInsert)];
+            } else {
+                [outcomes addObject:@(SharkORMEventUpdate)];
+            }
+            
+            if ([[outcomes lastObject] intValue] != SharkORMEventInsert) {
+                /* merged into (or left alone by) an existing row, so the object takes that row's primary key rather than the one it was given locally */
+                id key = [self primaryKeyForEntity:entity matching:conflictProperties inDatabase:databaseNameForClass];
+                if (key) {
+                    [entity setField:SRK_DEFAULT_PRIMARY_KEY_NAME value:key];
+                }
+                entity.transactionInfo.eventType = EventUpdate;
+            } else {
+                entity.transactionInfo.eventType = EventInsert;
+            }
+            
+        }
+        
+        if (!inTransaction) {
+            for (NSString* database in databases) {
+                [SharkORM executeSQL:succeded ? @"COMMIT" : @"ROLLBACK" inDatabase:database];
+            }
+        }
+        
+    }];
+    
+    if (!succeded) {
+        /* nothing was kept, so don't leave Id's from the rolled back inserts on the objects */
+        for (NSUInteger i = 0; i < outcomes.count; i++) {
+            SRKEntity* entity = [entities objectAtIndex:i];
+            if ([[outcomes objectAtIndex:i] intValue] == SharkORMEventInsert && [SharkORM primaryKeyType:[entity.class description]] == SRK_PROPERTY_TYPE_NUMBER) {
+                [entity setField:SRK_DEFAULT_PRIMARY_KEY_NAME value:nil];
+            }
+        }
+        return nil;
+    }
+    
+    return outcomes;
+    
+}
+
+-(BOOL)removeObjects:(NSArray<SRKEntity*>*)entities {
+    
+    __block BOOL succeded = YES;
+    
+    // the following will block if there is a transaction occouring for anything other than a current transaction block
+    [SRKTransaction blockUntilTransactionFinishedForEntities:entities];
+    
+    [[SRKGlobals sharedObject] performWithWriteLockForDatabases:[SharkORM databaseNamesForEntities:entities] block:^{
+        
+        NSMutableArray* databases = [NSMutableArray new];
+        NSString* errorMessage = nil;
+        NSString* sql = nil;
+        
+        for (SRKEntity* entity in entities) {
+            
+            NSString* databaseNameForClass = [SharkORM databaseNameForClass:entity.class];
+            if (![databases containsObject:databaseNameForClass]) {
+                sql = @"BEGIN IMMEDIATE TRANSACTION";
+                if ([SharkORM executeSQL:sql inDatabase:databaseNameForClass errorMessage:&errorMessage]) {
+                    [databases addObject:databaseNameForClass];
+                } else {
+                    // a transaction on another thread has opened the shared handle since we checked, the batch cannot be kept apart from it
+                    succeded = NO;
+                }
+            }
+            
+            if (succeded) {
+                sql = [NSString stringWithFormat:@"DELETE FROM %@ WHERE %@ = ?;", [entity.class description], SRK_DEFAULT_PRIMARY_KEY_NAME];
+                if ([self executeCachedStatement:sql values:@[entity.reflectedPrimaryKeyValue] inDatabase:databaseNameForClass errorMessage:&errorMessage] != SQLITE_DONE) {
+                    succeded = NO;
+                }
+            }
+            
+            if (!succeded) {
+                
+                if (entity.commitOptions.raiseErrors && [[SRKGlobals sharedObject] delegate] && [[[SRKGlobals sharedObject] delegate] respondsToSelector:@selector(databaseError:)]) {
+                    
+                    SRKError* e = [SRKError new];
+                    e.sqlQuery = sql;
+                    e.errorMessage = errorMessage;
+                    [[[SRKGlobals sharedObject] delegate] databaseError:e];
+                    
+                }
+                
+                break;
+                
+            }
+            
+        }
+        
+        for (NSString* database in databases) {
+            [SharkORM executeSQL:succeded ? @"COMMIT" : @"ROLLBACK" inDatabase:database];
+        }
+        
+    }];
+    
+    if (succeded) {
+        for (SRKEntity* entity in entities) {
+            [entity setSterilised:YES];
+        }
+    }
+    
+    return succeded;
+    
+}
+
 -(BOOL)removeObject:(SRKEntity *)entity {
     
     __block BOOL    succeded = NO;
@@ -850,31 +1945,26 @@ void stringFromDate(sqlite3_context *context, int argc, sqlite3_value **argv)
     NSString* entityName = [entity.class description];
     
     // the following will block if there is a transaction occouring for anything other than a current transaction block
-    [SRKTransaction blockUntilTransactionFinished];
+    [SRKTransaction blockUntilTransactionFinishedForDatabase:databaseNameForClass];
     
     if ([SRKTransaction transactionIsInProgress]) {
         
-        // check to see if there was an error within the transaction so far and return if there was.
-        if ([SRKTransaction currentTransactionStatus] != SRKTransactionPassed) {
+        // check to see if there was an error within the transaction so far, or the database is held by another transaction, and return if there was.
+        if ([SRKTransaction currentTransactionStatus] != SRKTransactionPassed || ![SRKTransaction startTransactionForDatabaseConnection:databaseNameForClass]) {
             return NO;
         }
         
         // this means we ar ecurrently within a transaction, so we need to create an information object to describe what is happening before the commit
-        if (!entity.transactionInfo) {
-            SRKTransactionInfo* info = [SRKTransactionInfo new];
-            info.eventType = EventDelete;
-            [info copyObjectValuesIntoRestorePoint:entity];
-            entity.transactionInfo = info;
-        } else {
-            entity.transactionInfo.eventType = EventDelete;
+        if ([SRKTransaction entityRequiresRestorePoint:entity]) {
+            [SRKTransaction createRestorePointForEntity:entity];
         }
+        entity.transactionInfo.eventType = EventDelete;
         
-        [SRKTransaction startTransactionForDatabaseConnection:databaseNameForClass];
         [SRKTransaction addReferencedObjectToTransactionList:entity];
         
     }
     
-    @synchronized([[SRKGlobals sharedObject] writeLockObject]) {
+    @synchronized([[SRKGlobals sharedObject] writeLockObjectForDatabase:databaseNameForClass]) {
         
         sqlite3_stmt* statement;
         
@@ -948,31 +2038,26 @@ void stringFromDate(sqlite3_context *context, int argc, sqlite3_value **argv)
     NSString* entityName = [entity.class description];
     
     // the following will block if there is a transaction occouring for anything other than a current transaction block
-    [SRKTransaction blockUntilTransactionFinished];
+    [SRKTransaction blockUntilTransactionFinishedForDatabase:databaseNameForClass];
     
     if ([SRKTransaction transactionIsInProgress]) {
         
-        // check to see if there was an error within the transaction so far and return if there was.
-        if ([SRKTransaction currentTransactionStatus] != SRKTransactionPassed) {
+        // check to see if there was an error within the transaction so far, or the database is held by another transaction, and return if there was.
+        if ([SRKTransaction currentTransactionStatus] != SRKTransactionPassed || ![SRKTransaction startTransactionForDatabaseConnection:databaseNameForClass]) {
             return;
         }
         
         // this means we ar ecurrently within a transaction, so we need to create an information object to describe what is happening before the commit
-        if (!entity.transactionInfo) {
-            SRKTransactionInfo* info = [SRKTransactionInfo new];
-            info.eventType = EventUpdate;
-            [info copyObjectValuesIntoRestorePoint:entity];
-            entity.transactionInfo = info;
-        } else {
-            entity.transactionInfo.eventType = EventUpdate;
+        if ([SRKTransaction entityRequiresRestorePoint:entity]) {
+            [SRKTransaction createRestorePointForEntity:entity];
         }
+        entity.transactionInfo.eventType = EventUpdate;
         
         [SRKTransaction addReferencedObjectToTransactionList:entity];
-        [SRKTransaction startTransactionForDatabaseConnection:databaseNameForClass];
         
     }
     
-    @synchronized([[SRKGlobals sharedObject] writeLockObject]) {
+    @synchronized([[SRKGlobals sharedObject] writeLockObjectForDatabase:databaseNameForClass]) {
         
         sqlite3_stmt* statement;
         
@@ -1069,9 +2154,14 @@ void stringFromDate(sqlite3_context *context, int argc, sqlite3_value **argv)
     
     parseT = [[NSDate date] timeIntervalSince1970];
     
-    [SRKTransaction blockUntilTransactionFinished];
+    NSString* databaseName = [SharkORM databaseNameForClass:classDecl];
+    sqlite3* databaseHandle = [SharkORM snapshotHandleForDatabase:databaseName];
+    if (!databaseHandle) {
+        [SRKTransaction blockUntilTransactionFinishedForDatabase:databaseName];
+        databaseHandle = [SharkORM handleForDatabase:databaseName];
+    }
     
-    if (sqlite3_prepare_v2([SharkORM handleForDatabase:[SharkORM databaseNameForClass:classDecl]], [sql UTF8String], -1, &statement, nil) == SQLITE_OK) {
+    if (sqlite3_prepare_v2(databaseHandle, [sql UTF8String], -1, &statement, nil) == SQLITE_OK) {
         
         parseT = [[NSDate date] timeIntervalSince1970] - parseT;
         
@@ -1107,7 +2197,6 @@ void stringFromDate(sqlite3_context *context, int argc, sqlite3_value **argv)
     } else {
         
         // notify any running transaction that it has been failed
-        [SRKTransaction blockUntilTransactionFinished];
         if ([SRKTransaction transactionIsInProgress]) {
             [SRKTransaction failTransactionWithCode:SRKTransactionFailed];
         }
@@ -1117,7 +2206,7 @@ void stringFromDate(sqlite3_context *context, int argc, sqlite3_value **argv)
             
             SRKError* e = [SRKError new];
             e.sqlQuery = sql;
-            e.errorMessage = [NSString stringWithUTF8String:sqlite3_errmsg([SharkORM handleForDatabase:classDecl])];
+            e.errorMessage = [NSString stringWithUTF8String:sqlite3_errmsg(databaseHandle)];
             [[[SRKGlobals sharedObject] delegate] databaseError:e];
             
         }
@@ -1145,7 +2234,7 @@ void stringFromDate(sqlite3_context *context, int argc, sqlite3_value **argv)
         
         NSString* planStr = [NSString stringWithFormat:@"EXPLAIN QUERY PLAN %@", sql];
         
-        if (sqlite3_prepare_v2([SharkORM handleForDatabase:[SharkORM databaseNameForClass:classDecl]], [planStr UTF8String], -1, &plan, nil) == SQLITE_OK) {
+        if (sqlite3_prepare_v2(databaseHandle, [planStr UTF8String], -1, &plan, nil) == SQLITE_OK) {
             
             int status = sqlite3_step(plan);
             
@@ -1196,7 +2285,6 @@ void stringFromDate(sqlite3_context *context, int argc, sqlite3_value **argv)
 - (void)handleError:(sqlite3*)db sql:(NSString*)sql {
     
     // notify any running transaction that it has been failed
-    [SRKTransaction blockUntilTransactionFinished];
     if ([SRKTransaction transactionIsInProgress]) {
         [SRKTransaction failTransactionWithCode:SRKTransactionFailed];
     }
@@ -1214,19 +2302,10 @@ void stringFromDate(sqlite3_context *context, int argc, sqlite3_value **argv)
     
 }
 
-- (NSMutableArray*)performQuery:(SRKQuery*)query rowBlock:(SQLQueryRowBlock)rowBlock {
-    
-    NSTimeInterval startT = [[NSDate date] timeIntervalSince1970];
-    NSTimeInterval finishT = [[NSDate date] timeIntervalSince1970];
-    __block NSTimeInterval parseT = [[NSDate date] timeIntervalSince1970];
-    __block NSTimeInterval firstResultT = [[NSDate date] timeIntervalSince1970];
-    __block NSTimeInterval lockwaitT = [[NSDate date] timeIntervalSince1970];
-    
-    if (query && (query.recordPerformance || [[[SRKGlobals sharedObject] delegate] respondsToSelector:@selector(queryPerformedWithProfile:)])) {
-        if(!query.performance) {
-            query.performance = [SRKQueryProfile new];
-        }
-    }
+/*
+ *  builds the SELECT statement for a query, based on its query type.
+ */
+- (NSString*)sqlForQuery:(SRKQuery*)query {
     
     NSMutableArray*   getFieldList = [NSMutableArray new];
     NSMutableArray*   fromList = [NSMutableArray new];
@@ -1235,6 +2314,11 @@ void stringFromDate(sqlite3_context *context, int argc, sqlite3_value **argv)
     // always add in the originating class
     [fromList addObject:[query.classDecl description]];
     
+    // full text matches are joined straight onto it
+    if (query.fullTextJoins.count) {
+        [fromList addObjectsFromArray:query.fullTextJoins];
+    }
+    
     switch (query.queryType) {
             
         case SRK_QUERY_TYPE_FETCH:
@@ -1279,7 +2363,7 @@ void stringFromDate(sqlite3_context *context, int argc, sqlite3_value **argv)
             break;
             
         case SRK_QUERY_TYPE_IDS:
-            [getFieldList addObject: @" Id "];
+            [getFieldList addObject: [NSString stringWithFormat:@" %@.%@ ", tableName, SRK_DEFAULT_PRIMARY_KEY_NAME]];
             
         default:
             break;
@@ -1333,10 +2417,8 @@ void stringFromDate(sqlite3_context *context, int argc, sqlite3_value **argv)
         
     }
     
-    NSMutableArray* resultsSet = nil;
-    
     NSString* sql = @"";
-    sql = [NSString stringWithFormat:@"SELECT %@ FROM %@ WHERE %@ ORDER BY %@ LIMIT %i OFFSET %i",[getFieldList componentsJoinedByString:@", "], [fromList componentsJoinedByString:@" "], query.whereClause, query.orderBy, query.limitOf, query.offsetFrom];
+    sql = [NSString stringWithFormat:@"SELECT %@ FROM %@ WHERE %@ ORDER BY %@ LIMIT %i OFFSET %i",[getFieldList componentsJoinedByString:@", "], [fromList componentsJoinedByString:@" "], [query compiledWhereClause], query.orderBy, query.limitOf, query.offsetFrom];
     
     /* optimise the query by removing the global default query options */
     NSString* defaultWhere = [NSString stringWithFormat:@"WHERE %@", SRK_DEFAULT_CONDITION];
@@ -1350,8 +2432,29 @@ void stringFromDate(sqlite3_context *context, int argc, sqlite3_value **argv)
         sql = [sql stringByReplacingOccurrencesOfString:defaultLimit withString:@""];
     }
     
-    sql = [sql stringByReplacingOccurrencesOfString:defaultOffset withString:@""];
-    sql = [sql stringByReplacingOccurrencesOfString:defaultOrder withString:@""];
+    sql = [sql stringByReplacingOccurrencesOfString:defaultOffset withString:@""];
+    sql = [sql stringByReplacingOccurrencesOfString:defaultOrder withString:@""];
+    
+    return sql;
+    
+}
+
+- (NSMutableArray*)performQuery:(SRKQuery*)query rowBlock:(SQLQueryRowBlock)rowBlock {
+    
+    NSTimeInterval startT = [[NSDate date] timeIntervalSince1970];
+    NSTimeInterval finishT = [[NSDate date] timeIntervalSince1970];
+    __block NSTimeInterval parseT = [[NSDate date] timeIntervalSince1970];
+    __block NSTimeInterval firstResultT = [[NSDate date] timeIntervalSince1970];
+    __block NSTimeInterval lockwaitT = [[NSDate date] timeIntervalSince1970];
+    
+    if (query && (query.recordPerformance || [[[SRKGlobals sharedObject] delegate] respondsToSelector:@selector(queryPerformedWithProfile:)])) {
+        if(!query.performance) {
+            query.performance = [SRKQueryProfile new];
+        }
+    }
+    
+    NSMutableArray* resultsSet = nil;
+    NSString* sql = [self sqlForQuery:query];
     
     resultsSet = [[NSMutableArray alloc] init];
     
@@ -1361,15 +2464,28 @@ void stringFromDate(sqlite3_context *context, int argc, sqlite3_value **argv)
     
     parseT = [[NSDate date] timeIntervalSince1970];
     
-    [SRKTransaction blockUntilTransactionFinished];
-    
     Class entityClass = query.classDecl;
+    NSString* databaseName = [SharkORM databaseNameForClass:entityClass];
+    sqlite3* databaseHandle = [SharkORM handleForDatabase:databaseName];
+    
+    /* outside of a transaction the query is run on one of the read connections, so it doesn't queue up behind the writer.  Within a transaction it has to see the uncommitted changes, and within a read snapshot it uses the connection pinned for it */
+    sqlite3* snapshotHandle = [SharkORM snapshotHandleForDatabase:databaseName];
+    sqlite3* readHandle = ([SRKTransaction transactionIsInProgress] || snapshotHandle) ? NULL : [[SRKGlobals sharedObject] checkoutReadHandleForName:databaseName];
+    if (snapshotHandle) {
+        databaseHandle = snapshotHandle;
+    } else if (readHandle) {
+        databaseHandle = readHandle;
+    } else {
+        /* a read connection only ever sees committed data, but the writer connection is shared with any transaction open on this database */
+        [SRKTransaction blockUntilTransactionFinishedForDatabase:databaseName];
+    }
     
-    if (sqlite3_prepare_v2([SharkORM handleForDatabase:[SharkORM databaseNameForClass:entityClass]], [sql UTF8String], -1, &statement, nil) == SQLITE_OK) {
+    if (sqlite3_prepare_v2(databaseHandle, [sql UTF8String], -1, &statement, nil) == SQLITE_OK) {
         
-        if (query.parameters && query.parameters.count) {
+        NSArray* parameters = [query compiledParameters];
+        if (parameters && parameters.count) {
             /* loop through the parameters using the bind command, stops injection attacks */
-            [[SRKUtilities new] bindParameters:query.parameters toStatement:statement];
+            [[SRKUtilities new] bindParameters:parameters toStatement:statement];
         }
         
         parseT = [[NSDate date] timeIntervalSince1970] - parseT;
@@ -1392,7 +2508,7 @@ void stringFromDate(sqlite3_context *context, int argc, sqlite3_value **argv)
         
     } else {
         
-        [self handleError:[SharkORM handleForDatabase:[SharkORM databaseNameForClass:entityClass]] sql:sql];
+        [self handleError:databaseHandle sql:sql];
         
     }
     
@@ -1415,7 +2531,7 @@ void stringFromDate(sqlite3_context *context, int argc, sqlite3_value **argv)
         
         NSString* planStr = [NSString stringWithFormat:@"EXPLAIN QUERY PLAN %@", sql];
         
-        if (sqlite3_prepare_v2([SharkORM handleForDatabase:[SharkORM databaseNameForClass:entityClass]], [planStr UTF8String], -1, &plan, nil) == SQLITE_OK) {
+        if (sqlite3_prepare_v2(databaseHandle, [planStr UTF8String], -1, &plan, nil) == SQLITE_OK) {
             
             int status = sqlite3_step(plan);
             
@@ -1464,6 +2580,10 @@ void stringFromDate(sqlite3_context *context, int argc, sqlite3_value **argv)
         
     }
     
+    if (readHandle) {
+        [[SRKGlobals sharedObject] checkinReadHandle:readHandle forName:databaseName];
+    }
+    
     return resultsSet;
     
 }
@@ -1500,6 +2620,11 @@ void stringFromDate(sqlite3_context *context, int argc, sqlite3_value **argv)
             [object setSterilised:YES]; /* can't commit lightweight objects back into the fold */
         }
         
+        if (query.threadConfinedObjects || object.threadConfined) {
+            /* the object is owned by whichever thread first uses it, which need not be the one that fetched it */
+            object.threadConfined = YES;
+        }
+        
         if (object) {
             /* now we need to register this object with the default registry, first check to see if the user wants a default domain */
             if ([SharkORM getSettings].defaultManagedObjects) {
@@ -1574,10 +2699,536 @@ void stringFromDate(sqlite3_context *context, int argc, sqlite3_value **argv)
     query.queryType = SRK_QUERY_TYPE_IDS;
     return [self performQuery:query rowBlock:^(sqlite3_stmt *statement, NSMutableArray *resultsSet) {
         
-        [resultsSet addObject:@(sqlite3_column_int(statement, 0))];
+        [resultsSet addObject:[[SRKUtilities new] sqlite3_column_objc:statement column:0]];
+        
+    }];
+    
+}
+
+/*
+ *  export, each row is formatted straight from the sqlite3_column_* values into a buffer which is written to the stream whenever it fills.  No entities or value objects are created per row.
+ */
+
+static BOOL srkWriteExportBuffer(NSOutputStream* stream, NSMutableData* buffer) {
+    
+    const uint8_t* bytes = buffer.bytes;
+    NSUInteger remaining = buffer.length;
+    while (remaining) {
+        NSInteger written = [stream write:bytes maxLength:remaining];
+        if (written <= 0) {
+            return NO;
+        }
+        bytes += written;
+        remaining -= written;
+    }
+    buffer.length = 0;
+    return YES;
+    
+}
+
+static void srkAppendCSVText(NSMutableData* buffer, const unsigned char* text, int length) {
+    
+    /* an empty value is quoted, so that it can be told apart from NULL */
+    BOOL quote = (length == 0);
+    for (int i = 0; i < length && !quote; i++) {
+        quote = (text[i] == ',' || text[i] == '"' || text[i] == '\n' || text[i] == '\r');
+    }
+    
+    if (!quote) {
+        [buffer appendBytes:text length:length];
+        return;
+    }
+    
+    /* quoted, with any quotes inside the value doubled up */
+    int start = 0;
+    [buffer appendBytes:"\"" length:1];
+    for (int i = 0; i < length; i++) {
+        if (text[i] == '"') {
+            [buffer appendBytes:text + start length:i - start + 1];
+            [buffer appendBytes:"\"" length:1];
+            start = i + 1;
+        }
+    }
+    [buffer appendBytes:text + start length:length - start];
+    [buffer appendBytes:"\"" length:1];
+    
+}
+
+static void srkAppendJSONText(NSMutableData* buffer, const unsigned char* text, int length) {
+    
+    int start = 0;
+    [buffer appendBytes:"\"" length:1];
+    for (int i = 0; i < length; i++) {
+        
+        unsigned char c = text[i];
+        if (c != '"' && c != '\\' && c >= 0x20) {
+            continue;
+        }
+        
+        char escape[8];
+        int escapeLength;
+        switch (c) {
+            case '"':
+                escapeLength = snprintf(escape, sizeof(escape), "\\\"");
+                break;
+            case '\\':
+                escapeLength = snprintf(escape, sizeof(escape), "\\\\");
+                break;
+            case '\n':
+                escapeLength = snprintf(escape, sizeof(escape), "\\n");
+                break;
+            case '\r':
+                escapeLength = snprintf(escape, sizeof(escape), "\\r");
+                break;
+            case '\t':
+                escapeLength = snprintf(escape, sizeof(escape), "\\t");
+                break;
+            default:
+                escapeLength = snprintf(escape, sizeof(escape), "\\u%04x", c);
+                break;
+        }
+        
+        [buffer appendBytes:text + start length:i - start];
+        [buffer appendBytes:escape length:escapeLength];
+        start = i + 1;
+        
+    }
+    [buffer appendBytes:text + start length:length - start];
+    [buffer appendBytes:"\"" length:1];
+    
+}
+
+static void srkAppendColumnValue(NSMutableData* buffer, sqlite3_stmt* statement, int column, SRKExportFormat format) {
+    
+    char number[32];
+    int length = 0;
+    
+    switch (sqlite3_column_type(statement, column)) {
+            
+        case SQLITE_INTEGER:
+            length = snprintf(number, sizeof(number), "%lld", sqlite3_column_int64(statement, column));
+            [buffer appendBytes:number length:length];
+            break;
+            
+        case SQLITE_FLOAT:
+        {
+            /* the shortest form which reads back as the same value */
+            double value = sqlite3_column_double(statement, column);
+            length = snprintf(number, sizeof(number), "%.15g", value);
+            if (strtod(number, NULL) != value) {
+                length = snprintf(number, sizeof(number), "%.17g", value);
+            }
+            [buffer appendBytes:number length:length];
+            break;
+        }
+            
+        case SQLITE_TEXT:
+        {
+            const unsigned char* text = sqlite3_column_text(statement, column);
+            length = sqlite3_column_bytes(statement, column);
+            if (format == SRKExportFormatJSONLines) {
+                srkAppendJSONText(buffer, text, length);
+            } else {
+                srkAppendCSVText(buffer, text, length);
+            }
+            break;
+        }
+            
+        case SQLITE_BLOB:
+        {
+            /* binary data has no textual form, so is written as base64 */
+            NSData* data = [NSData dataWithBytesNoCopy:(void*)sqlite3_column_blob(statement, column) length:sqlite3_column_bytes(statement, column) freeWhenDone:NO];
+            NSData* encoded = [data base64EncodedDataWithOptions:0];
+            if (format == SRKExportFormatJSONLines) {
+                srkAppendJSONText(buffer, encoded.bytes, (int)encoded.length);
+            } else {
+                [buffer appendData:encoded];
+            }
+            break;
+        }
+            
+        default:
+            if (format == SRKExportFormatJSONLines) {
+                [buffer appendBytes:"null" length:4];
+            }
+            break;
+            
+    }
+    
+}
+
+-(uint64_t)exportForQuery:(SRKQuery*)query toStream:(NSOutputStream*)stream format:(SRKExportFormat)format {
+    
+    if (stream.streamStatus == NSStreamStatusNotOpen) {
+        [stream open];
+    }
+    
+    NSMutableData* buffer = [NSMutableData dataWithCapacity:SRK_EXPORT_WRITE_BUFFER_SIZE * 2];
+    __block NSArray<NSData*>* columnNames = nil;
+    __block uint64_t rows = 0;
+    __block BOOL failed = NO;
+    
+    query.queryType = SRK_QUERY_TYPE_FETCH;
+    [self performQuery:query rowBlock:^(sqlite3_stmt *statement, NSMutableArray *resultsSet) {
+        
+        int count = sqlite3_column_count(statement);
+        
+        if (!columnNames) {
+            
+            /* the names are worked out once, from the first row, joined values are named <table>.<property> */
+            NSMutableArray* names = [NSMutableArray new];
+            for (int i = 0; i < count; i++) {
+                NSString* name = [[SRKUtilities new] normalizedColumnName:[NSString stringWithUTF8String:sqlite3_column_name(statement, i)]];
+                NSData* nameData = [[name stringByReplacingOccurrencesOfString:@"_$_" withString:@"."] dataUsingEncoding:NSUTF8StringEncoding];
+                NSMutableData* formatted = [NSMutableData new];
+                if (format == SRKExportFormatJSONLines) {
+                    srkAppendJSONText(formatted, nameData.bytes, (int)nameData.length);
+                    [formatted appendBytes:":" length:1];
+                } else {
+                    srkAppendCSVText(formatted, nameData.bytes, (int)nameData.length);
+                }
+                [names addObject:formatted];
+            }
+            columnNames = names;
+            
+            if (format == SRKExportFormatCSV) {
+                for (int i = 0; i < count; i++) {
+                    if (i) {
+                        [buffer appendBytes:"," length:1];
+                    }
+                    [buffer appendData:[columnNames objectAtIndex:i]];
+                }
+                [buffer appendBytes:"\r\n" length:2];
+            }
+            
+        }
+        
+        if (format == SRKExportFormatJSONLines) {
+            [buffer appendBytes:"{" length:1];
+            for (int i = 0; i < count; i++) {
+                if (i) {
+                    [buffer appendBytes:"," length:1];
+                }
+                [buffer appendData:[columnNames objectAtIndex:i]];
+                srkAppendColumnValue(buffer, statement, i, format);
+            }
+            [buffer appendBytes:"}\n" length:2];
+        } else {
+            for (int i = 0; i < count; i++) {
+                if (i) {
+                    [buffer appendBytes:"," length:1];
+                }
+                srkAppendColumnValue(buffer, statement, i, format);
+            }
+            [buffer appendBytes:"\r\n" length:2];
+        }
+        rows++;
+        
+        if (buffer.length >= SRK_EXPORT_WRITE_BUFFER_SIZE && !srkWriteExportBuffer(stream, buffer)) {
+            /* stops the query from stepping any further */
+            failed = YES;
+            query.quit = YES;
+        }
         
     }];
     
+    if (failed) {
+        query.quit = NO;
+    } else if (buffer.length) {
+        failed = !srkWriteExportBuffer(stream, buffer);
+    }
+    
+    if (failed) {
+        
+        if ([[SRKGlobals sharedObject] delegate] && [[[SRKGlobals sharedObject] delegate] respondsToSelector:@selector(databaseError:)]) {
+            SRKError* e = [SRKError new];
+            e.errorMessage = [NSString stringWithFormat:@"Unable to write the export to the stream, %@", stream.streamError.localizedDescription];
+            [[[SRKGlobals sharedObject] delegate] databaseError:e];
+        }
+        return 0;
+        
+    }
+    
+    return rows;
+    
+}
+
+/*
+ *  set based UPDATE/DELETE, the query is compiled into a single statement rather than materialising and writing each matching entity.  Returns the number of rows affected.
+ */
+-(uint64_t)executeSetStatement:(NSString*)statementPrefix parameters:(NSArray*)statementParameters forQuery:(SRKQuery*)query primaryKeys:(NSArray**)primaryKeys {
+    
+    NSString* databaseNameForClass = [SharkORM databaseNameForClass:query.classDecl];
+    sqlite3* databaseHandle = [SharkORM handleForDatabase:databaseNameForClass];
+    uint64_t affected = 0;
+    
+    /* a plain WHERE can be used directly, but anything with joins or a limit has to go through a sub-select of the primary keys */
+    query.queryType = SRK_QUERY_TYPE_IDS;
+    NSString* selectSql = [self sqlForQuery:query];
+    NSString* whereClause = [query compiledWhereClause];
+    if (query.joins.count || query.limitOf != SRK_DEFAULT_LIMIT || query.offsetFrom != SRK_DEFAULT_OFFSET || [selectSql rangeOfString:@" JOIN "].location != NSNotFound) {
+        whereClause = [NSString stringWithFormat:@"%@ IN (%@)", SRK_DEFAULT_PRIMARY_KEY_NAME, selectSql];
+    }
+    
+    NSString* sql = [NSString stringWithFormat:@"%@ WHERE %@;", statementPrefix, whereClause];
+    NSMutableArray* parameters = [NSMutableArray arrayWithArray:statementParameters];
+    [parameters addObjectsFromArray:[query compiledParameters]];
+    
+    // the following will block if there is a transaction occouring for anything other than a current transaction block
+    [SRKTransaction blockUntilTransactionFinishedForDatabase:databaseNameForClass];
+    
+    if ([SRKTransaction transactionIsInProgress]) {
+        
+        // check to see if there was an error within the transaction so far, or the database is held by another transaction, and return if there was.
+        if ([SRKTransaction currentTransactionStatus] != SRKTransactionPassed || ![SRKTransaction startTransactionForDatabaseConnection:databaseNameForClass]) {
+            return 0;
+        }
+        
+    }
+    
+    @synchronized([[SRKGlobals sharedObject] writeLockObjectForDatabase:databaseNameForClass]) {
+        
+        /* if the caller wants to know exactly which rows changed, grab the keys whilst we hold the lock so nothing can sneak in between */
+        sqlite3_stmt* statement;
+        
+        if (primaryKeys) {
+            NSMutableArray* keys = [NSMutableArray new];
+            if (sqlite3_prepare_v2(databaseHandle, [selectSql UTF8String], -1, &statement, nil) == SQLITE_OK) {
+                [[SRKUtilities new] bindParameters:[query compiledParameters] toStatement:statement];
+                while (sqlite3_step(statement) == SQLITE_ROW) {
+                    [keys addObject:[[SRKUtilities new] sqlite3_column_objc:statement column:0]];
+                }
+            }
+            sqlite3_finalize(statement);
+            *primaryKeys = keys;
+        }
+        
+        if (sqlite3_prepare_v2(databaseHandle, [sql UTF8String], -1, &statement, nil) == SQLITE_OK) {
+            
+            [[SRKUtilities new] bindParameters:parameters toStatement:statement];
+            
+            if (sqlite3_step(statement) == SQLITE_DONE) {
+                affected = sqlite3_changes(databaseHandle);
+            } else {
+                [self handleError:databaseHandle sql:sql];
+            }
+            
+        } else {
+            
+            [self handleError:databaseHandle sql:sql];
+            
+        }
+        
+        sqlite3_finalize(statement);
+        
+    }
+    
+    return affected;
+    
+}
+
+-(uint64_t)deleteForQuery:(SRKQuery*)query primaryKeys:(NSArray**)primaryKeys {
+    
+    return [self executeSetStatement:[NSString stringWithFormat:@"DELETE FROM %@", [query.classDecl description]] parameters:nil forQuery:query primaryKeys:primaryKeys];
+    
+}
+
+-(uint64_t)updateForQuery:(SRKQuery*)query values:(NSDictionary*)values primaryKeys:(NSArray**)primaryKeys {
+    
+    NSString* tableName = [query.classDecl description];
+    NSArray* schemaProperties = [SharkSchemaManager.shared schemaPropertiesForEntity:tableName];
+    NSArray* encryptedProperties = [query.classDecl encryptedPropertiesForClass];
+    
+    NSMutableArray* assignments = [NSMutableArray new];
+    NSMutableArray* parameters = [NSMutableArray new];
+    
+    for (NSString* property in values.allKeys) {
+        
+        /* the primary key and encrypted values can't be written this way, as the values are not passed through the entity */
+        if (![schemaProperties containsObject:property] || [property isEqualToString:SRK_DEFAULT_PRIMARY_KEY_NAME] || [encryptedProperties containsObject:property]) {
+            
+            if ([[SRKGlobals sharedObject] delegate] && [[[SRKGlobals sharedObject] delegate] respondsToSelector:@selector(databaseError:)]) {
+                SRKError* e = [SRKError new];
+                e.errorMessage = [NSString stringWithFormat:@"Property '%@' can not be updated on '%@' by a set based update.", property, tableName];
+                [[[SRKGlobals sharedObject] delegate] databaseError:e];
+            }
+            return 0;
+            
+        }
+        
+        id value = [values objectForKey:property];
+        if ([value isKindOfClass:[SRKEntity class]]) {
+            value = ((SRKEntity*)value).Id ? ((SRKEntity*)value).Id : [NSNull null];
+        }
+        
+        [assignments addObject:[NSString stringWithFormat:@"%@ = ?", property]];
+        [parameters addObject:value];
+        
+    }
+    
+    if (!assignments.count) {
+        return 0;
+    }
+    
+    return [self executeSetStatement:[NSString stringWithFormat:@"UPDATE %@ SET %@", tableName, [assignments componentsJoinedByString:@", "]] parameters:parameters forQuery:query primaryKeys:primaryKeys];
+    
+}
+
+#pragma mark - bulk import
+
+/*
+ *  the file is read in fixed size chunks and split into records as it goes, only the record being assembled is held on to.  CSV follows RFC 4180, quoted fields can hold
+ *  commas, doubled quotes and line breaks, and the first record names the columns.  JSON-lines holds one object per line.
+ */
+-(uint64_t)importFile:(NSString*)filePath format:(SRKImportFormat)format intoClass:(Class)classDecl options:(SRKImportOptions*)options {
+    
+    NSInputStream* stream = [NSInputStream inputStreamWithFileAtPath:filePath];
+    [stream open];
+    
+    if (stream.streamStatus != NSStreamStatusOpen) {
+        if ([[SRKGlobals sharedObject] delegate] && [[[SRKGlobals sharedObject] delegate] respondsToSelector:@selector(databaseError:)]) {
+            SRKError* e = [SRKError new];
+            e.errorMessage = [NSString stringWithFormat:@"Unable to open '%@' for import.", filePath];
+            [[[SRKGlobals sharedObject] delegate] databaseError:e];
+        }
+        return 0;
+    }
+    
+    SRKBulkImport* import = [[SRKBulkImport alloc] initWithClass:classDecl options:options];
+    import.totalBytes = [[[NSFileManager defaultManager] attributesOfItemAtPath:filePath error:nil] fileSize];
+    
+    NSMutableData* field = [NSMutableData new];
+    NSMutableArray* fields = [NSMutableArray new];
+    NSArray* header = nil;
+    BOOL inQuotes = NO;
+    BOOL quoted = NO;
+    BOOL pendingQuote = NO;
+    BOOL stop = NO;
+    uint64_t line = 0;
+    NSString* errorMessage = nil;
+    
+    uint8_t buffer[SRK_IMPORT_READ_BUFFER_SIZE];
+    
+    while (!stop) {
+        
+        @autoreleasepool {
+            
+            NSInteger length = [stream read:buffer maxLength:sizeof(buffer)];
+            BOOL endOfFile = (length <= 0);
+            if (!endOfFile) {
+                import.bytesRead += length;
+            }
+            
+            /* the end of the file terminates the last record, if it didn't have a line break of its own */
+            if (endOfFile) {
+                buffer[0] = '\n';
+                length = (field.length || fields.count || quoted) ? 1 : 0;
+                inQuotes = NO;
+                pendingQuote = NO;
+            }
+            
+            for (NSInteger i = 0; i < length && !stop; i++) {
+                
+                uint8_t c = buffer[i];
+                
+                if (format == SRKImportFormatJSONLines) {
+                    
+                    if (c != '\n') {
+                        [field appendBytes:&c length:1];
+                        continue;
+                    }
+                    
+                    line++;
+                    NSString* text = [[NSString alloc] initWithData:field encoding:NSUTF8StringEncoding];
+                    if ([text stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]].length) {
+                        id record = [NSJSONSerialization JSONObjectWithData:field options:0 error:nil];
+                        if (![record isKindOfClass:[NSDictionary class]]) {
+                            errorMessage = [NSString stringWithFormat:@"Line %llu of '%@' is not a JSON object.", line, filePath];
+                            stop = YES;
+                        } else {
+                            stop = ![import addRecord:record];
+                        }
+                    }
+                    field.length = 0;
+                    continue;
+                    
+                }
+                
+                if (inQuotes) {
+                    if (pendingQuote) {
+                        pendingQuote = NO;
+                        if (c == '"') {
+                            [field appendBytes:&c length:1];
+                            continue;
+                        }
+                        inQuotes = NO;
+                    } else {
+                        if (c == '"') {
+                            pendingQuote = YES;
+                        } else {
+                            [field appendBytes:&c length:1];
+                        }
+                        continue;
+                    }
+                }
+                
+                if (c == '"' && !field.length && !quoted) {
+                    inQuotes = YES;
+                    quoted = YES;
+                } else if (c == ',' || c == '\n') {
+                    
+                    NSString* value = [[NSString alloc] initWithData:field encoding:NSUTF8StringEncoding];
+                    [fields addObject:(value && (value.length || quoted)) ? value : [NSNull null]];
+                    field.length = 0;
+                    quoted = NO;
+                    
+                    if (c == '\n') {
+                        
+                        if (!header) {
+                            /* drop the byte order mark that some tools write at the start */
+                            NSString* first = fields.firstObject;
+                            if ([first isKindOfClass:[NSString class]] && first.length && [first characterAtIndex:0] == 0xFEFF) {
+                                [fields replaceObjectAtIndex:0 withObject:[first substringFromIndex:1]];
+                            }
+                            header = [fields copy];
+                        } else if (fields.count > 1 || ![fields.firstObject isKindOfClass:[NSNull class]]) {
+                            NSMutableDictionary* record = [NSMutableDictionary new];
+                            for (NSUInteger f = 0; f < MIN(header.count, fields.count); f++) {
+                                if ([[header objectAtIndex:f] isKindOfClass:[NSString class]]) {
+                                    [record setObject:[fields objectAtIndex:f] forKey:[header objectAtIndex:f]];
+                                }
+                            }
+                            stop = ![import addRecord:record];
+                        }
+                        [fields removeAllObjects];
+                        
+                    }
+                    
+                } else if (c != '\r') {
+                    [field appendBytes:&c length:1];
+                }
+                
+            }
+            
+            if (endOfFile) {
+                stop = YES;
+            }
+            
+        }
+        
+    }
+    
+    [stream close];
+    [import finish];
+    
+    if (errorMessage && [[SRKGlobals sharedObject] delegate] && [[[SRKGlobals sharedObject] delegate] respondsToSelector:@selector(databaseError:)]) {
+        SRKError* e = [SRKError new];
+        e.errorMessage = errorMessage;
+        [[[SRKGlobals sharedObject] delegate] databaseError:e];
+    }
+    
+    return import.imported;
+    
 }
 
 // TODO:  Do the Group By method here in SQL as well.  For now its done in SRKQuery
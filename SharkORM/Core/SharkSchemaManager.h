@@ -38,6 +38,8 @@ typedef enum : NSUInteger {
 @property (strong) NSString* pk;
 @property (strong) NSMutableDictionary<NSString*, NSNumber*>* fields;
 @property (strong) NSMutableDictionary<NSString*, NSString*>* indexes;
+@property (strong) NSArray<NSString*>* clusteredKey;
+@property BOOL clustered;
 
 @end
 
@@ -60,6 +62,9 @@ typedef enum : NSUInteger {
 - (int)schemaPropertyType:(NSString*)entity property:(NSString*)property;
 - (void)schemaAddIndexDefinitionForEntity:(NSString*)entity name:(NSString*)name definition:(NSString*)definition;
 - (NSDictionary<NSString*, NSString*>*)schemaIndexDefinitionsForEntity:(NSString*)entity;
+- (BOOL)schemaEntityHasVirtualIndexes:(NSString*)entity;
+- (void)schemaSetEntity:(NSString*)entity clusteredKey:(NSArray<NSString*>*)key;
+- (NSArray<NSString*>*)schemaClusteredKeyForEntity:(NSString*)entity;
 
 - (void)schemaUpdateMissingDatabaseEntries:(NSString*)database;
 - (BOOL)databasePropertyExistsInEntity:(NSString*)entity property:(NSString*)property;
@@ -70,6 +75,8 @@ typedef enum : NSUInteger {
 - (NSArray<NSString*>*)databaseTables:(NSString*)database;
 - (NSString*)databasePrimaryKeyForEntity:(NSString*)entity;
 - (int)databasePrimaryKeyTypeForEntity:(NSString*)entity;
+- (void)databaseSetEntity:(NSString*)entity clustered:(BOOL)clustered;
+- (BOOL)databaseEntityIsClustered:(NSString*)entity;
 
 - (void)databaseAddIndexDefinitionForEntity:(NSString*)entity name:(NSString*)name definition:(NSString*)definition;
 - (NSDictionary<NSString*,NSString*>*)databaseIndexDefinitionsForEntity:(NSString*)entity;
@@ -77,5 +84,6 @@ typedef enum : NSUInteger {
 - (void)reloadDatabaseSchemaForDatabase:(NSString*)database;
 - (void)refactorDatabase:(NSString*)database entity:(NSString*)entity;
 - (void)refactorDatabase:(NSString*)database;
+- (void)reportError:(NSString*)errorMessage sql:(NSString*)sql;
 
 @end
@@ -236,6 +236,38 @@ static SharkSchemaManager* this;
     
 }
 
+- (BOOL)schemaEntityHasVirtualIndexes:(NSString*)entity {
+    
+    for (NSString* definition in [self schemaIndexDefinitionsForEntity:entity].allValues) {
+        if ([definition rangeOfString:@"CREATE VIRTUAL TABLE"].location != NSNotFound) {
+            return YES;
+        }
+    }
+    return NO;
+    
+}
+
+- (void)schemaSetEntity:(NSString*)entity clusteredKey:(NSArray<NSString*>*)key {
+    
+    SharkSchemaStruct* schema = schemas[entity];
+    if (schema == nil) {
+        schema = [SharkSchemaStruct new];
+        schema.entity = entity;
+        schemas[entity] = schema;
+    }
+    schema.clusteredKey = key.count ? key : nil;
+    
+}
+
+- (NSArray<NSString*>*)schemaClusteredKeyForEntity:(NSString*)entity {
+    
+    if (schemas[entity] != nil) {
+        return schemas[entity].clusteredKey;
+    }
+    return nil;
+    
+}
+
 - (void)schemaUpdateMissingDatabaseEntries:(NSString*)database {
     
     if (!database) {
@@ -359,6 +391,28 @@ static SharkSchemaManager* this;
     return 0;
 }
 
+- (void)databaseSetEntity:(NSString*)entity clustered:(BOOL)clustered {
+    
+    SharkSchemaStruct* schema = databases[entity];
+    if (schema == nil) {
+        schema = [SharkSchemaStruct new];
+        schema.entity = entity;
+        databases[entity] = schema;
+    }
+    
+    schema.clustered = clustered;
+    
+}
+
+- (BOOL)databaseEntityIsClustered:(NSString*)entity {
+    
+    if (databases[entity] != nil) {
+        return databases[entity].clustered;
+    }
+    return NO;
+    
+}
+
 - (void)databaseAddIndexDefinitionForEntity:(NSString*)entity name:(NSString*)name definition:(NSString*)definition {
     
     SharkSchemaStruct* schema = databases[entity];
@@ -385,7 +439,7 @@ static SharkSchemaManager* this;
     
     sqlite3* handle = [[SRKGlobals sharedObject] handleForName:database];
     sqlite3_stmt* tableNames;
-    const char* tableSQL = "SELECT name FROM sqlite_master WHERE type='table';\0";
+    const char* tableSQL = "SELECT name, sql FROM sqlite_master WHERE type='table';\0";
     if (sqlite3_prepare_v2(handle, tableSQL, (int)strlen(tableSQL), &tableNames, nil) == SQLITE_OK) {
         while (sqlite3_step(tableNames) == SQLITE_ROW) {
             
@@ -395,6 +449,9 @@ static SharkSchemaManager* this;
             
             [[SharkSchemaManager shared] databaseSetEntity:table database:database];
             
+            const char* tableDefinition = (const char*)sqlite3_column_text(tableNames, 1);
+            [[SharkSchemaManager shared] databaseSetEntity:table clustered:(tableDefinition && [[NSString stringWithUTF8String:tableDefinition].uppercaseString rangeOfString:@"WITHOUT ROWID"].location != NSNotFound)];
+            
             if (sqlite3_prepare_v2(handle, columnSQL.UTF8String, (int)columnSQL.length, &columnNames, nil) == SQLITE_OK) {
                 while (sqlite3_step(columnNames) ==  SQLITE_ROW) {
                     
@@ -430,6 +487,26 @@ static SharkSchemaManager* this;
             
             sqlite3_finalize(indexNames);
             
+            // virtual table indexes (spatial & full text) are kept in step by triggers on the entity table, the insert trigger is named after the virtual table so use that to identify them.
+            // Only our own naming scheme is matched, and the virtual table has to exist, so that triggers the developer has created are never mistaken for one of ours and dropped.
+            sqlite3_stmt* triggerNames;
+            NSString* escapedTable = [[table stringByReplacingOccurrencesOfString:@"\\" withString:@"\\\\"] stringByReplacingOccurrencesOfString:@"_" withString:@"\\_"];
+            NSString* fullTextName = [NSString stringWithFormat:SRK_FTS_INDEX_NAME_FORMAT, table];
+            NSString* triggerSQL = [NSString stringWithFormat:@"SELECT name,sql FROM sqlite_master WHERE tbl_name = '%@' AND type = 'trigger' AND (name = '%@_ai' OR name LIKE '%@\\_rtree\\_%%\\_ai' ESCAPE '\\') AND substr(name, 1, length(name) - 3) IN (SELECT name FROM sqlite_master WHERE type = 'table' AND sql LIKE 'CREATE VIRTUAL TABLE%%');", table, fullTextName, escapedTable];
+            
+            if (sqlite3_prepare_v2(handle, triggerSQL.UTF8String, (int)triggerSQL.length, &triggerNames, nil) == SQLITE_OK) {
+                while (sqlite3_step(triggerNames) ==  SQLITE_ROW) {
+                    
+                    NSString* name = [NSString stringWithUTF8String:(const char*)sqlite3_column_text(triggerNames, 0)];
+                    NSString* sql = [NSString stringWithUTF8String:(const char*)sqlite3_column_text(triggerNames, 1)];
+                    
+                    [SharkSchemaManager.shared databaseAddIndexDefinitionForEntity:table name:[name substringToIndex:name.length - 3] definition:sql];
+                    
+                }
+            }
+            
+            sqlite3_finalize(triggerNames);
+            
         }
     }
 }
@@ -564,6 +641,57 @@ static SharkSchemaManager* this;
     return 0;
 }
 
+- (void)createTableForEntity:(NSString*)entity inDatabase:(NSString*)database {
+    
+    NSArray<NSString*>* clusteredKey = [self schemaClusteredKeyForEntity:entity];
+    
+    if (clusteredKey) {
+        
+        /* a WITHOUT ROWID table stores the rows in the primary key's own b-tree, the key columns have to be declared up front so the whole table is created in one go */
+        NSMutableArray* columns = [NSMutableArray arrayWithObject:@"Id TEXT NOT NULL"];
+        for (NSString* f in [self schemaPropertiesForEntity:entity]) {
+            if (![f isEqualToString:SRK_DEFAULT_PRIMARY_KEY_NAME]) {
+                [columns addObject:[NSString stringWithFormat:@"%@ %@", f, [self sqlTextTypeFromColumnType:[self entityTypeToSQLSotrageType:[self schemaPropertyType:entity property:f]]]]];
+            }
+        }
+        [columns addObject:[NSString stringWithFormat:@"PRIMARY KEY (%@)", [clusteredKey componentsJoinedByString:@","]]];
+        
+        [SharkORM executeSQL:[NSString stringWithFormat:@"CREATE TABLE IF NOT EXISTS %@ (%@) WITHOUT ROWID;", entity, [columns componentsJoinedByString:@", "]] inDatabase:database];
+        [self databaseSetEntity:entity clustered:YES];
+        return;
+        
+    }
+    
+    // completely new table, so we can do this in a single operation
+    NSString* sql = @"CREATE TABLE IF NOT EXISTS ";
+    sql = [sql stringByAppendingString:entity];
+    sql = [sql stringByAppendingString:@" (Id "];
+    if ([self schemaPrimaryKeyTypeForEntity:entity] == SRK_PROPERTY_TYPE_NUMBER) {
+        sql = [sql stringByAppendingString:@"INTEGER PRIMARY KEY AUTOINCREMENT);"];
+    } else {
+        sql = [sql stringByAppendingString:@"TEXT PRIMARY KEY);"];
+    }
+    
+    [SharkORM executeSQL:sql inDatabase:database];
+    
+    // now add the columns in one-by-one
+    for (NSString* f in [self schemaPropertiesForEntity:entity]) {
+        if ([f isEqualToString:SRK_DEFAULT_PRIMARY_KEY_NAME]) {
+            continue;
+        }
+        sql = @"ALTER TABLE ";
+        sql = [sql stringByAppendingString:entity];
+        sql = [sql stringByAppendingString:@" ADD COLUMN "];
+        sql = [sql stringByAppendingString:f];
+        sql = [sql stringByAppendingString:@" "];
+        sql = [sql stringByAppendingString:[self sqlTextTypeFromColumnType:[self entityTypeToSQLSotrageType:[self schemaPropertyType:entity property:f]]]];
+        [SharkORM executeSQL:sql inDatabase:database];
+    }
+    
+    [self databaseSetEntity:entity clustered:NO];
+    
+}
+
 - (void)refactorDatabase:(NSString*)database entity:(NSString*)entity {
     
     if (!database || [database isEqualToString:@""]) {
@@ -585,28 +713,8 @@ static SharkSchemaManager* this;
     // check to see if this table already exists
     if (databases[entity] == nil) {
         
-        // completely new table, so we can do this in a single operation
-        NSString* sql = @"CREATE TABLE IF NOT EXISTS ";
-        sql = [sql stringByAppendingString:entity];
-        sql = [sql stringByAppendingString:@" (Id "];
-        if ([self schemaPrimaryKeyTypeForEntity:entity] == SRK_PROPERTY_TYPE_NUMBER) {
-            sql = [sql stringByAppendingString:@"INTEGER PRIMARY KEY AUTOINCREMENT);"];
-        } else {
-            sql = [sql stringByAppendingString:@"TEXT PRIMARY KEY);"];
-        }
-        
-        [SharkORM executeSQL:sql inDatabase:database];
-        
-        // now add the columns in one-by-one
-        for (NSString* f in [self schemaPropertiesForEntity:entity]) {
-            sql = @"ALTER TABLE ";
-            sql = [sql stringByAppendingString:entity];
-            sql = [sql stringByAppendingString:@" ADD COLUMN "];
-            sql = [sql stringByAppendingString:f];
-            sql = [sql stringByAppendingString:@" "];
-            sql = [sql stringByAppendingString:[self sqlTextTypeFromColumnType:[self entityTypeToSQLSotrageType:[self schemaPropertyType:entity property:f]]]];
-            [SharkORM executeSQL:sql inDatabase:database];
-        }
+        // completely new table
+        [self createTableForEntity:entity inDatabase:database];
         
     } else {
         
@@ -647,42 +755,69 @@ static SharkSchemaManager* this;
             }
         }
         
-        if (foundDefuncColumns) {
+        // switching to or from clustered storage means the table has to be rebuilt
+        BOOL clusteringChanged = ([self schemaClusteredKeyForEntity:entity] != nil) != [self databaseEntityIsClustered:entity];
+        
+        if (foundDefuncColumns || clusteringChanged) {
             
-            // rename the old table
-            [SharkORM executeSQL:[NSString stringWithFormat:@"ALTER TABLE %@ RENAME TO temp_%@;", entity, entity] inDatabase:database];
+            /* the whole rebuild is done within a savepoint, so a failure at any step puts the original table back as it was rather than leaving temp_ behind */
+            BOOL wasClustered = [self databaseEntityIsClustered:entity];
+            NSString* errorMessage = nil;
+            NSString* failedSQL = nil;
+            [SharkORM executeSQL:@"SAVEPOINT srk_refactor;" inDatabase:database];
             
-            // completely new table, so we can do this in a single operation
-            NSString* sql = @"CREATE TABLE IF NOT EXISTS ";
-            sql = [sql stringByAppendingString:entity];
-            sql = [sql stringByAppendingString:@" (Id "];
-            if ([self schemaPrimaryKeyTypeForEntity:entity] == SRK_PROPERTY_TYPE_NUMBER) {
-                sql = [sql stringByAppendingString:@"INTEGER PRIMARY KEY AUTOINCREMENT);"];
-            } else {
-                sql = [sql stringByAppendingString:@"TEXT PRIMARY KEY);"];
+            // rename the old table
+            NSString* renameSQL = [NSString stringWithFormat:@"ALTER TABLE %@ RENAME TO temp_%@;", entity, entity];
+            if (![SharkORM executeSQL:renameSQL inDatabase:database errorMessage:&errorMessage]) {
+                failedSQL = renameSQL;
             }
             
-            [SharkORM executeSQL:sql inDatabase:database];
-            
-            // now add the columns in one-by-one
-            for (NSString* f in [self schemaPropertiesForEntity:entity]) {
-                sql = @"ALTER TABLE ";
-                sql = [sql stringByAppendingString:entity];
-                sql = [sql stringByAppendingString:@" ADD COLUMN "];
-                sql = [sql stringByAppendingString:f];
-                sql = [sql stringByAppendingString:@" "];
-                sql = [sql stringByAppendingString:[self sqlTextTypeFromColumnType:[self entityTypeToSQLSotrageType:[self schemaPropertyType:entity property:f]]]];
-                [SharkORM executeSQL:sql inDatabase:database];
+            if (!failedSQL) {
+                
+                // completely new table
+                [self createTableForEntity:entity inDatabase:database];
+                
+                // copy the data from the temp database, only the columns the old table actually had
+                NSMutableArray* columns = [NSMutableArray new];
+                for (NSString* f in [self schemaPropertiesForEntity:entity]) {
+                    if ([self databasePropertyExistsInEntity:entity property:f]) {
+                        [columns addObject:f];
+                    }
+                }
+                NSString* copySQL = [NSString stringWithFormat:@"INSERT INTO %@ (%@) SELECT %@ FROM temp_%@;", entity, [columns componentsJoinedByString:@","], [columns componentsJoinedByString:@","], entity];
+                if (![SharkORM executeSQL:copySQL inDatabase:database errorMessage:&errorMessage]) {
+                    // the existing rows do not fit the new table (e.g. a NULL or duplicate natural key)
+                    failedSQL = copySQL;
+                }
+                
             }
             
-            // copy the data from the temp database
-            [SharkORM executeSQL:[NSString stringWithFormat:@"INSERT INTO %@ (%@) SELECT %@ FROM temp_%@;", entity, [[self schemaPropertiesForEntity:entity] componentsJoinedByString:@","], [[self schemaPropertiesForEntity:entity] componentsJoinedByString:@","], entity] inDatabase:database];
-            
-            // drop the temp table
-            [SharkORM executeSQL:[NSString stringWithFormat:@"DROP TABLE temp_%@;", entity] inDatabase:database];
+            if (!failedSQL) {
+                
+                // drop the temp table
+                NSString* dropSQL = [NSString stringWithFormat:@"DROP TABLE temp_%@;", entity];
+                if (![SharkORM executeSQL:dropSQL inDatabase:database errorMessage:&errorMessage]) {
+                    failedSQL = dropSQL;
+                }
+                
+            }
             
-            // clear out the indexes as they are no longer on this new table
-            databases[entity].indexes = [NSMutableDictionary new];
+            if (!failedSQL) {
+                
+                [SharkORM executeSQL:@"RELEASE srk_refactor;" inDatabase:database];
+                
+                // clear out the indexes as they are no longer on this new table
+                databases[entity].indexes = [NSMutableDictionary new];
+                
+            } else {
+                
+                // the original table is kept rather than losing its rows, and the storage it is recorded as having goes back with it
+                [SharkORM executeSQL:@"ROLLBACK TO srk_refactor;" inDatabase:database];
+                [SharkORM executeSQL:@"RELEASE srk_refactor;" inDatabase:database];
+                [self databaseSetEntity:entity clustered:wasClustered];
+                [self reportError:errorMessage sql:failedSQL];
+                
+            }
             
         }
         
@@ -691,9 +826,18 @@ static SharkSchemaManager* this;
     // now create and remove indexes on the tables
     NSDictionary<NSString*, NSString*>* idx = [self schemaIndexDefinitionsForEntity:entity];
     for (NSString* i in idx.allKeys) {
-        if ([self databaseIndexDefinitionsForEntity:entity][i] == nil) {
+        NSString* existing = [self databaseIndexDefinitionsForEntity:entity][i];
+        if (existing == nil) {
             // missing index, create it now
-            [SharkORM executeSQL:idx[i] inDatabase:database];
+            [self createIndex:idx[i] inDatabase:database];
+        } else if ([idx[i] rangeOfString:existing].location == NSNotFound) {
+            // same name but the definition has changed (e.g. a new WHERE clause, or different full text columns), so swap it out
+            if ([existing hasPrefix:@"CREATE TRIGGER"]) {
+                [SharkORM executeSQL:[NSString stringWithFormat:SRK_VIRTUAL_INDEX_DROP_FORMAT, i] inDatabase:database];
+            } else {
+                [SharkORM executeSQL:[NSString stringWithFormat:@"DROP INDEX IF EXISTS %@;", i] inDatabase:database];
+            }
+            [self createIndex:idx[i] inDatabase:database];
         }
     }
     
@@ -701,13 +845,38 @@ static SharkSchemaManager* this;
     idx = [self databaseIndexDefinitionsForEntity:entity];
     for (NSString* i in idx.allKeys) {
         if ([self schemaIndexDefinitionsForEntity:entity][i] == nil) {
-            // missing index, create it now
-            [SharkORM executeSQL:[NSString stringWithFormat:@"DROP INDEX IF EXISTS %@;", i] inDatabase:database];
+            if ([idx[i] hasPrefix:@"CREATE TRIGGER"]) {
+                // virtual table index, remove the triggers which maintain it and then the table itself
+                [SharkORM executeSQL:[NSString stringWithFormat:SRK_VIRTUAL_INDEX_DROP_FORMAT, i] inDatabase:database];
+            } else {
+                [SharkORM executeSQL:[NSString stringWithFormat:@"DROP INDEX IF EXISTS %@;", i] inDatabase:database];
+            }
         }
     }
     
 }
 
+- (void)reportError:(NSString*)errorMessage sql:(NSString*)sql {
+    
+    if ([[SRKGlobals sharedObject] delegate] && [[[SRKGlobals sharedObject] delegate] respondsToSelector:@selector(databaseError:)]) {
+        SRKError* e = [SRKError new];
+        e.sqlQuery = sql;
+        e.errorMessage = errorMessage;
+        [[[SRKGlobals sharedObject] delegate] databaseError:e];
+    }
+    
+}
+
+- (void)createIndex:(NSString*)definition inDatabase:(NSString*)database {
+    
+    // a unique index can not be created over rows which already hold duplicate values, and without it the uniqueness is not enforced at all, so the developer needs to know
+    NSString* errorMessage = nil;
+    if (![SharkORM executeSQL:definition inDatabase:database errorMessage:&errorMessage]) {
+        [self reportError:errorMessage sql:definition];
+    }
+    
+}
+
 - (void)refactorDatabase:(NSString*)database {
     
     /*
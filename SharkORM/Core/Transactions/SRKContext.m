@@ -26,10 +26,31 @@
 #import "SRKEntity+Private.h"
 #import "SharkORM+Private.h"
 #import "SRKEntityChain.h"
+#import "SRKCommitPlanner.h"
+#import "SRKTransaction+Private.h"
+
+@interface SRKContextSummary ()
+
+@property (nonatomic, strong, readwrite) NSArray<SRKEntity*>* inserted;
+@property (nonatomic, strong, readwrite) NSArray<SRKEntity*>* updated;
+@property (nonatomic, strong, readwrite) NSArray<SRKEntity*>* removed;
+@property (nonatomic, readwrite) NSUInteger unchanged;
+
+@end
+
+@implementation SRKContextSummary
+
+- (NSUInteger)changes {
+    return self.inserted.count + self.updated.count + self.removed.count;
+}
+
+@end
 
 @interface SRKContext ()
 
 @property (nonatomic, strong)   NSMutableArray* entities;
+@property (nonatomic, strong)   NSHashTable* members;
+@property (nonatomic, strong, readwrite, nullable) SRKContextSummary* lastCommitSummary;
 
 @end
 
@@ -39,47 +60,116 @@
 	self = [super init];
 	if (self) {
 		self.entities = [NSMutableArray new];
+		self.members = [[NSHashTable alloc] initWithOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality capacity:0];
 	}
 	return self;
 }
 
 - (void)addEntityToContext:(SRKEntity*)entity {
-	[self.entities addObject:entity];
+	if (![self.members containsObject:entity]) {
+		[self.entities addObject:entity];
+		[self.members addObject:entity];
+	}
 	entity.context = self;
 }
 
 - (void)removeEntityFromContext:(SRKEntity*)entity {
-	[self.entities removeObject:entity];
+	if ([self.members containsObject:entity]) {
+		[self.entities removeObjectIdenticalTo:entity];
+		[self.members removeObject:entity];
+	}
 	entity.context = nil;
 }
 
 - (BOOL)isEntityInContext:(SRKEntity*)entity {
-	return [self.entities containsObject:entity];
+	return [self.members containsObject:entity];
+}
+
+- (BOOL)entityHasChanges:(SRKEntity*)entity {
+	
+	if (!entity.exists || entity.dirty || !entity.Id) {
+		return YES;
+	}
+	
+	/* a clean object can still be holding a new or changed related object, which would be written along with it */
+	for (SRKEntity* o in entity.embeddedEntities.allValues) {
+		if ([o isKindOfClass:[SRKEntity class]] && !o.sterilised && (!o.Id || o.dirty)) {
+			return YES;
+		}
+	}
+	
+	return NO;
+	
 }
 
 - (BOOL)commit {
 	
-	/* commit all the objects within a transaction */
+	/* only the objects which have changed are written, the rest of the context is left alone */
+	
+	NSMutableArray* changed = [NSMutableArray new];
+	NSMutableDictionary* removals = [NSMutableDictionary new];
+	NSUInteger unchanged = 0;
+	
+	for (SRKEntity* ob in self.entities) {
+		if (ob.isMarkedForDeletion) {
+			// grouped by class, so each table's deletes run one after another
+			NSString* entityName = [ob.class description];
+			NSMutableArray* group = [removals objectForKey:entityName];
+			if (!group) {
+				group = [NSMutableArray new];
+				[removals setObject:group forKey:entityName];
+			}
+			[group addObject:ob];
+		} else if ([self entityHasChanges:ob]) {
+			[changed addObject:ob];
+		} else {
+			unchanged++;
+		}
+	}
 	
 	__block BOOL success = YES;
-    
-    [SRKTransaction transaction:^{
-        
-        for (SRKEntity* ob in self.entities) {
-            
-            if (ob.isMarkedForDeletion) {
-                [ob __removeRaw];
-            } else {
-                [ob __commitRawWithObjectChain:[SRKEntityChain new]];
-            }
-        }
-        
-    } withRollback:^{
-        
-        success = NO;
-        
-    }];
+	__block SRKCommitPlanner* planner = nil;
+	NSMutableArray* removed = [NSMutableArray new];
+	
+	/* commit all the objects within a transaction */
+	
+	[SRKTransaction transaction:^{
+		
+		// inserts and updates are written in dependency order, grouped by class and column set so the cached statements are reused
+		if (changed.count) {
+			planner = [[SRKCommitPlanner alloc] initWithEntities:changed];
+			if (![planner execute]) {
+				// an object in the graph could not be written, so nothing in the context is
+				[SRKTransaction failTransactionWithCode:SRKTransactionFailed];
+				return;
+			}
+		}
+		
+		for (NSString* entityName in [removals.allKeys sortedArrayUsingSelector:@selector(compare:)]) {
+			for (SRKEntity* ob in [removals objectForKey:entityName]) {
+				if ([ob __removeRaw]) {
+					[removed addObject:ob];
+				}
+			}
+		}
+		
+	} withRollback:^{
 		
+		success = NO;
+		
+	}];
+	
+	if (success) {
+		SRKContextSummary* summary = [SRKContextSummary new];
+		summary.inserted = planner ? planner.insertedEntities : @[];
+		summary.updated = planner ? planner.updatedEntities : @[];
+		summary.removed = removed;
+		summary.unchanged = unchanged;
+		self.lastCommitSummary = summary;
+	} else {
+		self.lastCommitSummary = nil;
+	}
+	
 	return success;
 	
 }
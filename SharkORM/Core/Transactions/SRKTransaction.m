@@ -27,191 +27,451 @@
 #import "SRKEntity+Private.h"
 #import "SRKRegistry.h"
 #import "SRKGlobals.h"
+#import "SRKTransactionInfo.h"
 
-static id                       transactionSemaphore;
-static BOOL                     transactionInProgress;
-static SRKTransactionStates     transactionResult;
-static NSMutableArray*          transactionReferencedObjects;
-static NSMutableArray*          transactionReferencedDatabases;
-static NSThread*                transactionThread;
+/* the state of a transaction belongs to the thread running it, so transactions on different threads never see each others objects or savepoints */
+@interface SRKTransactionState : NSObject
+
+@property SRKTransactionStates          result;
+@property SRKTransactionRollbackMode    rollbackMode;
+@property (strong) NSMutableOrderedSet* referencedObjects;
+@property (strong) NSHashTable*         weakReferencedObjects;
+@property (strong) NSMutableOrderedSet* referencedDatabases;
+@property (strong) NSMutableArray*      savepoints;
+
+@end
+
+@implementation SRKTransactionState
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        self.result = SRKTransactionPassed;
+        self.referencedObjects = [NSMutableOrderedSet new];
+        self.weakReferencedObjects = [NSHashTable weakObjectsHashTable];
+        self.referencedDatabases = [NSMutableOrderedSet new];
+        self.savepoints = [NSMutableArray new];
+    }
+    return self;
+}
+
+@end
+
+#define transactionStateKey @"SRKTransactionState"
+
+/* which thread currently has a transaction open on each database, a database is only ever locked by one transaction at a time */
+static NSMutableDictionary*     transactionOwners;
+static NSCondition*             transactionCondition;
 
 #define startTransactionStatement @"BEGIN TRANSACTION"
 #define commitTransactionStatement @"COMMIT"
 #define rollbackTransactionStatement @"ROLLBACK"
+#define savepointStatement @"SAVEPOINT %@"
+#define releaseSavepointStatement @"RELEASE %@"
+#define rollbackToSavepointStatement @"ROLLBACK TO %@"
+
+static SRKTransactionState* currentTransactionState() {
+    return [[[NSThread currentThread] threadDictionary] objectForKey:transactionStateKey];
+}
+
+/* the writer handle is shared by every thread, so the transaction statements run under the database's write lock like the batched writes, otherwise one could land in the middle of another thread's BEGIN IMMEDIATE ... COMMIT */
+static BOOL executeTransactionStatement(NSString* sql, NSString* database) {
+    @synchronized([[SRKGlobals sharedObject] writeLockObjectForDatabase:database]) {
+        return [SharkORM executeSQL:sql inDatabase:database errorMessage:nil];
+    }
+}
 
 // C-Style transaction status macro
 void SRKFailTransaction() {
-    transactionResult = SRKTransactionFailed;
+    currentTransactionState().result = SRKTransactionFailed;
 }
 
 @implementation SRKTransaction
 
 + (void)initialize {
-    transactionSemaphore = [NSObject new];
-    transactionInProgress = NO;
-    transactionReferencedObjects = [NSMutableArray new];
-    transactionReferencedDatabases = [NSMutableArray new];
+    transactionOwners = [NSMutableDictionary new];
+    transactionCondition = [NSCondition new];
 }
 
-+ (void)blockUntilTransactionFinished {
-    if (transactionThread) {
-        BOOL isMyTransaction = false;
-        @synchronized (transactionThread) {
-            isMyTransaction = (transactionThread == [NSThread currentThread]);
-        }
-        if (!isMyTransaction) {
-            // wait here, until the transaction is complete.
-            @synchronized (transactionSemaphore) {
-            }
-        }
++ (void)blockUntilTransactionFinishedForDatabase:(NSString *)database {
+    
+    // a thread within its own transaction takes the lock on the database when it first uses it, see startTransactionForDatabaseConnection:
+    if (!database || currentTransactionState()) {
+        return;
+    }
+    
+    // wait here, until any transaction on this database is complete.  Transactions on other databases do not hold us up.
+    [transactionCondition lock];
+    while ([transactionOwners objectForKey:database]) {
+        [transactionCondition wait];
+    }
+    [transactionCondition unlock];
+    
+}
+
++ (void)blockUntilTransactionFinishedForEntities:(NSArray *)entities {
+    
+    if (currentTransactionState()) {
+        return;
+    }
+    
+    NSMutableSet* classes = [NSMutableSet new];
+    for (SRKEntity* entity in entities) {
+        [classes addObject:entity.class];
+    }
+    
+    NSMutableSet* databases = [NSMutableSet new];
+    for (Class entityClass in classes) {
+        [databases addObject:[SharkORM databaseNameForClass:entityClass]];
+    }
+    
+    for (NSString* database in databases) {
+        [SRKTransaction blockUntilTransactionFinishedForDatabase:database];
     }
+    
 }
 
 + (BOOL)transactionIsInProgress {
-    return transactionInProgress;
+    return currentTransactionState() != nil;
 }
 
 + (BOOL)transactionIsInProgressForThisThread {
-    if (transactionInProgress) {
-        BOOL isMyTransaction = false;
-        @synchronized (transactionThread) {
-            isMyTransaction = (transactionThread == [NSThread currentThread]);
+    return currentTransactionState() != nil;
+}
+
++ (void)addReferencedObjectToTransactionList:(id)referencedObject {
+    SRKTransactionState* state = currentTransactionState();
+    if (state.rollbackMode == SRKTransactionRollbackDatabaseOnly) {
+        // only an undone insert is reflected back into the object, so there is no reason to keep it alive for the transaction
+        [state.weakReferencedObjects addObject:referencedObject];
+    } else {
+        [state.referencedObjects addObject:referencedObject];
+    }
+}
+
++ (NSArray*)referencedObjects {
+    SRKTransactionState* state = currentTransactionState();
+    NSMutableArray* objects = [NSMutableArray arrayWithArray:state.referencedObjects.array];
+    [objects addObjectsFromArray:state.weakReferencedObjects.allObjects];
+    return objects;
+}
+
++ (BOOL)startTransactionForDatabaseConnection:(NSString *)database {
+    
+    SRKTransactionState* state = currentTransactionState();
+    if (!state || [state.referencedDatabases containsObject:database]) {
+        return YES;
+    }
+    
+    [transactionCondition lock];
+    
+    /* whilst we already hold other databases, another transaction could be waiting on one of those for the database we want.  So we only wait for as long as a busy database would, then give up rather than deadlock */
+    NSDate* deadline = state.referencedDatabases.count ? [NSDate dateWithTimeIntervalSinceNow:[SharkORM getSettings].busyTimeout] : nil;
+    while ([transactionOwners objectForKey:database]) {
+        if (deadline) {
+            if (![transactionCondition waitUntilDate:deadline] && [transactionOwners objectForKey:database]) {
+                [transactionCondition unlock];
+                state.result = SRKTransactionFailed;
+                return NO;
+            }
+        } else {
+            [transactionCondition wait];
+        }
+    }
+    [transactionOwners setObject:[NSThread currentThread] forKey:database];
+    
+    [transactionCondition unlock];
+    
+    @synchronized([[SRKGlobals sharedObject] writeLockObjectForDatabase:database]) {
+        
+        if (!executeTransactionStatement(startTransactionStatement, database)) {
+            
+            // the handle already has a transaction open, so nothing written here could be committed or rolled back on its own.  The database is handed straight back.
+            [transactionCondition lock];
+            [transactionOwners removeObjectForKey:database];
+            [transactionCondition broadcast];
+            [transactionCondition unlock];
+            
+            state.result = SRKTransactionFailed;
+            return NO;
+            
         }
-        if (isMyTransaction) {
-            return YES;
+        
+        [state.referencedDatabases addObject:database];
+        
+        // a database joining part way through a nested transaction needs the savepoints that are already open on the others
+        for (NSString* savepoint in state.savepoints) {
+            executeTransactionStatement([NSString stringWithFormat:savepointStatement, savepoint], database);
         }
+        
     }
-    return NO;
+    
+    return YES;
+    
 }
 
-+ (void)addReferencedObjectToTransactionList:(id)referencedObject {
-    [transactionReferencedObjects addObject:referencedObject];
++ (BOOL)entityRequiresRestorePoint:(SRKEntity*)entity {
+    // an entity needs a new restore point if it has none, or if the one it has belongs to an outer savepoint
+    return (!entity.transactionInfo || entity.transactionInfo.savepointDepth < (int)currentTransactionState().savepoints.count);
 }
 
-+ (void)startTransactionForDatabaseConnection:(NSString *)database {
-    if ([[transactionReferencedDatabases componentsJoinedByString:@"|"] rangeOfString:database].location == NSNotFound) {
-        [transactionReferencedDatabases addObject:database];
-        [SharkORM executeSQL:startTransactionStatement inDatabase:database];
++ (SRKTransactionInfo*)createRestorePointForEntity:(SRKEntity*)entity {
+    
+    SRKTransactionState* state = currentTransactionState();
+    SRKTransactionInfo* info = [SRKTransactionInfo new];
+    info.originalExists = entity.exists;
+    info.originalPk = entity.reflectedPrimaryKeyValue;
+    if (state.rollbackMode == SRKTransactionRollbackObjects) {
+        [info copyObjectValuesIntoRestorePoint:entity];
     }
+    info.savepointDepth = (int)state.savepoints.count;
+    info.previousInfo = entity.transactionInfo;
+    if (info.previousInfo) {
+        info.eventType = info.previousInfo.eventType;
+    }
+    entity.transactionInfo = info;
+    
+    return info;
+    
+}
+
+/* undoes everything written within the savepoint, in the database and in the objects, leaving the enclosing transaction as it was when the savepoint was opened */
+static void rollbackToSavepoint(SRKTransactionState* state, NSString* savepoint, int depth) {
+    
+    for (NSString* database in state.referencedDatabases) {
+        executeTransactionStatement([NSString stringWithFormat:rollbackToSavepointStatement, savepoint], database);
+        executeTransactionStatement([NSString stringWithFormat:releaseSavepointStatement, savepoint], database);
+    }
+    
+    // put back every object touched within the savepoint, to the state it was in when the savepoint was opened
+    for (SRKEntity* o in [SRKTransaction referencedObjects].reverseObjectEnumerator) {
+        if (o.transactionInfo.savepointDepth == depth) {
+            [o.transactionInfo restoreValuesIntoObject:o];
+            o.transactionInfo = o.transactionInfo.previousInfo;
+            if (!o.transactionInfo) {
+                // first referenced within the savepoint, so it plays no further part in the transaction
+                [state.referencedObjects removeObject:o];
+                [state.weakReferencedObjects removeObject:o];
+            }
+        }
+    }
+    
+}
+
++ (void)nestedTransaction:(SRKTransactionBlockBlock)transaction withRollback:(SRKTransactionBlockBlock)rollback {
+    
+    // we are already within a transaction on this thread, so this unit of work gets its own savepoint and can fail without taking the outer transaction with it
+    
+    SRKTransactionState* state = currentTransactionState();
+    SRKTransactionStates outerResult = state.result;
+    int depth = (int)state.savepoints.count + 1;
+    NSString* savepoint = [NSString stringWithFormat:@"srk_savepoint_%i", depth];
+    
+    for (NSString* database in state.referencedDatabases) {
+        executeTransactionStatement([NSString stringWithFormat:savepointStatement, savepoint], database);
+    }
+    [state.savepoints addObject:savepoint];
+    
+    state.result = SRKTransactionPassed;
+    
+    // if the block throws, the savepoint is unwound before the exception carries on up to the enclosing transaction
+    BOOL completed = NO;
+    @try {
+        transaction();
+        completed = YES;
+    } @finally {
+        [state.savepoints removeLastObject];
+        if (!completed) {
+            rollbackToSavepoint(state, savepoint, depth);
+            state.result = outerResult;
+        }
+    }
+    
+    if (state.result != SRKTransactionPassed) {
+        
+        rollbackToSavepoint(state, savepoint, depth);
+        state.result = outerResult;
+        
+        // the outer transaction is still open, so anything written here becomes part of it
+        if (rollback) {
+            rollback();
+        }
+        
+    } else {
+        
+        for (NSString* database in state.referencedDatabases) {
+            executeTransactionStatement([NSString stringWithFormat:releaseSavepointStatement, savepoint], database);
+        }
+        
+        // fold the savepoint restore points into the enclosing level, keeping the older restore point where there is one
+        for (SRKEntity* o in [SRKTransaction referencedObjects]) {
+            SRKTransactionInfo* info = o.transactionInfo;
+            if (info.savepointDepth == depth) {
+                if (info.previousInfo) {
+                    if (info.eventType) {
+                        info.previousInfo.eventType = info.eventType;
+                    }
+                    [info mergeUndoLogIntoInfo:info.previousInfo];
+                    o.transactionInfo = info.previousInfo;
+                } else {
+                    info.savepointDepth = depth - 1;
+                }
+            }
+        }
+        
+        state.result = outerResult;
+        
+    }
+    
 }
 
 + (void)failTransactionWithCode:(SRKTransactionStates)code {
-    transactionResult = code;
+    currentTransactionState().result = code;
 }
 
 + (SRKTransactionStates)currentTransactionStatus {
-    return transactionResult;
+    SRKTransactionState* state = currentTransactionState();
+    return state ? state.result : SRKTransactionPassed;
 }
 
 + (void)transaction:(SRKTransactionBlockBlock)transaction withRollback:(SRKTransactionBlockBlock)rollback {
+    [SRKTransaction transaction:transaction rollbackMode:SRKTransactionRollbackObjects withRollback:rollback];
+}
+
++ (void)transaction:(SRKTransactionBlockBlock)transaction rollbackMode:(SRKTransactionRollbackMode)mode withRollback:(SRKTransactionBlockBlock)rollback {
 	
 	if (transaction) {
         
-        // loop indefinately so we can lock on a semaphore, the current transaction will in fact lock the transaction or block waiting.
+        if ([SRKTransaction transactionIsInProgressForThisThread]) {
+            [SRKTransaction nestedTransaction:transaction withRollback:rollback];
+            return;
+        }
+        
+        // anything waiting in the group commit queue was committed before this transaction, so it needs to be written first
+        [[SRKGlobals sharedObject] flushGroupCommit];
         
-        // all reads and writes will block if they are not within the current transaction, until it has completed.  At that point they will release.  Paralell calls to a transaction will also block.
+        // the transaction locks each database as it first writes to it, reads and writes from other threads only wait if they touch one of those databases.  Transactions on unrelated databases run in parallel.
         
-        //TODO:  Base transaction on separate database connections so they can be independant and not foul external queries and updates.  For now we levae this as a single crunch point for reliability.
+        SRKTransactionState* state = [SRKTransactionState new];
+        state.rollbackMode = mode;
+        [[[NSThread currentThread] threadDictionary] setObject:state forKey:transactionStateKey];
         
-        while (true) {
-            @synchronized (transactionSemaphore) {
+        // the databases must be handed back whatever happens, if the block throws then anybody waiting on them would otherwise wait forever
+        BOOL completed = NO;
+        @try {
+            
+            transaction();
+            completed = YES;
+            
+            NSArray* referencedObjects = [SRKTransaction referencedObjects];
+            
+            if (state.result != SRKTransactionPassed) {
                 
-                transactionResult = SRKTransactionPassed;
-                transactionInProgress = YES;
-                transactionThread = [NSThread currentThread];
-                transaction();
+                // now rollback all the SRKObjects
+                for (SRKEntity* o in referencedObjects) {
+                    // rollback the object using the SRKTransactionInfo.
+                    [o rollback];
+                }
+                for (NSString* database in state.referencedDatabases) {
+                    executeTransactionStatement(rollbackTransactionStatement, database);
+                }
                 
-                if (transactionResult != SRKTransactionPassed) {
-                    
-                    // now rollback all the SRKObjects
-                    for (SRKEntity* o in transactionReferencedObjects) {
-                        // rollback the object using the SRKTransactionInfo.
-                        [o rollback];
-                    }
-                    for (NSString* database in transactionReferencedDatabases) {
-                        [SharkORM executeSQL:rollbackTransactionStatement inDatabase:database];
-                    }
+            } else {
+                
+                for (NSString* database in state.referencedDatabases) {
+                    executeTransactionStatement(commitTransactionStatement, database);
+                }
+                
+                // now execute the event notifications for all objects within this transaction
+                for (SRKEntity* o in referencedObjects) {
                     
-                } else {
+                    // triger the global callbacks if they have been registered
                     
-                    for (NSString* database in transactionReferencedDatabases) {
-                        [SharkORM executeSQL:commitTransactionStatement inDatabase:database];
+                    if (o.transactionInfo.eventType == SharkORMEventInsert) {
+                        // now raise a global event
+                        SRKGlobalEventCallback callback = [[SRKGlobals sharedObject] getInsertCallback];
+                        if (callback) {
+                            callback(o);
+                        }
                     }
                     
-                    // now execute the event notifications for all objects within this transaction
-                    for (SRKEntity* o in transactionReferencedObjects) {
-                        
-                        // triger the global callbacks if they have been registered
-                        
-                        if (o.transactionInfo.eventType == SharkORMEventInsert) {
-                            // now raise a global event
-                            SRKGlobalEventCallback callback = [[SRKGlobals sharedObject] getInsertCallback];
-                            if (callback) {
-                                callback(o);
-                            }
-                        }
-                        
-                        if (o.transactionInfo.eventType == SharkORMEventUpdate) {
-                            // now raise a global event
-                            SRKGlobalEventCallback callback = [[SRKGlobals sharedObject] getUpdateCallback];
-                            if (callback) {
-                                callback(o);
-                            }
+                    if (o.transactionInfo.eventType == SharkORMEventUpdate) {
+                        // now raise a global event
+                        SRKGlobalEventCallback callback = [[SRKGlobals sharedObject] getUpdateCallback];
+                        if (callback) {
+                            callback(o);
                         }
-                        
-                        if (o.transactionInfo.eventType == SharkORMEventDelete) {
-                            // now raise a global event
-                            SRKGlobalEventCallback callback = [[SRKGlobals sharedObject] getDeleteCallback];
-                            if (callback) {
-                                callback(o);
-                            }
-                        }
-                        
-                        if (o.commitOptions.triggerEvents) {
-                            SRKEvent* e = [SRKEvent new];
-                            e.event = o.transactionInfo.eventType;
-                            e.entity = o;
-                            e.changedProperties = o.modifiedFieldNames;
-                            [[SRKRegistry sharedInstance] broadcast:e];
-                        }
-                        o.transactionInfo = nil;
                     }
                     
-                    // execute any post commit/remove blocks
-                    
-                    for (SRKEntity* o in transactionReferencedObjects) {
-                        if (o.transactionInfo.eventType == SharkORMEventInsert || o.transactionInfo.eventType == SharkORMEventUpdate ) {
-                            if (o.commitOptions.postCommitBlock) {
-                                o.commitOptions.postCommitBlock();
-                            }
-                        } else if (o.transactionInfo.eventType == SharkORMEventDelete) {
-                            if (o.commitOptions.postRemoveBlock) {
-                                o.commitOptions.postRemoveBlock();
-                            }
+                    if (o.transactionInfo.eventType == SharkORMEventDelete) {
+                        // now raise a global event
+                        SRKGlobalEventCallback callback = [[SRKGlobals sharedObject] getDeleteCallback];
+                        if (callback) {
+                            callback(o);
                         }
                     }
                     
+                    if (o.commitOptions.triggerEvents) {
+                        SRKEvent* e = [SRKEvent new];
+                        e.event = o.transactionInfo.eventType;
+                        e.entity = o;
+                        e.changedProperties = o.modifiedFieldNames;
+                        [[SRKRegistry sharedInstance] broadcast:e];
+                    }
                 }
                 
-                [transactionReferencedObjects removeAllObjects];
-                [transactionReferencedDatabases removeAllObjects];
-                transactionThread = nil;
-                transactionInProgress = NO;
+                // execute any post commit/remove blocks
                 
-                if (transactionResult != SRKTransactionPassed) {
-                    
-                    // execute the rollback now the transaction is finished, because it will need to start a new one or may execute it's own DB updates.
-                    
-                    if (rollback) {
-                        rollback();
+                for (SRKEntity* o in referencedObjects) {
+                    if (o.transactionInfo.eventType == SharkORMEventInsert || o.transactionInfo.eventType == SharkORMEventUpdate ) {
+                        if (o.commitOptions.postCommitBlock) {
+                            o.commitOptions.postCommitBlock();
+                        }
+                    } else if (o.transactionInfo.eventType == SharkORMEventDelete) {
+                        if (o.commitOptions.postRemoveBlock) {
+                            o.commitOptions.postRemoveBlock();
+                        }
                     }
+                    // the event type is needed up to here, so the transaction info is only let go once the blocks have run
+                    o.transactionInfo = nil;
                 }
                 
-                break;
-                
             }
+            
+        } @finally {
+            
+            if (!completed) {
+                // the block never finished, so nothing it wrote can be kept
+                state.result = SRKTransactionFailed;
+                for (SRKEntity* o in [SRKTransaction referencedObjects]) {
+                    [o rollback];
+                }
+                for (NSString* database in state.referencedDatabases) {
+                    executeTransactionStatement(rollbackTransactionStatement, database);
+                }
+            }
+            
+            [[[NSThread currentThread] threadDictionary] removeObjectForKey:transactionStateKey];
+            
+            // hand the databases back, anything waiting on them can now continue
+            [transactionCondition lock];
+            for (NSString* database in state.referencedDatabases) {
+                [transactionOwners removeObjectForKey:database];
+            }
+            [transactionCondition broadcast];
+            [transactionCondition unlock];
+            
         }
-
+        
+        if (state.result != SRKTransactionPassed) {
+            
+            // execute the rollback now the transaction is finished, because it will need to start a new one or may execute it's own DB updates.
+            
+            if (rollback) {
+                rollback();
+            }
+        }
+        
 	}
 	
 }
@@ -26,14 +26,20 @@
 @interface SRKTransactionInfo : NSObject
 
 @property enum SharkORMEvent        eventType;
-@property NSMutableDictionary*      originalFieldData;
+@property NSMutableDictionary*      originalFieldValues;
 @property NSMutableDictionary*      originalChangedValues;
 @property NSMutableDictionary*      originalDirtyFields;
 @property NSMutableDictionary*      originalEmbeddedEntities;
 @property BOOL                      originalIsDirty;
+@property BOOL                      originalExists;
 @property id                        originalPk;
+@property BOOL                      hasRestorePoint;
+@property int                       savepointDepth;
+@property SRKTransactionInfo*       previousInfo;
 
 - (void)copyObjectValuesIntoRestorePoint:(SRKEntity*)object;
+- (void)recordOriginalValue:(id)value forField:(NSString*)field;
+- (void)mergeUndoLogIntoInfo:(SRKTransactionInfo*)info;
 - (void)restoreValuesIntoObject:(SRKEntity*)object;
 
 @end
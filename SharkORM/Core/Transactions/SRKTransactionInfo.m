@@ -27,18 +27,50 @@
 
 - (void)copyObjectValuesIntoRestorePoint:(SRKEntity*)object {
     
-    self.originalFieldData = [NSMutableDictionary dictionaryWithDictionary:object.fieldData.copy];
+    /* the persisted values are not copied here, they are logged field by field as setBase overwrites them, so the restore point only costs as much as the object's pending changes */
+    self.originalFieldValues = [NSMutableDictionary new];
     self.originalChangedValues = [NSMutableDictionary dictionaryWithDictionary:object.changedValues.copy];
-    self.originalPk = object.reflectedPrimaryKeyValue;
     self.originalIsDirty = object.dirty;
     self.originalDirtyFields = [NSMutableDictionary dictionaryWithDictionary:object.dirtyFields.copy];
     self.originalEmbeddedEntities = [NSMutableDictionary dictionaryWithDictionary: object.embeddedEntities.copy];
+    self.hasRestorePoint = YES;
 
 }
 
+- (void)recordOriginalValue:(id)value forField:(NSString*)field {
+    
+    // only the first value matters, that is the one which was there when the restore point was created
+    if (self.hasRestorePoint && ![self.originalFieldValues objectForKey:field]) {
+        [self.originalFieldValues setObject:value ? value : [NSNull null] forKey:field];
+    }
+    
+}
+
+- (void)mergeUndoLogIntoInfo:(SRKTransactionInfo*)info {
+    
+    for (NSString* field in self.originalFieldValues.allKeys) {
+        [info recordOriginalValue:[self.originalFieldValues objectForKey:field] forField:field];
+    }
+    
+}
+
 - (void)restoreValuesIntoObject:(SRKEntity*)object {
     
-    object.fieldData = self.originalFieldData;
+    /* an insert which has been undone leaves no row behind, so whatever the rollback mode the object goes back to being new */
+    if (!self.originalExists && object.exists) {
+        object.exists = NO;
+        [object setReflectedPrimaryKeyValue:self.originalPk];
+    }
+    
+    if (!self.hasRestorePoint) {
+        return;
+    }
+    
+    @synchronized(object.fieldData) {
+        for (NSString* field in self.originalFieldValues.allKeys) {
+            [object.fieldData setObject:[self.originalFieldValues objectForKey:field] forKey:field];
+        }
+    }
     object.changedValues = self.originalChangedValues;
     [object setReflectedPrimaryKeyValue:self.originalPk];
     object.dirty = self.originalIsDirty;
@@ -25,9 +25,13 @@
 @interface SRKCompoundIndex : NSObject
 
 @property (strong) NSArray* indexProperties;
+@property (strong) NSArray* includedProperties;
+@property (strong) NSString* condition;
+@property BOOL unique;
 
 - (id)initWithProperties:(NSArray*) indexProperties;
 - (NSString*) getIndexName;
 - (NSString*) getPropertyString;
+- (NSString*) getCreateStatementForTable:(NSString*)tableName;
 
 @end
@@ -32,6 +32,9 @@
 @interface SRKEntity () {
 	NSString*               managedObjectDomain;
 	BOOL					writingPreCalculated;
+#ifdef DEBUG
+	NSThread*				confinedThread;
+#endif
 }
 
 @property BOOL                                          flaggedAsAlive;
@@ -46,12 +49,14 @@
 @property BOOL                                          dirty;
 @property BOOL                                          isLightweightObject;
 @property BOOL                                          isLightweightObjectLoaded;
+@property (nonatomic) BOOL                              threadConfined;
 @property (nonatomic, strong)   NSMutableDictionary*    embeddedEntities; // this will be used to store all of the set entities
 @property (nonatomic, weak)     id<SRKEventDelegate>    eventsDelegate;
 @property (nonatomic, weak)     SRKContext*             context;
 @property BOOL                                          isMarkedForDeletion;
 @property (strong) NSArray*                             creatorFunctionName;
 @property (strong) SRKTransactionInfo*                  transactionInfo;
+@property (strong) NSMutableSet*                        registryKeys; // the keys this instance has been registered under, guarded by the registry
 
 // methods for data access
 - (NSObject*)getField:(NSString*)fieldName;
@@ -83,6 +88,11 @@
 - (id)copy;
 - (BOOL)__commitRawWithObjectChain:(SRKEntityChain*)chain;
 - (BOOL)__removeRaw;
++ (BOOL)__supportsBatchedCommit;
+- (void)__addIgnoredEntitiesToObjectChain:(SRKEntityChain*)chain;
+- (void)__prepareForCommitWithObjectChain:(SRKEntityChain*)chain;
+- (void)__prepareFieldsForCommitWithRelationships:(NSArray*)relationships;
+- (SRKEvent*)__completeCommitWithEventType:(enum SharkORMEvent)eventType;
 - (void)reloadRelationships;
 
 /* schema */
@@ -25,6 +25,8 @@
 
 @interface SRKIndexDefinition () {
 	NSMutableArray* _components;
+	NSMutableArray* _spatialIndexes;
+	NSMutableArray* _fullTextProperties;
 }
 
 - (void)generateIndexesForTable:(NSString*)tableName forEntity:(NSString*)entity;
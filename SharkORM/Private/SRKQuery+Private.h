@@ -43,15 +43,23 @@
 @property BOOL									excludeResultsFromCache;
 @property BOOL									recordPerformance;
 @property BOOL									lightweightObject;
+@property BOOL									captureChangedRows;
+@property BOOL									threadConfinedObjects;
 @property (atomic, strong) NSArray*				prefetch;
 @property (nonatomic, retain) SRKQueryProfile*	performance;
 @property int									queryType;
 @property (strong) NSString*					sumFieldName;
 @property (strong) NSString*					groupFieldName;
 @property (strong) NSString*					distinctFieldName;
+@property (strong) NSMutableArray*				conditions;
+@property (strong) NSMutableArray*				conditionParameters;
+@property (strong) NSMutableArray*				fullTextJoins;
 
 - (SRKQuery*)entityclass:(Class)entityClass;
 - (id)fetchSpecificValueWithQuery:(NSString*)query;
+- (SRKQuery*)addCondition:(NSString*)condition parameters:(NSArray*)parameters;
+- (NSString*)compiledWhereClause;
+- (NSArray*)compiledParameters;
 
 @end
 
@@ -25,6 +25,8 @@
 
 #import "SharkORM.h"
 
+@class SRKTransactionInfo;
+
 typedef enum : NSUInteger {
     SRKTransactionFailed,
     SRKTransactionPassed,
@@ -34,13 +36,16 @@ typedef enum : NSUInteger {
 
 @interface SRKTransaction ()
 
-+ (void)blockUntilTransactionFinished;
++ (void)blockUntilTransactionFinishedForDatabase:(NSString*)database;
++ (void)blockUntilTransactionFinishedForEntities:(NSArray*)entities;
 + (BOOL)transactionIsInProgress;
 + (BOOL)transactionIsInProgressForThisThread;
 + (void)addReferencedObjectToTransactionList:(id)referencedObject;
-+ (void)startTransactionForDatabaseConnection:(NSString*)database;
++ (BOOL)startTransactionForDatabaseConnection:(NSString*)database;
 + (SRKTransactionStates)currentTransactionStatus;
 + (void)failTransactionWithCode:(SRKTransactionStates)code;
++ (BOOL)entityRequiresRestorePoint:(SRKEntity*)entity;
++ (SRKTransactionInfo*)createRestorePointForEntity:(SRKEntity*)entity;
 
 @end
 
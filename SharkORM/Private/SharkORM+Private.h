@@ -31,6 +31,11 @@
 // form data methods
 -(BOOL)removeObject:(SRKEntity*)entity;
 -(BOOL)commitObject:(SRKEntity*)entity;
+-(NSArray*)commitObjects:(NSArray<SRKEntity*>*)entities;
+-(BOOL)removeObjects:(NSArray<SRKEntity*>*)entities;
+-(NSArray*)upsertObjects:(NSArray<SRKEntity*>*)entities onConflict:(NSArray<NSString*>*)conflictProperties update:(NSArray<NSString*>*)updateProperties where:(NSString*)condition;
+-(uint64_t)importFile:(NSString*)filePath format:(SRKImportFormat)format intoClass:(Class)classDecl options:(SRKImportOptions*)options;
+-(int)executeCachedStatement:(NSString*)sql values:(NSArray*)values inDatabase:(NSString*)databaseName errorMessage:(NSString**)errorMessage;
 -(void)replaceUUIDPrimaryKey:(SRKEntity *)entity withNewUUIDKey:(NSString*)newPrimaryKey;
 +(void)refreshObject:(SRKEntity*)entity;
 
@@ -39,15 +44,20 @@
 -(double)fetchSumForQuery:(SRKQuery*)query field:(NSString*)fieldname;
 -(NSArray*)fetchDistinctForQuery:(SRKQuery*)query field:(NSString*)fieldname;
 -(NSArray*)fetchIDsForQuery:(SRKQuery*)query;
+-(uint64_t)exportForQuery:(SRKQuery*)query toStream:(NSOutputStream*)stream format:(SRKExportFormat)format;
+-(uint64_t)deleteForQuery:(SRKQuery*)query primaryKeys:(NSArray**)primaryKeys;
+-(uint64_t)updateForQuery:(SRKQuery*)query values:(NSDictionary*)values primaryKeys:(NSArray**)primaryKeys;
 +(SRKSettings*)getSettings;
 +(sqlite3*)handleForDatabase:(NSString*)dbName;
 +(NSString*)databaseNameForClass:(Class)classDecl;
++(NSArray<NSString*>*)databaseNamesForEntities:(NSArray<SRKEntity*>*)entities;
 +(void)setSchemaRevision:(int)revision inDatabase:(NSString*)dbName;
 +(int)getSchemaRevisioninDatabase:(NSString*)dbName;
 +(void)setEntityRevision:(int)revision forEntity:(NSString*)entity inDatabase:(NSString*)dbName;
 +(int)getEntityRevision:(NSString*)entity inDatabase:(NSString*)dbName;
 +(NSInteger)primaryKeyType:(NSString*)tableName;
 +(void)executeSQL:(NSString*)sql inDatabase:(NSString*)dbName;
++(BOOL)executeSQL:(NSString*)sql inDatabase:(NSString*)dbName errorMessage:(NSString**)errorMessage;
 +(id)getValueFromQuery:query inClass:classDecl;
 
 @end
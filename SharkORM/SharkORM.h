@@ -41,6 +41,14 @@
 
 typedef void(^SRKTransactionBlockBlock)(void);
 
+/// what is put back when a transaction fails.
+typedef enum : int {
+    /// the database changes are rolled back and every object referenced within the transaction is restored to its previous values.
+    SRKTransactionRollbackObjects = 0,
+    /// only the database changes are rolled back, objects keep their values and are not retained by the transaction.  Intended for bulk loads.
+    SRKTransactionRollbackDatabaseOnly = 1,
+} SRKTransactionRollbackMode;
+
 /**
  * Called from within a transaction block to manually fail a transaction and cause a rollback.  Example, `SRKFailTransaction();`
  *
@@ -56,12 +64,24 @@ void SRKFailTransaction(void);
 /**
  * Creates a new transaction for the current executing thread, which then executes the transaction block that was passed into the object, if the transaction failes in anypart the database changes are rolled back and the rollback block is called.
  
+ * Transactions can be nested, a transaction started from within another transaction block is wrapped in a SAVEPOINT.  If the nested transaction fails only its own changes are rolled back and its rollback block is called, the outer transaction carries on and can still commit.
+ 
+ * A transaction locks only the databases it writes to, other threads only wait for it when they read from or write to one of those databases.  Should two transactions each need a database the other holds, the later one fails after the busy timeout rather than deadlocking.
  *
  * @param transaction:(SRKTransactionBlockBlock*)transaction A valid SRKTransactionBlockBlock, any objects which are commited to removed within this block, will be dealt with within a single transaction.
  * @param withRollback:(SRKTransactionBlockBlock*)rollback A valid SRKTransactionBlockBlock, if executed all database objects are restored back to their previos state before the transaction began.
  * @return void
  */
 + (void)transaction:(nullable SRKTransactionBlockBlock)transaction withRollback:(nullable SRKTransactionBlockBlock)rollback;
+/**
+ * Creates a new transaction for the current executing thread, as with transaction:withRollback:, but lets the developer choose what is restored should it fail.  Nested transactions use the mode of the outermost transaction.
+ *
+ * @param transaction:(SRKTransactionBlockBlock*)transaction A valid SRKTransactionBlockBlock, any objects which are commited to removed within this block, will be dealt with within a single transaction.
+ * @param rollbackMode:(SRKTransactionRollbackMode)mode SRKTransactionRollbackObjects to restore objects as well as the database, or SRKTransactionRollbackDatabaseOnly to only roll back the database, which avoids holding restore points for every object in large transactions.
+ * @param withRollback:(SRKTransactionBlockBlock*)rollback A valid SRKTransactionBlockBlock, executed if the transaction fails.
+ * @return void
+ */
++ (void)transaction:(nullable SRKTransactionBlockBlock)transaction rollbackMode:(SRKTransactionRollbackMode)mode withRollback:(nullable SRKTransactionBlockBlock)rollback;
 
 @end
 
@@ -70,6 +90,19 @@ typedef enum : int {
     SRK_RELATE_ONETOMANY = 2,
 } SRKRelationshipType;
 
+/// the format of the primary keys generated for SRKStringObject entities.
+typedef enum : int {
+    /// a random lowercase UUID string, e.g. "0b5f3c2e-...".
+    SRKPrimaryKeyFormatUUID = 0,
+    /// a time ordered UUID (version 7), the same length as a UUID but new keys always sort after existing ones so inserts append to the end of the table and its indexes.
+    SRKPrimaryKeyFormatUUIDv7 = 1,
+    /// a time ordered ULID, 26 characters of base32 that sort in creation order.  The most compact of the formats.
+    SRKPrimaryKeyFormatULID = 2,
+} SRKPrimaryKeyFormat;
+
+/// a block which returns a new primary key for an SRKStringObject entity of the given class, returning nil falls back to the primaryKeyFormat.
+typedef NSString* _Nullable (^SRKPrimaryKeyGeneratorBlock)(Class _Nonnull entityClass);
+
 /**
  * Settings class for SharkORM, returned from the delegate when the engine is initialized.
  
@@ -92,6 +125,22 @@ typedef enum : int {
 @property (strong, nullable)                  NSString* encryptionKey;
 /// tells SharkORM if you wish to retain values for lightweight objects once they are done with.
 @property BOOL                      retainLightweightObjects;
+/// the maximum time (in seconds) a statement will wait for another connection or process to release the database before failing with an error.  Default is 10 seconds, 0 fails immediately.
+@property double                    busyTimeout;
+/// whilst waiting for the database, the delay between attempts doubles each time starting at 1ms, up to this maximum (in seconds).  Default is 0.1 seconds.
+@property double                    busyMaximumBackoff;
+/// when greater than 0, commits made outside of a transaction are queued and written together in a single transaction once this window (in seconds) has passed, rather than each paying for its own disk sync.  'commit' returns as soon as the object is queued, use the postCommitBlock in the commit options to be told when it has been written, or call [SharkORM flush].  Default is 0 (off).
+@property double                    groupCommitWindow;
+/// the number of queued objects which will cause the group commit to be written without waiting for the window to close.  Default is 500.
+@property NSUInteger                groupCommitMaximumRows;
+/// the format of the keys generated for new SRKStringObject entities which have not been given an Id.  Default is SRKPrimaryKeyFormatUUID.
+@property SRKPrimaryKeyFormat       primaryKeyFormat;
+/// when set, this block is asked for the key of new SRKStringObject entities instead of using the primaryKeyFormat.  Default is nil.
+@property (copy, nullable) SRKPrimaryKeyGeneratorBlock primaryKeyGenerator;
+/// the number of read only connections opened alongside the writer for each database.  Queries are run on one of these (outside of a transaction) so they no longer queue behind writes or each other, each connection is only ever used by one thread at a time.  Only used when the database is in WAL mode, 0 runs everything through the single connection.  Default is 4.
+@property NSUInteger                readConnections;
+/// when greater than 0, events are held for this window (in seconds) before being delivered to the registered blocks.  Repeated events for the same object or table within the window are merged into one, with their changed properties and affected rows combined, so a bulk write raises a handful of notifications rather than one per row.  Default is 0 (each event is delivered as it happens).
+@property double                    eventCoalescingWindow;
 
 @end
 
@@ -122,6 +171,24 @@ typedef enum : int {
 
 @end
 
+/**
+ * A snapshot of the lock contention that SharkORM has encountered, where statements have had to wait for another connection or process to release the database.
+ */
+@interface SRKBusyStatistics : NSObject
+
+/// The number of times a statement found the database locked.
+@property  uint64_t contentionEvents;
+/// The total number of attempts that were made whilst waiting.
+@property  uint64_t retries;
+/// The number of times the busy timeout was reached and the statement failed.
+@property  uint64_t timeouts;
+/// The total time (in seconds) spent waiting for the database.
+@property  double totalWaitTime;
+/// Counts of the time spent waiting for each contention event, bucketed as <1ms, <10ms, <100ms, <1s and >=1s.
+@property  (nonatomic, strong, nonnull) NSArray<NSNumber*>* waitHistogram;
+
+@end
+
 /**
  * Ad error raised by SharkORM, gives you the message from the core, as well as the SQL query that was generated and caused the fault.
  
@@ -166,6 +233,7 @@ typedef void(^SRKConfigurationBlock)(void);
 
 NS_ASSUME_NONNULL_BEGIN
 typedef void(^SRKGlobalEventCallback)(SRKEntity* entity);
+typedef void(^SRKReadSnapshotBlock)(void);
 NS_ASSUME_NONNULL_END
 
 @interface SharkORM : NSObject {
@@ -200,7 +268,7 @@ NS_ASSUME_NONNULL_END
  */
 +(void)setupTablesFromClasses:(nullable Class)classDecl,...;
 /**
- * Migrates data from an existing CoreData database file into SharkORM, only the supplied object names are converted.  NOTE: If successful, the original file will be removed by the routine.  Existing Objects within the supplied list will be cleared from the database.
+ * Migrates data from an existing CoreData database file into SharkORM, only the supplied object names are converted.  The rows are streamed across in batches, in the same way as 'importFromFile:format:options:'.  NOTE: If successful, the original file will be removed by the routine.  Existing Objects within the supplied list will be cleared from the database.
  *
  * @param filePath The full path to the CoreData file that needs to be converted.
  * @param tablesToConvert Array of SRKEntity class names to convert from the original CoreData file provided.
@@ -248,6 +316,31 @@ NS_ASSUME_NONNULL_END
  * @return void;
  */
 +(void)setDeleteCallbackBlock:(nullable SRKGlobalEventCallback)callback;
+/**
+ * Returns the lock contention statistics gathered since the ORM started, or since they were last reset.
+ *
+ * @return (SRKBusyStatistics*) a snapshot of the current statistics.
+ */
++(nonnull SRKBusyStatistics*)busyStatistics;
+/**
+ * Resets the lock contention statistics back to zero.
+ *
+ * @return void;
+ */
++(void)resetBusyStatistics;
+/**
+ * Writes any commits that are waiting in the group commit queue, and blocks until they are durable.  Has no effect if 'groupCommitWindow' is not set, or when called from within a transaction.
+ *
+ * @return void;
+ */
++(void)flush;
+/**
+ * Executes the block with every query inside it reading from a single, consistent snapshot of the database.  Each database touched is pinned to one of its read connections in a read transaction, from the first query against it until the block returns, so commits from other threads are not seen part way through, and they are not held up either.  Requires the database to be in WAL mode, otherwise the queries run as normal.  Within a transaction, queries see the transaction's own changes as they always do.
+ *
+ * @param block The block containing the queries that should see the same state of the database.
+ * @return void;
+ */
++(void)readSnapshot:(nonnull SRKReadSnapshotBlock)block;
 
 @end
 
@@ -325,6 +418,38 @@ enum SRKIndexSortOrder : NSUInteger {
  * @return void
  */
 - (nonnull SRKIndexDefinition*)addIndexForProperty:(nonnull NSString*)propertyName propertyOrder:(enum SRKIndexSortOrder)propOrder secondaryProperty:(nonnull NSString*)secProperty secondaryOrder:(enum SRKIndexSortOrder)secOrder;
+/**
+ * Adds the definition for a compound index, with control over uniqueness, covering columns and the rows that are indexed.
+ *
+ * @param properties An array of SRKIndexProperty objects which make up the key of the index, in order.
+ * @param includedProperties An optional array of property names which are appended to the index so that queries which only need these values can be answered from the index without a table lookup (a covering index).  Cannot be used with a unique index.
+ * @param condition An optional WHERE clause, which makes this a partial index containing only the matching rows, e.g. "active = 1".  Queries must include the same condition for SQLite to make use of the index.
+ * @param unique If YES, the index is created as a UNIQUE index and SQLite will reject any commit which would duplicate the key.
+ * @return SRKIndexDefinition
+ */
+- (nonnull SRKIndexDefinition*)addIndexWithProperties:(nonnull NSArray<SRKIndexProperty*>*)properties include:(nullable NSArray<NSString*>*)includedProperties where:(nullable NSString*)condition unique:(BOOL)unique;
+/**
+ * Adds a UNIQUE index over the named properties.
+ *
+ * @param properties An array of property names which together must be unique.
+ * @return SRKIndexDefinition
+ */
+- (nonnull SRKIndexDefinition*)addUnique:(nonnull NSArray<NSString*>*)properties;
+/**
+ * Adds a spatial (R*Tree) index over a pair of latitude & longitude properties, which is then used by the radius and bounding box methods on SRKQuery.  The index is maintained automatically as objects are committed and removed.  If the linked SQLite was built without the R*Tree module no index is created, and the queries fall back to a range over the latitude & longitude columns.  Only available on SRKObject classes, the index is keyed on the rowid which is not stable for a string primary key.  Otherwise the index is not created and the error is reported through 'databaseError:'.
+ *
+ * @param latitudeProperty The name of the property which holds the latitude, in degrees.
+ * @param longitudeProperty The name of the property which holds the longitude, in degrees.
+ * @return SRKIndexDefinition
+ */
+- (nonnull SRKIndexDefinition*)addSpatialIndexForLatitude:(nonnull NSString*)latitudeProperty longitude:(nonnull NSString*)longitudeProperty;
+/**
+ * Adds a full text index over one or more string properties, which can then be searched using 'match:' on SRKQuery.  There is a single full text index per entity, calling this again adds the properties to it.  The index is maintained automatically as objects are committed and removed.  Only available on SRKObject classes, the index is keyed on the rowid which is not stable for a string primary key.  Otherwise the index is not created and the error is reported through 'databaseError:'.
+ *
+ * @param properties An array of property names to be included in the full text index.
+ * @return SRKIndexDefinition
+ */
+- (nonnull SRKIndexDefinition*)addFullTextIndexForProperties:(nonnull NSArray<NSString*>*)properties;
 
 @end
 
@@ -347,6 +472,7 @@ enum SharkORMEvent {
 };
 
 typedef void(^SRKEventRegistrationBlock)(SRKEvent* _Nonnull event);
+typedef void(^SRKEventBatchBlock)(NSArray<SRKEvent*>* _Nonnull events);
 
 /**
  * If implemented, SRKEventDelegate is used to notify an object that an event has been raised within a SRKEntity.
@@ -389,6 +515,24 @@ typedef void(^SRKEventRegistrationBlock)(SRKEvent* _Nonnull event);
 
 typedef     void(^contextExecutionBlock)(void);
 
+/**
+ * A summary of the changes that were written when an SRKContext was committed.
+ */
+@interface SRKContextSummary : NSObject
+
+/// the entities which were inserted, including related objects that were written along with them.
+@property (nonatomic, strong, readonly, nonnull) NSArray<SRKEntity*>* inserted;
+/// the entities which were updated, including related objects that were written along with them.
+@property (nonatomic, strong, readonly, nonnull) NSArray<SRKEntity*>* updated;
+/// the entities which were removed.
+@property (nonatomic, strong, readonly, nonnull) NSArray<SRKEntity*>* removed;
+/// the number of entities in the context which had no changes, and so were not written.
+@property (nonatomic, readonly) NSUInteger unchanged;
+/// the total number of entities inserted, updated or removed.
+@property (nonatomic, readonly) NSUInteger changes;
+
+@end
+
 /**
  * SRKContext objects are used to effect bulk operations across single or multiple tables.  You can not call commit on an object that has been added to a context.  Instead you call commit on the context itself, all activities will then be performed within an single transaction. NOTE: all SRKObjects have their own context already, and any activity performed on then is guaranteed to complete in an ATOMIC way.  This style of object management is provided in a legacy manner as this is a method that programmers are largely used to, but it is not a requirement.  SharkORM already groups together operations and performs them in bulk when it can to improve performance, the deleoper does not need to think about this when writing their application.
  */
@@ -418,12 +562,14 @@ typedef     void(^contextExecutionBlock)(void);
  */
 - (BOOL)isEntityInContext:(nonnull SRKEntity*)entity;
 /**
- * Commits all of the pending changes contained in SRKObject's within the context.
+ * Commits all of the pending changes contained in SRKObject's within the context.  Only entities with changes are written, inserts and updates are ordered so related objects are written first, followed by the removals, all within a single transaction.
  
  *
  * @return BOOL returns YES if the operation was successful.
  */
 - (BOOL)commit;
+/// the changes written by the last successful commit of this context, nil if it has not been committed or the last commit failed.
+@property (nonatomic, strong, readonly, nullable) SRKContextSummary* lastCommitSummary;
 
 @end
 
@@ -435,6 +581,16 @@ typedef     void(^contextExecutionBlock)(void);
 /// a generic block to be executed after a commit/remove event.
 typedef void(^SRKCommitOptionsBlock)(void);
 
+/// the action taken when a commit would duplicate the values of a unique index, such as those created for 'uniquePropertiesForClass'.
+typedef enum : int {
+    /// the commit fails, returning NO and raising an error.
+    SRKConflictPolicyFail = 0,
+    /// the commit is quietly skipped, returning NO without raising an error.
+    SRKConflictPolicyIgnore = 1,
+    /// the existing row(s) which conflict are removed and replaced with this object.
+    SRKConflictPolicyReplace = 2,
+} SRKConflictPolicy;
+
 
 /**
  * Defines a set of options which will be taken into account on an object by object basis when commiting or removing entities from the data store.  All SRKObjects' have a commit options property, and it is automatically populated with the ORM defaults.
@@ -449,6 +605,8 @@ typedef void(^SRKCommitOptionsBlock)(void);
 @property (nullable) NSArray*               ignoreEntities;
 /// when TRUE errors will be raised within transactions and posted to the app delegate, when false syntax errors will not raise errors and will not fail a transaction block.  Default is TRUE.
 @property BOOL                              raiseErrors;
+/// the action taken when the commit would duplicate the values of a unique index.  Default is SRKConflictPolicyFail.
+@property SRKConflictPolicy                 conflictPolicy;
 /// when TRUE, the properties of this class object will be reset back to their defaults.  Any blocks that were assigned for post events will also be cleared and their memory released.
 @property BOOL                              resetOptionsAfterCommit;
 /// executed on the calling thread, after an object has been successfully persisted.
@@ -458,6 +616,48 @@ typedef void(^SRKCommitOptionsBlock)(void);
 
 @end
 
+/*
+ *      SRKImportOptions
+ *
+ */
+
+/// the layout of a file which is being bulk imported.
+typedef enum : int {
+    /// comma separated values, the first record holds the column names.  Quoted fields may contain commas, doubled quotes and line breaks.
+    SRKImportFormatCSV = 0,
+    /// one JSON object per line, the keys of each object are the column names.
+    SRKImportFormatJSONLines = 1,
+} SRKImportFormat;
+
+/// the layout of a file produced by an export.
+typedef enum : int {
+    /// comma separated values with a header record of the column names, values are quoted where needed.
+    SRKExportFormatCSV = 0,
+    /// one JSON object per line.
+    SRKExportFormatJSONLines = 1,
+} SRKExportFormat;
+
+/// executed after each batch of an import has been written, with the number of records imported so far and how far through the file the import has got.
+typedef void(^SRKImportProgressBlock)(uint64_t recordsImported, uint64_t bytesRead, uint64_t totalBytes);
+
+/**
+ * Defines how a file is bulk imported into a class using 'importFromFile:format:options:'.
+ */
+@interface SRKImportOptions : NSObject
+
+/// the number of records written within each transaction, only a single batch is held in memory at any one time.  Default is 5000.
+@property NSUInteger                        batchSize;
+/// maps the names used within the file onto property names.  Names which are not mapped are matched to the properties regardless of case, and any that still do not match are skipped.  Default is nil.
+@property (strong, nullable) NSDictionary<NSString*,NSString*>* columnMapping;
+/// the action taken when a record duplicates a primary key or unique index.  Default is SRKConflictPolicyFail, which stops the import.
+@property SRKConflictPolicy                 conflictPolicy;
+/// when TRUE the non unique indexes of the class are dropped before the import and built again once it has finished, rather than being maintained row by row.  Has no effect within a transaction.  Default is NO.
+@property BOOL                              deferIndexes;
+/// executed on the calling thread after each batch has been written.
+@property (copy, nullable) SRKImportProgressBlock progress;
+
+@end
+
 /*
  *      SRKObject
  *
@@ -541,6 +741,58 @@ typedef void(^SRKCommitOptionsBlock)(void);
  * @return BOOL returns NO if the operation failed to complete.
  */
 - (BOOL)commit;
+/**
+ * Inserts or updates a collection of objects within a single transaction.  Objects are grouped by class and the columns being written so each statement is prepared once and re-used for every row, and the events for the whole batch are raised together once it has been committed.  Objects that are within a transaction block or a context are committed individually as normal.
+ *
+ * @param (NSArray*)entities The objects to be inserted or updated, these can be of mixed classes.
+ * @return (NSArray*) The primary key values of the objects in the same order as they were supplied, NSNull is used for any object which was not committed.  Returns nil if the batch failed and was rolled back.
+ */
++ (nullable NSArray*)commitAll:(nonnull NSArray<SRKEntity*>*)entities;
+/**
+ * Removes a collection of objects from the database within a single transaction, re-using the same statement for each row and raising the delete events for the whole batch together.
+ *
+ * @param (NSArray*)entities The objects to be removed, these can be of mixed classes.
+ * @return BOOL returns NO if the operation failed to complete, in which case none of the objects will have been removed.
+ */
++ (BOOL)removeAll:(nonnull NSArray<SRKEntity*>*)entities;
+/**
+ * Inserts the object, or if it conflicts with an existing row on a unique set of properties, merges the specified properties into that row.  This is a single INSERT ... ON CONFLICT DO UPDATE statement, no read is made beforehand.  The properties in onConflict must be covered by a unique index, e.g. 'uniquePropertiesForClass' or 'addUnique:'.
+ *
+ * @param (SRKEntity*)entity The object to be inserted or merged.
+ * @param (NSArray*)conflictProperties The property names which identify an existing row, e.g. @[@"externalId"].
+ * @param (NSArray*)updateProperties The property names which will be overwritten in the existing row, pass an empty array to leave existing rows untouched.  When the object is merged into an existing row it takes that row's primary key and the values it holds once the upsert is complete.
+ * @return BOOL returns NO if the operation failed to complete.
+ */
++ (BOOL)upsert:(nonnull SRKEntity*)entity onConflict:(nonnull NSArray<NSString*>*)conflictProperties update:(nonnull NSArray<NSString*>*)updateProperties;
+/**
+ * Inserts the object, or if it conflicts with an existing row on a unique set of properties, merges the specified properties into that row when the condition is met.
+ *
+ * @param (SRKEntity*)entity The object to be inserted or merged.
+ * @param (NSArray*)conflictProperties The property names which identify an existing row, e.g. @[@"externalId"].
+ * @param (NSArray*)updateProperties The property names which will be overwritten in the existing row.
+ * @param (NSString*)condition An optional condition for the update, the incoming values are referenced with 'excluded.' e.g. "excluded.modified > modified" to only take newer values.
+ * @return BOOL returns NO if the operation failed to complete.
+ */
++ (BOOL)upsert:(nonnull SRKEntity*)entity onConflict:(nonnull NSArray<NSString*>*)conflictProperties update:(nonnull NSArray<NSString*>*)updateProperties where:(nullable NSString*)condition;
+/**
+ * Upserts a collection of objects within a single transaction, the statement is prepared once and re-used for every row.
+ *
+ * @param (NSArray*)entities The objects to be inserted or merged.
+ * @param (NSArray*)conflictProperties The property names which identify an existing row, e.g. @[@"externalId"].
+ * @param (NSArray*)updateProperties The property names which will be overwritten in the existing row.
+ * @param (NSString*)condition An optional condition for the update, the incoming values are referenced with 'excluded.'.
+ * @return BOOL returns NO if the operation failed to complete, in which case none of the objects will have been written.
+ */
++ (BOOL)upsertAll:(nonnull NSArray<SRKEntity*>*)entities onConflict:(nonnull NSArray<NSString*>*)conflictProperties update:(nonnull NSArray<NSString*>*)updateProperties where:(nullable NSString*)condition;
+/**
+ * Streams the records from a CSV or JSON-lines file straight into the table for this class, without creating any objects.  The file is read in chunks and written in batches using a single re-used statement, so memory use does not grow with the size of the file.  Missing primary keys are generated, dates in the "yyyy-MM-dd HH:mm:ss" format are converted and everything else is written as found.  Encrypted properties can not be imported, and instead of an event for each object the table handlers receive a single insert event with the number of rows.
+ *
+ * @param (NSString*)filePath The full path to the file to be imported.
+ * @param (SRKImportFormat)format The layout of the file.
+ * @param (SRKImportOptions*)options Options for the import, or nil to use the defaults.
+ * @return (uint64_t) The number of records imported.  If an error stops the import, the batches which have already been written are kept.
+ */
++ (uint64_t)importFromFile:(nonnull NSString*)filePath format:(SRKImportFormat)format options:(nullable SRKImportOptions*)options;
 
 /* these methods should be overloaded in the business object class */
 /**
@@ -591,6 +843,12 @@ typedef void(^SRKCommitOptionsBlock)(void);
  * @return (BOOL) If true is returned, event notifications will not be raised.  This will significantly improve the speed of I,U & D operations.
  */
 + (BOOL)entityDoesNotRaiseEvents;
+/**
+ * Used to indicate to SharkORM that instances of this class are only ever used from one thread at a time.  Property access then skips the locking and copying needed to share an object between threads, which makes reading and writing properties in tight loops much faster.  The object belongs to the first thread that reads or writes a property after it has been created or fetched, debug builds assert if any other thread uses it.  Thread confined objects are not updated in place when another instance of the same record is committed within their managed object domain, they are never deferred into a group commit, and event blocks delivered on another queue are given an unconfined copy of the object rather than the object itself.
+ *
+ * @return (BOOL) If true is returned, instances of the class are thread confined.  Queries can also return thread confined objects of any class using 'threadConfined'.
+ */
++ (BOOL)entityIsThreadConfined;
 /**
  * Used to specify the relationships between objects.  The class will be asked to return the relationship object for a certain property.
  ∫
@@ -606,6 +864,12 @@ typedef void(^SRKCommitOptionsBlock)(void);
  * @return (SRKIndexDefinition*) return an index object to let SharkORM know which properties need to be indexed for performance reasons.  Primary keys are already indexed, as are any properties that are in fact other persisbale classes.  SharkORM will attempt to automatically calculate indexes from the relationships between your classes, but sometimes you may with to add them manually given feedback form the profiling mechanisum.
  */
 + (nullable SRKIndexDefinition*)indexDefinitionForEntity;
+/**
+ * Used to specify the string properties that should be included in the full text index for the entity, this is a convenience for calling 'addFullTextIndexForProperties:' on the index definition.  Matching objects can then be retrieved using 'match:' on SRKQuery.  Ignored for SRKStringObject classes.
+ *
+ * @return (NSArray*) Return an array of property names to be full text indexed.
+ */
++ (nullable NSArray<NSString*>*)FTSParametersForEntity;
 /**
  * Used to indicate to SharkORM that you wish to ignore ceratin properties and to not persiste them.
  *
@@ -626,11 +890,17 @@ typedef void(^SRKCommitOptionsBlock)(void);
  */
 + (nullable NSArray<NSString*>*)encryptedPropertiesForClass;
 /**
- * Specifies the properties on the class that should be unique within the datastore, before a commit operation is performed a test is made to ensure another record with those exact properties does not already exist.  Commit will return NO/FALSE if there is an existant match.
+ * Specifies the properties on the class that should be unique within the datastore, these are enforced with a UNIQUE index.  A commit which would duplicate an existing record will return NO/FALSE, unless the conflictPolicy in the commit options says otherwise.
  *
  * @return and (NSArray*) of property names that SharkORM should test for uniqueness.
  */
 + (nullable NSArray<NSString*>*)uniquePropertiesForClass;
+/**
+ * Opts the class into clustered (WITHOUT ROWID) storage, where the rows are kept in the primary key's own b-tree so a lookup by key only reads a single b-tree.  Return @[@"Id"] to cluster on the primary key, or a list of properties to cluster on a composite natural key, in which case Id is kept unique with its own index and the key properties must be set before the object is committed.  Only honoured for SRKStringObject classes.  Changing this on an existing table rebuilds it.
+ *
+ * @return (NSArray*) the properties that make up the clustered key, or nil (the default) for normal rowid storage.
+ */
++ (nullable NSArray<NSString*>*)clusteredPrimaryKeyForClass;
 /**
  * Specifies the database file that this particular class will be persisted in.  This enables you to have your persistable classes spanning many different files.
  
@@ -717,6 +987,24 @@ typedef void(^SRKCommitOptionsBlock)(void);
  * @return void
  */
 - (void)registerBlockForEvents:(enum SharkORMEvent)events withBlock:(nonnull SRKEventRegistrationBlock)block onMainThread:(BOOL)mainThread;
+/**
+ * As 'registerBlockForEvents:withBlock:onMainThread:', but the block is executed on the given queue.  Events are delivered asynchronously, so the thread that raised them is never held up.
+ *
+ * @param registerBlockForEvents:(enum SharkORMEvent)events specifies the events that you are looking to observe, these can be SharkORMEventInsert, SharkORMEventUpdate or SharkORMEventDelete.  They are bitwise properties so can be combined such like SharkORMEventInsert|SharkORMEventUpdate.
+ * @param withBlock:(SRKEventRegistrationBlock)block is the block to be executed when the event occours.
+ * @param onQueue:(dispatch_queue_t)queue the serial or concurrent queue the block is executed on, if nil the block gets a serial queue of its own so its events arrive in order.
+ * @return void
+ */
+- (void)registerBlockForEvents:(enum SharkORMEvent)events withBlock:(nonnull SRKEventRegistrationBlock)block onQueue:(nullable dispatch_queue_t)queue;
+/**
+ * Registers a block which is handed the events in batches rather than one at a time.  When 'eventCoalescingWindow' is set, everything raised within the window is delivered in a single call, with repeated events for the same object or table merged together.  Otherwise each batch contains a single event.
+ *
+ * @param registerBlockForEvents:(enum SharkORMEvent)events specifies the events that you are looking to observe, these can be SharkORMEventInsert, SharkORMEventUpdate or SharkORMEventDelete.  They are bitwise properties so can be combined such like SharkORMEventInsert|SharkORMEventUpdate.
+ * @param withBatchBlock:(SRKEventBatchBlock)block is the block to be executed with each batch of events.
+ * @param onQueue:(dispatch_queue_t)queue the serial or concurrent queue the block is executed on, if nil the block gets a serial queue of its own so its batches arrive in order.
+ * @return void
+ */
+- (void)registerBlockForEvents:(enum SharkORMEvent)events withBatchBlock:(nonnull SRKEventBatchBlock)block onQueue:(nullable dispatch_queue_t)queue;
 /**
  * Clears all event blocks within the object and stops the object from receiving event notifications.
  
@@ -759,6 +1047,10 @@ typedef void(^SRKCommitOptionsBlock)(void);
 @property  (nonatomic, weak, nullable) SRKEntity*      entity;
 /// The properties that have changed within this object since its last comital into the database.
 @property  (nonatomic, strong, nullable) NSArray*     changedProperties;
+/// The class of the table that raised the event, this is set for set based updates & deletes where there is no single entity.
+@property  (nonatomic, assign, nullable) Class        entityClass;
+/// The number of rows affected by a set based update or delete, raised from SRKQuery 'updateSet:' or 'deleteAll'.
+@property  uint64_t                                   affectedRows;
 
 @end
 
@@ -864,6 +1156,18 @@ typedef void(^SRKQueryAsyncResponse)(SRKResultSet* _Nonnull results);
  * @return (SRKQuery*) this value can be discarded or used to nest queries together to form clear and concise statements.
  */
 - (nonnull SRKQuery*)batchSize:(int)batchSize;
+/**
+ * Specifies that a set based 'updateSet:' or 'deleteAll' should find out which rows it is going to change, so that live objects in the registry can be updated and their individual events raised.  Without this only the table level event is raised.
+ *
+ * @return (SRKQuery*) this value can be discarded or used to nest queries together to form clear and concise statements.
+ */
+- (nonnull SRKQuery*)captureChanges;
+/**
+ * Specifies that the objects returned by the query will only ever be used from one thread, as with 'entityIsThreadConfined' but for the results of this query alone.  The objects belong to the first thread that reads or writes one of their properties.
+ *
+ * @return (SRKQuery*) this value can be discarded or used to nest queries together to form clear and concise statements.
+ */
+- (nonnull SRKQuery*)threadConfined;
 /**
  * Specifies the managed object domain that the query results will be added to.
  
@@ -872,6 +1176,36 @@ typedef void(^SRKQueryAsyncResponse)(SRKResultSet* _Nonnull results);
  * @return (SRKQuery*) this value can be discarded or used to nest queries together to form clear and concise statements.
  */
 - (nonnull SRKQuery*)domain:(nonnull NSString*)domain;
+/**
+ * Restricts the results to objects within a given distance of a point.  If a spatial index has been defined for the properties it is used to pre-filter the rows, before the exact distance is checked.  This condition is combined with any WHERE clause.
+ *
+ * @param metres The radius of the search, in metres.
+ * @param latitude The latitude of the centre point.
+ * @param longitude The longitude of the centre point.
+ * @param latitudeProperty The name of the property which holds the latitude of the object.
+ * @param longitudeProperty The name of the property which holds the longitude of the object.
+ * @return (SRKQuery*) this value can be discarded or used to nest queries together to form clear and concise statements.
+ */
+- (nonnull SRKQuery*)withinRadius:(double)metres ofLatitude:(double)latitude longitude:(double)longitude latitudeProperty:(nonnull NSString*)latitudeProperty longitudeProperty:(nonnull NSString*)longitudeProperty;
+/**
+ * Restricts the results to objects within a bounding box.  If a spatial index has been defined for the properties it is used to pre-filter the rows.  This condition is combined with any WHERE clause.
+ *
+ * @param minLatitude The southern edge of the box.
+ * @param minLongitude The western edge of the box, if this is greater than the eastern edge the box is assumed to cross the antimeridian.
+ * @param maxLatitude The northern edge of the box.
+ * @param maxLongitude The eastern edge of the box.
+ * @param latitudeProperty The name of the property which holds the latitude of the object.
+ * @param longitudeProperty The name of the property which holds the longitude of the object.
+ * @return (SRKQuery*) this value can be discarded or used to nest queries together to form clear and concise statements.
+ */
+- (nonnull SRKQuery*)withinBoundingBoxFromLatitude:(double)minLatitude longitude:(double)minLongitude toLatitude:(double)maxLatitude longitude:(double)maxLongitude latitudeProperty:(nonnull NSString*)latitudeProperty longitudeProperty:(nonnull NSString*)longitudeProperty;
+/**
+ * Restricts the results to objects matching a full text search expression, using the entity's full text index, and orders them by relevance ahead of any other ordering.  The expression uses the SQLite FTS syntax, e.g. "shark*", "name:adrian" or "\"exact phrase\"".
+ *
+ * @param expression The full text search expression.
+ * @return (SRKQuery*) this value can be discarded or used to nest queries together to form clear and concise statements.
+ */
+- (nonnull SRKQuery*)match:(nonnull NSString*)expression;
 /**
  * Used to include "joined" data within the query string, you must use the tablename.columnname syntax within a where statement
  
@@ -979,6 +1313,27 @@ typedef void(^SRKQueryAsyncResponse)(SRKResultSet* _Nonnull results);
  * @return (int)count .
  */
 - (uint64_t)count;
+/**
+ * Removes all of the rows that match the query with a single DELETE statement, without loading any of the entities.  A single SharkORMEventDelete event is raised against the table with the number of rows removed, and if 'captureChanges' has been specified, live objects are notified individually.
+ *
+ * @return (uint64_t) the number of rows removed.
+ */
+- (uint64_t)deleteAll;
+/**
+ * Updates all of the rows that match the query with a single UPDATE statement, without loading any of the entities.  A single SharkORMEventUpdate event is raised against the table with the number of rows changed, and if 'captureChanges' has been specified, live objects are updated with the new values and notified individually.
+ *
+ * @param (NSDictionary*)values in the format [<property as string>:<value as Any>], use NSNull to set a property to nil.  Encrypted properties and the primary key can not be updated this way.
+ * @return (uint64_t) the number of rows updated.
+ */
+- (uint64_t)updateSet:(nonnull NSDictionary<NSString*,id>*)values;
+/**
+ * Streams the results of the query to an output stream as CSV or JSON-lines, without loading any of the entities.  Rows are formatted straight from the database into a buffer which is written out as it fills, so memory use does not grow with the number of rows.  Values are written as they are stored, so dates are exported as numbers when 'useEpochDates' is set and binary data as base64.
+ *
+ * @param (NSOutputStream*)stream The stream to write to, it is opened if it has not been already and is left open.
+ * @param (SRKExportFormat)format The layout to write the rows in.
+ * @return (uint64_t) the number of rows exported, or 0 if the stream could not be written to.
+ */
+- (uint64_t)exportTo:(nonnull NSOutputStream*)stream format:(SRKExportFormat)format;
 /**
  * Performs the query and returns an array of distinct values of the specified property name.
  *
@@ -1044,6 +1399,7 @@ typedef void(^SRKQueryAsyncResponse)(SRKResultSet* _Nonnull results);
 @interface SRKIndexProperty : NSObject
 
 @property (strong, nullable) NSString*   name;
+@property (strong, nullable) NSString*   expression;
 @property enum SRKIndexSortOrder order;
 
 /**
@@ -1077,6 +1433,16 @@ typedef void(^SRKQueryAsyncResponse)(SRKResultSet* _Nonnull results);
  */
 -(nonnull instancetype) initWithName:(nonnull NSString*)columnName;
 
+/**
+ * Initializes a new SRKIndexProperty object which indexes the result of an expression rather than a plain column, e.g. "lower(Name)" or "date(created, 'unixepoch')".  Queries must use the exact same expression for SQLite to make use of the index.
+ *
+ * @param (NSString*)expression The SQL expression to be indexed, this must be deterministic.
+ * @param (NSString*)name A name for the expression, used to generate the name of the index
+ * @param (enum SRKIndexSortOrder)sortOrder The direction in which the index should sort
+ * @return (id)
+ */
+-(nonnull instancetype) initWithExpression:(nonnull NSString*)expression named:(nonnull NSString*)name andOrder:(enum SRKIndexSortOrder) sortOrder;
+
 @end
 
 #define SHARKSYNC_DEFAULT_GROUP @"__default__"
@@ -126,6 +126,70 @@
     
 }
 
+- (void)test_event_set_based_update_and_delete {
+    
+    [self cleardown];
+    
+    Person* p1 = [Person new];
+    p1.Name = @"Adam";
+    p1.age = 10;
+    [p1 commit];
+    
+    Person* p2 = [Person new];
+    p2.Name = @"Bob";
+    p2.age = 20;
+    [p2 commit];
+    
+    __block uint64_t affected = 0;
+    __block BOOL objectUpdated = NO;
+    
+    SRKEventHandler* handler = [Person eventHandler];
+    [handler registerBlockForEvents:SharkORMEventUpdate|SharkORMEventDelete withBlock:^(SRKEvent *event) {
+        affected = event.affectedRows;
+    } onMainThread:YES];
+    
+    [p1 registerBlockForEvents:SharkORMEventUpdate withBlock:^(SRKEvent *event) {
+        objectUpdated = YES;
+    } onMainThread:YES];
+    
+    XCTAssert([[[[Person query] where:@"age < 50"] captureChanges] updateSet:@{@"age" : @(50)}] == 2, @"set based update did not change the expected number of rows");
+    XCTAssert(affected == 2, @"table event was not raised with the number of affected rows");
+    XCTAssert(objectUpdated && p1.age == 50, @"live object was not updated by a captured set based update");
+    XCTAssert([[[Person query] where:@"age = 50"] count] == 2, @"set based update did not persist");
+    
+    XCTAssert([[[Person query] where:@"Name = ?" parameters:@[@"Adam"]] deleteAll] == 1, @"set based delete did not remove the expected number of rows");
+    XCTAssert(affected == 1, @"table event was not raised with the number of affected rows");
+    XCTAssert([[Person query] count] == 1, @"set based delete removed the wrong rows");
+    
+}
+
+- (void)test_registry_updates_live_twins {
+    
+    [self cleardown];
+    
+    Person* p = [Person new];
+    p.Name = @"Original";
+    [p commit];
+    
+    Person* twin1 = [[[Person query] domain:@"registry"] fetch].firstObject;
+    Person* twin2 = [[[Person query] domain:@"registry"] fetch].firstObject;
+    
+    // instances of the record that are released along the way drop out of the registry on their own
+    @autoreleasepool {
+        for (int i = 0; i < 100; i++) {
+            Person* released = [[[Person query] domain:@"registry"] fetch].firstObject;
+            released = nil;
+        }
+    }
+    
+    twin1.Name = @"Changed";
+    [twin1 commit];
+    
+    XCTAssert([twin2.Name isEqualToString:@"Changed"], @"live twin in the same domain was not updated");
+    XCTAssert([p.Name isEqualToString:@"Original"], @"object outside of the domain was updated");
+    
+}
+
 - (void)test_event_simple_object_update_event_multithreaded {
     
     [self cleardown];
@@ -257,4 +321,41 @@
     
 }
 
+- (void)test_event_coalescing_batches_updates_without_blocking {
+    
+    [self cleardown];
+    
+    [[SharkORM settings] setEventCoalescingWindow:0.2];
+    
+    __block int batches = 0;
+    __block NSArray* lastBatch = nil;
+    dispatch_semaphore_t delivered = dispatch_semaphore_create(0);
+    
+    SRKEventHandler* handler = [Person eventHandler];
+    [handler registerBlockForEvents:SharkORMEventUpdate withBatchBlock:^(NSArray<SRKEvent *> *events) {
+        batches++;
+        lastBatch = events;
+        dispatch_semaphore_signal(delivered);
+    } onQueue:dispatch_queue_create("events.test", DISPATCH_QUEUE_SERIAL)];
+    
+    Person* p = [Person new];
+    [p commit];
+    
+    for (int i = 0; i < 100; i++) {
+        p.age = i;
+        [p commit];
+    }
+    
+    XCTAssert(dispatch_semaphore_wait(delivered, dispatch_time(DISPATCH_TIME_NOW, 5 * NSEC_PER_SEC)) == 0, @"coalesced events were not delivered");
+    [NSThread sleepForTimeInterval:0.5];
+    
+    XCTAssert(batches < 100, @"updates were not coalesced into batches");
+    XCTAssert(lastBatch.count == 1, @"updates to the same object were not merged into a single event");
+    XCTAssert([((SRKEvent*)lastBatch.firstObject).changedProperties containsObject:@"age"], @"merged event lost its changed properties");
+    
+    [handler clearAllRegisteredBlocks];
+    [[SharkORM settings] setEventCoalescingWindow:0];
+    
+}
+
 @end
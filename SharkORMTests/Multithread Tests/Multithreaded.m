@@ -174,4 +174,96 @@
     
 }
 
+- (void)test_queries_use_read_connections {
+    
+    [self cleardown];
+    
+    Person* p = [Person new];
+    p.Name = @"Committed";
+    [p commit];
+    
+    /* an open write on the writer connection is invisible to queries, as they run on one of the read connections */
+    [SharkORM rawQuery:@"BEGIN IMMEDIATE TRANSACTION;"];
+    [SharkORM rawQuery:@"INSERT INTO Person (Name) VALUES ('Uncommitted');"];
+    
+    __block uint64_t backgroundCount = 0;
+    dispatch_sync(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        backgroundCount = [[Person query] count];
+    });
+    
+    XCTAssert([[Person query] count] == 1, @"query did not run on a read connection");
+    XCTAssert(backgroundCount == 1, @"query on another thread was not isolated from the open write");
+    
+    [SharkORM rawQuery:@"ROLLBACK;"];
+    
+    /* within a transaction, queries see what the transaction has written so far */
+    [SRKTransaction transaction:^{
+        Person* t = [Person new];
+        t.Name = @"Transaction";
+        [t commit];
+        XCTAssert([[Person query] count] == 2, @"query within a transaction did not see its own changes");
+    } withRollback:^{
+        
+    }];
+    
+}
+
+- (void)test_read_snapshot_is_consistent {
+    
+    [self cleardown];
+    
+    Person* p = [Person new];
+    p.Name = @"Before";
+    p.age = 10;
+    [p commit];
+    
+    [SharkORM readSnapshot:^{
+        
+        XCTAssert([[Person query] count] == 1, @"snapshot did not see the committed data");
+        
+        /* a writer on another thread is not held up by the snapshot */
+        dispatch_sync(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            Person* w = [Person new];
+            w.Name = @"During";
+            w.age = 20;
+            XCTAssert([w commit], @"write was blocked by a read snapshot");
+        });
+        
+        XCTAssert([[Person query] count] == 1, @"snapshot saw a commit made after it started");
+        XCTAssert([[Person query] sumOf:@"age"] == 10, @"queries within a snapshot were not consistent");
+        
+    }];
+    
+    XCTAssert([[Person query] count] == 2, @"commit made during a snapshot was not visible afterwards");
+    
+}
+
+- (void)test_read_snapshot_released_when_block_throws {
+    
+    [self cleardown];
+    
+    for (NSUInteger i = 0; i <= [SharkORM settings].readConnections; i++) {
+        @try {
+            [SharkORM readSnapshot:^{
+                [[Person query] count];
+                @throw [NSException exceptionWithName:@"SnapshotTest" reason:@"thrown within a snapshot" userInfo:nil];
+            }];
+        } @catch (NSException* exception) {
+            
+        }
+    }
+    
+    // every reader in the pool has been through a failed snapshot, they must all have been handed back out of their read transactions
+    Person* p = [Person new];
+    p.Name = @"After";
+    [p commit];
+    
+    for (NSUInteger i = 0; i <= [SharkORM settings].readConnections; i++) {
+        XCTAssert([[Person query] count] == 1, @"a reader was left inside the snapshot of a block which threw");
+    }
+    
+    [self cleardown];
+    
+}
+
 @end
@@ -22,6 +22,7 @@
 
 
 #import "OtherTests.h"
+#import <sqlite3.h>
 
 @implementation OtherTests
 
@@ -58,4 +59,47 @@
     XCTAssert(p2.Name == nil, @"failed to clear name");
 }
 
+- (void)test_busy_statistics {
+    
+    [SharkORM resetBusyStatistics];
+    
+    Person* p = [Person new];
+    p.Name = @"Uncontended";
+    [p commit];
+    
+    SRKBusyStatistics* stats = [SharkORM busyStatistics];
+    XCTAssert(stats.contentionEvents == 0 && stats.timeouts == 0 && stats.totalWaitTime == 0, @"contention recorded for an uncontended commit");
+    XCTAssert(stats.waitHistogram.count == 5, @"wait histogram has the wrong number of buckets");
+    XCTAssert([SharkORM settings].busyTimeout > 0, @"busy timeout should default to a non-zero wait");
+    
+    // a second connection holds the write lock, so the commit below has to wait for it to be released
+    NSString* path = [[SharkORM settings].databaseLocation stringByAppendingPathComponent:@"Persistence.db"];
+    sqlite3* blocker = nil;
+    XCTAssert(sqlite3_open(path.UTF8String, &blocker) == SQLITE_OK, @"failed to open a second connection to the database");
+    XCTAssert(sqlite3_exec(blocker, "BEGIN IMMEDIATE;", NULL, NULL, NULL) == SQLITE_OK, @"second connection failed to take the write lock");
+    
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(0.25 * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        sqlite3_exec(blocker, "COMMIT;", NULL, NULL, NULL);
+    });
+    
+    p = [Person new];
+    p.Name = @"Contended";
+    XCTAssert([p commit], @"commit failed whilst waiting for the other connection");
+    
+    sqlite3_close(blocker);
+    
+    stats = [SharkORM busyStatistics];
+    XCTAssert(stats.contentionEvents > 0, @"contention was not recorded whilst the database was locked");
+    XCTAssert(stats.retries > 0, @"no retries were recorded whilst the database was locked");
+    XCTAssert(stats.totalWaitTime > 0, @"no wait time was recorded whilst the database was locked");
+    XCTAssert(stats.timeouts == 0, @"commit timed out before the other connection released the database");
+    
+    uint64_t bucketed = 0;
+    for (NSNumber* count in stats.waitHistogram) {
+        bucketed += count.unsignedLongLongValue;
+    }
+    XCTAssert(bucketed == stats.contentionEvents, @"each contention event should be counted once in the wait histogram, as soon as its wait ended");
+    
+}
+
 @end
@@ -43,6 +43,86 @@
     
 }
 
+- (void)test_Update_Only_Writes_Modified_Properties {
+    
+    [self cleardown];
+    
+    Person* p = [Person new];
+    p.Name = @"Adrian";
+    p.age = 37;
+    [p commit];
+    
+    /* change a column behind the back of the object, an update of a different property should leave it alone */
+    [SharkORM rawQuery:[NSString stringWithFormat:@"UPDATE Person SET age = 40 WHERE Id = %@", p.Id]];
+    
+    p.Name = @"Sarah";
+    XCTAssert([p commit],@"Failed to update existing record with new values");
+    
+    Person* p2 = [[Person query] fetch].firstObject;
+    XCTAssert([p2.Name isEqualToString:@"Sarah"],@"Non current value retrieved from store");
+    XCTAssert(p2.age == 40,@"Update re-wrote properties which had not been modified");
+    
+}
+
+- (void)test_Bulk_Commit_And_Remove {
+    
+    [self cleardown];
+    
+    NSMutableArray* people = [NSMutableArray new];
+    for (int i = 0; i < 100; i++) {
+        Person* p = [Person new];
+        p.Name = [NSString stringWithFormat:@"Person %i", i];
+        p.age = i;
+        [people addObject:p];
+    }
+    
+    NSArray* ids = [SRKEntity commitAll:people];
+    XCTAssert(ids.count == 100, @"Bulk commit did not return an Id for each object");
+    XCTAssert([Person query].count == 100, @"Bulk commit did not insert all of the objects");
+    XCTAssert([ids.lastObject isEqual:((Person*)people.lastObject).Id], @"Returned Id's do not match the committed objects");
+    
+    ((Person*)people.firstObject).age = 200;
+    [SRKEntity commitAll:people];
+    XCTAssert([[Person query] where:@"age = 200"].count == 1, @"Bulk commit did not update the modified object");
+    XCTAssert([Person query].count == 100, @"Bulk commit of existing objects inserted new rows");
+    
+    XCTAssert([SRKEntity removeAll:people], @"Bulk remove failed");
+    XCTAssert([Person query].count == 0, @"Bulk remove left objects in the table");
+    
+}
+
+- (void)test_Group_Commit_And_Flush {
+    
+    [self cleardown];
+    
+    [SharkORM settings].groupCommitWindow = 0.05;
+    
+    __block int written = 0;
+    Person* repeated = nil;
+    for (int i = 0; i < 20; i++) {
+        Person* p = [Person new];
+        p.Name = [NSString stringWithFormat:@"Person %i", i];
+        p.commitOptions.postCommitBlock = ^{
+            written++;
+        };
+        [p commit];
+        repeated = p;
+    }
+    
+    // a second commit of a queued object should be merged into the first
+    repeated.age = 99;
+    [repeated commit];
+    
+    [SharkORM flush];
+    
+    XCTAssert([[Person query] count] == 20, @"group commit did not write every queued object");
+    XCTAssert(written == 20, @"post commit blocks were not called once for each object");
+    XCTAssert([[[Person query] where:@"age = 99"] count] == 1, @"merged commit did not write the latest values");
+    
+    [SharkORM settings].groupCommitWindow = 0;
+    
+}
+
 - (void)test_Simple_Object_Delete {
     
     [self cleardown];
@@ -189,6 +269,134 @@
     
 }
 
+- (void)test_time_ordered_string_pk {
+    
+    [SharkORM getSettings].primaryKeyFormat = SRKPrimaryKeyFormatULID;
+    
+    NSString* previous = nil;
+    for (int i = 0; i < 50; i++) {
+        StringIdObject* obj = [StringIdObject new];
+        obj.value = @"ordered";
+        [obj commit];
+        XCTAssert(obj.Id.length == 26, @"ULID primary key was not generated");
+        XCTAssert(!previous || [previous compare:obj.Id] == NSOrderedAscending, @"generated keys were not in ascending order");
+        previous = obj.Id;
+    }
+    
+    [SharkORM getSettings].primaryKeyFormat = SRKPrimaryKeyFormatUUIDv7;
+    StringIdObject* obj = [StringIdObject new];
+    [obj commit];
+    XCTAssert(obj.Id.length == 36 && [obj.Id characterAtIndex:14] == '7', @"UUIDv7 primary key was not generated");
+    
+    [SharkORM getSettings].primaryKeyGenerator = ^NSString*(Class entityClass) {
+        return [NSString stringWithFormat:@"%@-%@", entityClass, [[NSUUID UUID] UUIDString]];
+    };
+    obj = [StringIdObject new];
+    [obj commit];
+    XCTAssert([obj.Id hasPrefix:@"StringIdObject-"], @"custom primary key generator was not used");
+    XCTAssert([StringIdObject objectWithPrimaryKeyValue:obj.Id] != nil, @"Retrieval of object with a generated PK value failed");
+    
+    [SharkORM getSettings].primaryKeyGenerator = nil;
+    [SharkORM getSettings].primaryKeyFormat = SRKPrimaryKeyFormatUUID;
+    
+}
+
+- (void)test_context_commits_only_changes {
+    
+    [self cleardown];
+    
+    for (int i = 0; i < 10; i++) {
+        Person* p = [Person new];
+        p.Name = @"Unchanged";
+        p.seq = i;
+        [p commit];
+    }
+    
+    SRKContext* context = [SRKContext new];
+    for (Person* p in [[Person query] fetch]) {
+        [context addEntityToContext:p];
+        if (p.seq == 3) {
+            p.Name = @"Changed";
+        }
+    }
+    
+    Person* inserted = [Person new];
+    inserted.Name = @"New";
+    [context addEntityToContext:inserted];
+    
+    XCTAssert([context commit], @"context failed to commit");
+    XCTAssert(context.lastCommitSummary.inserted.count == 1 && context.lastCommitSummary.updated.count == 1, @"context wrote objects which had not changed");
+    XCTAssert(context.lastCommitSummary.unchanged == 9, @"unchanged objects were not skipped");
+    XCTAssert([[[Person query] where:@"Name = 'Changed'"] count] == 1, @"changed object in the context was not written");
+    XCTAssert([Person query].count == 11, @"new object in the context was not written");
+    
+}
+
+- (void)test_streaming_import {
+    
+    [self cleardown];
+    
+    NSString* csvPath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"import_test.csv"];
+    [@"name,AGE,seq,unknown\r\nAdrian,38,1,x\r\n\"Smith, John\",40,2,x\r\n\"Line\nBreak \"\"quoted\"\"\",41,3,x\r\nLast,42,4,x" writeToFile:csvPath atomically:YES encoding:NSUTF8StringEncoding error:nil];
+    
+    __block int batches = 0;
+    SRKImportOptions* options = [SRKImportOptions new];
+    options.batchSize = 3;
+    options.deferIndexes = YES;
+    options.progress = ^(uint64_t recordsImported, uint64_t bytesRead, uint64_t totalBytes) {
+        batches++;
+    };
+    
+    XCTAssert([Person importFromFile:csvPath format:SRKImportFormatCSV options:options] == 4, @"csv import did not write every record");
+    XCTAssert(batches == 2, @"progress was not reported for each batch");
+    XCTAssert([[[Person query] where:@"Name = 'Smith, John' AND age = 40"] count] == 1, @"quoted csv field was not parsed");
+    XCTAssert([[[Person query] where:@"Name = 'Line\nBreak \"quoted\"'"] count] == 1, @"csv field with a line break and quotes was not parsed");
+    
+    NSString* jsonPath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"import_test.jsonl"];
+    [@"{\"Name\":\"Json\",\"age\":50}\n\n{\"years\":51}\n" writeToFile:jsonPath atomically:YES encoding:NSUTF8StringEncoding error:nil];
+    
+    options = [SRKImportOptions new];
+    options.columnMapping = @{@"years" : @"age"};
+    XCTAssert([Person importFromFile:jsonPath format:SRKImportFormatJSONLines options:options] == 2, @"json-lines import did not write every record");
+    XCTAssert([[[Person query] where:@"age = 51"] count] == 1, @"column mapping was not applied");
+    XCTAssert([Person query].count == 6, @"import wrote an unexpected number of rows");
+    
+    [[NSFileManager defaultManager] removeItemAtPath:csvPath error:nil];
+    [[NSFileManager defaultManager] removeItemAtPath:jsonPath error:nil];
+    
+}
+
+- (void)test_thread_confined_objects {
+    
+    [self cleardown];
+    
+    for (int i = 0; i < 10; i++) {
+        Person* p = [Person new];
+        p.Name = @"Confined";
+        p.age = i;
+        [p commit];
+    }
+    
+    SRKResultSet* results = [[[[Person query] where:@"Name = 'Confined'"] order:@"age"] threadConfined].fetch;
+    XCTAssert(results.count == 10, @"thread confined fetch did not return every object");
+    
+    int total = 0;
+    for (Person* p in results) {
+        int age = p.age;
+        total += age;
+        p.age = age * 2;
+        XCTAssert(p.age == age * 2 && [p.Name isEqualToString:@"Confined"], @"thread confined object did not read back its values");
+    }
+    XCTAssert(total == 45, @"thread confined objects returned the wrong values");
+    
+    Person* p = results.firstObject;
+    p.age = 100;
+    XCTAssert(p.age == 100, @"thread confined object did not read back a changed value");
+    XCTAssert([p commit], @"failed to commit a thread confined object");
+    XCTAssert([[[Person query] where:@"age = 100"] count] == 1, @"thread confined object was not written");
+    
+}
+
 - (void)test_initial_values {
     
     [self cleardown];
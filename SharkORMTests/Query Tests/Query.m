@@ -353,4 +353,107 @@
     
 }
 
+- (void)test_spatial_radius_query {
+    
+    [self cleardown];
+    
+    Location* l = [Location new];
+    l.locationName = @"Alton";
+    l.latitude = 51.1498;
+    l.longitude = -0.9769;
+    [l commit];
+    
+    l = [Location new];
+    l.locationName = @"Farnham";
+    l.latitude = 51.2147;
+    l.longitude = -0.7989;
+    [l commit];
+    
+    l = [Location new];
+    l.locationName = @"Edinburgh";
+    l.latitude = 55.9533;
+    l.longitude = -3.1883;
+    [l commit];
+    
+    SRKResultSet* r = [[[Location query] withinRadius:5000 ofLatitude:51.1498 longitude:-0.9769 latitudeProperty:@"latitude" longitudeProperty:@"longitude"] fetch];
+    XCTAssert(r.count == 1, @"incorrect number of results returned for radius query");
+    
+    r = [[[Location query] withinRadius:20000 ofLatitude:51.1498 longitude:-0.9769 latitudeProperty:@"latitude" longitudeProperty:@"longitude"] fetch];
+    XCTAssert(r.count == 2, @"incorrect number of results returned for radius query");
+    
+    r = [[[[Location query] where:@"locationName = 'Farnham'"] withinRadius:20000 ofLatitude:51.1498 longitude:-0.9769 latitudeProperty:@"latitude" longitudeProperty:@"longitude"] fetch];
+    XCTAssert(r.count == 1, @"radius query did not combine with the where clause");
+    
+    /* move a location and make sure the index follows it */
+    l.latitude = 51.15;
+    l.longitude = -0.98;
+    [l commit];
+    
+    r = [[[Location query] withinRadius:5000 ofLatitude:51.1498 longitude:-0.9769 latitudeProperty:@"latitude" longitudeProperty:@"longitude"] fetch];
+    XCTAssert(r.count == 2, @"spatial index was not updated on commit");
+    
+    [l remove];
+    
+    r = [[[Location query] withinBoundingBoxFromLatitude:50.0 longitude:-2.0 toLatitude:52.0 longitude:0.0 latitudeProperty:@"latitude" longitudeProperty:@"longitude"] fetch];
+    XCTAssert(r.count == 2, @"incorrect number of results returned for bounding box query");
+    
+}
+
+- (void)test_full_text_match_query {
+    
+    [self setupCommonData];
+    
+    SRKResultSet *r = [[Person query] match:@"Adrian"].fetch;
+    XCTAssert(r.count == 1, @"incorrect number of results returned for full text match");
+    XCTAssert([((Person*)r[0]).Name isEqualToString:@"Adrian"], @"incorrect object returned for full text match");
+    
+    r = [[Person query] match:@"Mich*"].fetch;
+    XCTAssert(r.count == 1, @"incorrect number of results returned for prefix match");
+    
+    r = [[[Person query] where:@"age > 35"] match:@"Neil OR Adrian"].fetch;
+    XCTAssert(r.count == 1, @"full text match did not combine with the where clause");
+    XCTAssert([[[[Person query] where:@"Name = 'Adrian'"] match:@"Adrian"] count] == 1, @"full text match could not be counted alongside a where clause on an indexed property");
+    
+    /* the index should follow updates and removals */
+    Person* p = [[[Person query] where:@"Name = 'Neil'"] fetch].firstObject;
+    p.Name = @"Neil Adrian";
+    [p commit];
+    
+    r = [[Person query] match:@"Adrian"].fetch;
+    XCTAssert(r.count == 2, @"full text index was not updated on commit");
+    XCTAssert([((Person*)r[0]).Name isEqualToString:@"Adrian"] || [((Person*)r[0]).Name isEqualToString:@"Neil Adrian"], @"incorrect object returned for ranked match");
+    
+    [p remove];
+    
+    r = [[Person query] match:@"Neil"].fetch;
+    XCTAssert(r.count == 0, @"full text index was not updated on remove");
+    
+}
+
+- (void)test_streaming_export {
+    
+    [self setupCommonData];
+    
+    Person* p = [[[Person query] where:@"Name = 'Neil'"] fetch].firstObject;
+    p.Name = @"Neil \"Quoted\", Jr";
+    [p commit];
+    
+    NSOutputStream* stream = [NSOutputStream outputStreamToMemory];
+    XCTAssert([[[Person query] order:@"age"] exportTo:stream format:SRKExportFormatCSV] == 3, @"csv export did not write every row");
+    NSString* csv = [[NSString alloc] initWithData:[stream propertyForKey:NSStreamDataWrittenToMemoryStreamKey] encoding:NSUTF8StringEncoding];
+    XCTAssert([[csv componentsSeparatedByString:@"\r\n"].firstObject rangeOfString:@"Name"].location != NSNotFound, @"csv export did not start with a header");
+    XCTAssert([csv rangeOfString:@"\"Neil \"\"Quoted\"\", Jr\""].location != NSNotFound, @"csv value was not quoted");
+    [stream close];
+    
+    stream = [NSOutputStream outputStreamToMemory];
+    XCTAssert([[[Person query] where:@"age < 35"] exportTo:stream format:SRKExportFormatJSONLines] == 2, @"json-lines export did not write the matching rows");
+    NSString* json = [[NSString alloc] initWithData:[stream propertyForKey:NSStreamDataWrittenToMemoryStreamKey] encoding:NSUTF8StringEncoding];
+    NSArray* lines = [[json stringByTrimmingCharactersInSet:[NSCharacterSet newlineCharacterSet]] componentsSeparatedByString:@"\n"];
+    XCTAssert(lines.count == 2, @"json-lines export did not write a line per row");
+    NSDictionary* row = [NSJSONSerialization JSONObjectWithData:[lines.firstObject dataUsingEncoding:NSUTF8StringEncoding] options:0 error:nil];
+    XCTAssert([row[@"age"] intValue] < 35 && row[@"Name"], @"json-lines export did not write a valid object");
+    [stream close];
+    
+}
+
 @end
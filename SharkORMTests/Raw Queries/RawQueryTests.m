@@ -45,4 +45,17 @@
 }
 
 
+- (void)test_raw_date_functions {
+    
+    NSNumber* epoch = [[SharkORM rawQuery:@"SELECT dateFromString('2016-03-01 12:30:45') AS d;"] valueForColumn:@"d" atRow:0];
+    XCTAssert([epoch isKindOfClass:[NSNumber class]], @"dateFromString, class type is incorrect");
+    
+    NSString* formatted = [[SharkORM rawQuery:[NSString stringWithFormat:@"SELECT stringFromDate(%f) AS s;", epoch.doubleValue]] valueForColumn:@"s" atRow:0];
+    XCTAssert([formatted isEqualToString:@"2016-03-01 12:30:45"], @"stringFromDate, did not round trip the value");
+    
+    XCTAssert([[[SharkORM rawQuery:@"SELECT dateFromString('2016-02-31 12:30:45') AS d;"] valueForColumn:@"d" atRow:0] isKindOfClass:[NSNull class]], @"dateFromString, invalid date should return null");
+    XCTAssert([[[SharkORM rawQuery:@"SELECT dateFromString('not a date') AS d;"] valueForColumn:@"d" atRow:0] isKindOfClass:[NSNull class]], @"dateFromString, invalid text should return null");
+    
+}
+
 @end
@@ -23,6 +23,22 @@
 
 #import "BaseTestCase.h"
 
+@class RelationshipHookChild;
+
+@interface RelationshipHookParent : SRKObject
+
+@property (strong) NSString* name;
+@property (strong) RelationshipHookChild* child;
+
+@end
+
+@interface RelationshipHookChild : SRKObject
+
+@property (strong) NSString* name;
+@property (strong) RelationshipHookParent* parent;
+
+@end
+
 @interface Relationship : BaseTestCase
 
 @end
@@ -23,6 +23,34 @@
 
 #import "Relationship.h"
 
+static NSMutableArray* hookOrder = nil;
+
+@implementation RelationshipHookParent
+
+@dynamic name,child;
+
++ (NSArray *)uniquePropertiesForClass {
+    return @[@"name"];
+}
+
+- (BOOL)entityWillInsert {
+    [hookOrder addObject:@"parent"];
+    return YES;
+}
+
+@end
+
+@implementation RelationshipHookChild
+
+@dynamic name,parent;
+
+- (BOOL)entityWillInsert {
+    [hookOrder addObject:@"child"];
+    return YES;
+}
+
+@end
+
 @implementation Relationship
 
 - (void)setupCommonData {
@@ -149,4 +177,101 @@
     XCTAssert([p2.location.locationName isEqualToString:@"San Francisco"], @"an object was loaded, when there should be nothing");
 }
 
+- (void)test_commit_large_object_graph {
+    
+    [self cleardown];
+    
+    NSMutableArray* people = [NSMutableArray new];
+    for (int i = 0; i < 1000; i++) {
+        Location* l = [Location new];
+        l.locationName = [NSString stringWithFormat:@"Location %i", i];
+        Department* d = [Department new];
+        d.name = [NSString stringWithFormat:@"Department %i", i];
+        d.location = l;
+        Person* p = [Person new];
+        p.Name = [NSString stringWithFormat:@"Person %i", i];
+        p.seq = i;
+        p.department = d;
+        p.location = l;
+        [people addObject:p];
+    }
+    
+    XCTAssert([Person commitAll:people], @"failed to commit the object graph");
+    XCTAssert([Person query].count == 1000 && [Department query].count == 1000 && [Location query].count == 1000, @"not every object in the graph was written");
+    
+    Person* p = [[[Person query] where:@"seq = 500"] fetch].firstObject;
+    XCTAssert([p.department.name isEqualToString:@"Department 500"], @"foreign key was not set before the graph was written");
+    XCTAssert([p.department.location.locationName isEqualToString:@"Location 500"], @"foreign key was not set before the graph was written");
+    XCTAssert(p.location.Id && [p.location.Id isEqual:p.department.location.Id], @"shared related object was written more than once");
+    
+}
+
+- (void)test_commit_graph_hook_order {
+    
+    [SharkORM rawQuery:@"DELETE FROM RelationshipHookParent;"];
+    [SharkORM rawQuery:@"DELETE FROM RelationshipHookChild;"];
+    hookOrder = [NSMutableArray new];
+    
+    RelationshipHookChild* child = [RelationshipHookChild new];
+    child.name = @"child";
+    RelationshipHookParent* parent = [RelationshipHookParent new];
+    parent.name = @"parent";
+    parent.child = child;
+    
+    XCTAssert([parent commit], @"failed to commit the object graph");
+    XCTAssert([hookOrder isEqualToArray:@[@"parent", @"child"]], @"the parent was not asked before its related objects were written");
+    
+}
+
+- (void)test_commit_graph_cycle_raises_second_write {
+    
+    [SharkORM rawQuery:@"DELETE FROM RelationshipHookParent;"];
+    [SharkORM rawQuery:@"DELETE FROM RelationshipHookChild;"];
+    hookOrder = [NSMutableArray new];
+    
+    __block BOOL updated = NO;
+    SRKEventHandler* handler = [RelationshipHookChild eventHandler];
+    [handler registerBlockForEvents:SharkORMEventUpdate withBlock:^(SRKEvent *event) {
+        updated = YES;
+    } onMainThread:YES];
+    
+    RelationshipHookChild* child = [RelationshipHookChild new];
+    RelationshipHookParent* parent = [RelationshipHookParent new];
+    parent.child = child;
+    child.parent = parent;
+    
+    XCTAssert([parent commit], @"failed to commit the object graph");
+    
+    RelationshipHookChild* fetched = [[RelationshipHookChild query] fetch].firstObject;
+    XCTAssert(fetched.parent.Id && [fetched.parent.Id isEqual:parent.Id], @"the key within the cycle was not written");
+    XCTAssert(updated, @"the write completing the cycle did not raise an event");
+    
+    [handler clearAllRegisteredBlocks];
+    
+}
+
+- (void)test_commit_graph_failure_rolls_back_every_level {
+    
+    [SharkORM rawQuery:@"DELETE FROM RelationshipHookParent;"];
+    [SharkORM rawQuery:@"DELETE FROM RelationshipHookChild;"];
+    hookOrder = [NSMutableArray new];
+    
+    RelationshipHookParent* existing = [RelationshipHookParent new];
+    existing.name = @"taken";
+    XCTAssert([existing commit], @"failed to commit the existing object");
+    
+    // the child is written in the first level, then the parent fails on its unique name in the second
+    RelationshipHookChild* child = [RelationshipHookChild new];
+    child.name = @"orphan";
+    RelationshipHookParent* parent = [RelationshipHookParent new];
+    parent.name = @"taken";
+    parent.child = child;
+    
+    XCTAssert(![parent commit], @"commit of a graph with a duplicate unique value succeeded");
+    XCTAssert([[RelationshipHookChild query] count] == 0, @"an earlier level was kept when a later level failed");
+    XCTAssert(!child.exists && !child.Id, @"related object was left holding the key of a row which was rolled back");
+    XCTAssert([[RelationshipHookParent query] count] == 1, @"failed graph left a row behind");
+    
+}
+
 @end
@@ -30,5 +30,7 @@
 
 @property NSString* locationName;
 @property Department* department;
+@property double latitude;
+@property double longitude;
 
 @end
@@ -25,6 +25,10 @@
 
 @implementation Location
 
-@dynamic locationName, department;
+@dynamic locationName, department, latitude, longitude;
+
++ (SRKIndexDefinition *)indexDefinitionForEntity {
+    return [[SRKIndexDefinition new] addSpatialIndexForLatitude:@"latitude" longitude:@"longitude"];
+}
 
 @end
@@ -30,6 +30,42 @@
 
 @end
 
+@interface SchemaIndexObject : SRKObject
+
+@property (strong) NSString* code;
+@property (strong) NSString* name;
+@property BOOL active;
+@property int rank;
+
+@end
+
+@interface SchemaUniqueObject : SRKObject
+
+@property (strong) NSString* code;
+@property (strong) NSString* name;
+
+@end
+
+@interface SchemaClusteredObject : SRKStringObject
+
+@property (strong) NSString* code;
+@property (strong) NSString* name;
+
+@end
+
+@interface SchemaClusteredTextObject : SRKStringObject
+
+@property (strong) NSString* code;
+@property (strong) NSString* name;
+
+@end
+
+@interface SchemaStringTextObject : SRKStringObject
+
+@property (strong) NSString* name;
+
+@end
+
 @interface SchemaTests : BaseTestCase
 
 @end
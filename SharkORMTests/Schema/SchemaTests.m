@@ -33,8 +33,73 @@
 
 @end
 
+@implementation SchemaIndexObject
+
+@dynamic code,name,active,rank;
+
++ (SRKIndexDefinition *)indexDefinitionForEntity {
+    
+    SRKIndexDefinition* idx = [SRKIndexDefinition new];
+    [idx addUnique:@[@"code"]];
+    [idx addIndexWithProperties:@[[[SRKIndexProperty alloc] initWithName:@"rank" andOrder:SRKIndexSortOrderDescending]] include:@[@"name"] where:@"active = 1" unique:NO];
+    [idx addIndexWithProperties:@[[[SRKIndexProperty alloc] initWithExpression:@"lower(name)" named:@"lowername" andOrder:SRKIndexSortOrderAscending]] include:nil where:nil unique:NO];
+    return idx;
+    
+}
+
+@end
+
+@implementation SchemaUniqueObject
+
+@dynamic code,name;
+
++ (NSArray *)uniquePropertiesForClass {
+    return @[@"code"];
+}
+
+@end
+
+@implementation SchemaClusteredObject
+
+@dynamic code,name;
+
++ (NSArray *)clusteredPrimaryKeyForClass {
+    return @[@"code"];
+}
+
+@end
+
+@implementation SchemaClusteredTextObject
+
+@dynamic code,name;
+
++ (NSArray *)clusteredPrimaryKeyForClass {
+    return @[@"code"];
+}
+
++ (SRKIndexDefinition *)indexDefinitionForEntity {
+    return [[SRKIndexDefinition new] addFullTextIndexForProperties:@[@"name"]];
+}
+
+@end
+
+@implementation SchemaStringTextObject
+
+@dynamic name;
+
++ (SRKIndexDefinition *)indexDefinitionForEntity {
+    return [[SRKIndexDefinition new] addFullTextIndexForProperties:@[@"name"]];
+}
+
+@end
+
 @implementation SchemaTests
 
+- (void)databaseError:(SRKError *)error {
+    [super databaseError:error];
+    self.currentError = error;
+}
+
 - (void)test_ignored_properties {
     
     // reference the object to create the table
@@ -52,4 +117,246 @@
     
 }
 
+- (void)test_unique_partial_expression_indexes {
+    
+    // reference the object to create the table
+    SRKQuery* qry = [SchemaIndexObject query];
+    
+    SRKRawResults* results = [SharkORM rawQuery:@"SELECT * FROM sqlite_master WHERE type='index' AND tbl_name='SchemaIndexObject' AND sql LIKE 'CREATE UNIQUE INDEX%code%'"];
+    XCTAssert([results rowCount] == 1, @"unique index was not created");
+    
+    results = [SharkORM rawQuery:@"SELECT * FROM sqlite_master WHERE type='index' AND tbl_name='SchemaIndexObject' AND sql LIKE '%rank desc, name) WHERE active = 1'"];
+    XCTAssert([results rowCount] == 1, @"partial covering index was not created");
+    
+    results = [SharkORM rawQuery:@"SELECT * FROM sqlite_master WHERE type='index' AND tbl_name='SchemaIndexObject' AND sql LIKE '%(lower(name) asc)'"];
+    XCTAssert([results rowCount] == 1, @"expression index was not created");
+    
+    results = [SharkORM rawQuery:@"EXPLAIN QUERY PLAN SELECT name FROM SchemaIndexObject WHERE active = 1 ORDER BY rank DESC"];
+    XCTAssert([[[results valueForColumn:@"detail" atRow:0] description] rangeOfString:@"COVERING INDEX"].location != NSNotFound, @"partial covering index was not used");
+    
+    SchemaIndexObject* o = [SchemaIndexObject new];
+    o.code = @"A1";
+    [o commit];
+    
+    [SharkORM rawQuery:@"INSERT INTO SchemaIndexObject (code) VALUES ('A1');"];
+    XCTAssert([[SchemaIndexObject query] count] == 1, @"unique index did not prevent a duplicate");
+    
+    [SharkORM rawQuery:@"DELETE FROM SchemaIndexObject;"];
+    
+}
+
+- (void)test_unique_properties_conflict_policies {
+    
+    [SharkORM rawQuery:@"DELETE FROM SchemaUniqueObject;"];
+    
+    SRKRawResults* results = [SharkORM rawQuery:@"SELECT * FROM sqlite_master WHERE type='index' AND tbl_name='SchemaUniqueObject' AND sql LIKE 'CREATE UNIQUE INDEX%code%'"];
+    XCTAssert([results rowCount] == 1, @"unique properties were not backed by a unique index");
+    
+    SchemaUniqueObject* o1 = [SchemaUniqueObject new];
+    o1.code = @"A1";
+    o1.name = @"first";
+    XCTAssert([o1 commit], @"failed to commit the first object");
+    
+    SchemaUniqueObject* o2 = [SchemaUniqueObject new];
+    o2.code = @"A1";
+    o2.name = @"second";
+    o2.commitOptions.raiseErrors = NO;
+    XCTAssert(![o2 commit], @"duplicate was committed with the fail policy");
+    
+    o2.commitOptions.conflictPolicy = SRKConflictPolicyIgnore;
+    XCTAssert(![o2 commit] && !o2.exists, @"duplicate was committed with the ignore policy");
+    XCTAssert([[SchemaUniqueObject query] count] == 1, @"duplicate row was written");
+    
+    o2.commitOptions.conflictPolicy = SRKConflictPolicyReplace;
+    XCTAssert([o2 commit], @"duplicate was not written with the replace policy");
+    XCTAssert([[SchemaUniqueObject query] count] == 1, @"replace policy did not remove the conflicting row");
+    XCTAssert([((SchemaUniqueObject*)[[SchemaUniqueObject query] fetch].firstObject).name isEqualToString:@"second"], @"replace policy did not write the new values");
+    
+    [SharkORM rawQuery:@"DELETE FROM SchemaUniqueObject;"];
+    
+}
+
+- (void)test_context_commit_fails_on_conflict {
+    
+    [SharkORM rawQuery:@"DELETE FROM SchemaUniqueObject;"];
+    
+    SRKContext* context = [SRKContext new];
+    for (int i = 0; i < 2; i++) {
+        SchemaUniqueObject* o = [SchemaUniqueObject new];
+        o.code = @"C1";
+        o.commitOptions.raiseErrors = NO;
+        [context addEntityToContext:o];
+    }
+    
+    XCTAssert(![context commit], @"context reported success when one of its objects could not be written");
+    XCTAssert(context.lastCommitSummary == nil, @"failed context commit left a summary");
+    XCTAssert([[SchemaUniqueObject query] count] == 0, @"failed context commit was not rolled back");
+    
+}
+
+- (void)test_unique_index_over_duplicates_is_reported {
+    
+    [SharkORM rawQuery:@"DELETE FROM SchemaUniqueObject;"];
+    
+    // lose the unique index, and let duplicates in whilst it is missing
+    SRKRawResults* results = [SharkORM rawQuery:@"SELECT name FROM sqlite_master WHERE type='index' AND tbl_name='SchemaUniqueObject' AND sql LIKE 'CREATE UNIQUE INDEX%code%'"];
+    XCTAssert([results rowCount] == 1, @"unique properties were not backed by a unique index");
+    [SharkORM rawQuery:[NSString stringWithFormat:@"DROP INDEX %@;", [results valueForColumn:@"name" atRow:0]]];
+    [SharkORM rawQuery:@"INSERT INTO SchemaUniqueObject (Id, code) VALUES (1, 'D1');"];
+    [SharkORM rawQuery:@"INSERT INTO SchemaUniqueObject (Id, code) VALUES (2, 'D1');"];
+    
+    // re-opening the database puts the index back, which can not be done over the duplicates
+    self.currentError = nil;
+    [SharkORM closeDatabaseNamed:@"Persistence"];
+    [SharkORM openDatabaseNamed:@"Persistence"];
+    
+    XCTAssert(self.currentError != nil, @"failure to create the unique index was not reported");
+    
+    // once the duplicates are gone the index is created the next time the database is opened
+    [SharkORM rawQuery:@"DELETE FROM SchemaUniqueObject;"];
+    [SharkORM closeDatabaseNamed:@"Persistence"];
+    [SharkORM openDatabaseNamed:@"Persistence"];
+    
+    results = [SharkORM rawQuery:@"SELECT name FROM sqlite_master WHERE type='index' AND tbl_name='SchemaUniqueObject' AND sql LIKE 'CREATE UNIQUE INDEX%code%'"];
+    XCTAssert([results rowCount] == 1, @"unique index was not restored");
+    
+}
+
+- (void)test_upsert_on_unique_properties {
+    
+    [SharkORM rawQuery:@"DELETE FROM SchemaUniqueObject;"];
+    
+    SchemaUniqueObject* o1 = [SchemaUniqueObject new];
+    o1.code = @"U1";
+    o1.name = @"original";
+    XCTAssert([SchemaUniqueObject upsert:o1 onConflict:@[@"code"] update:@[@"name"]], @"upsert failed to insert a new row");
+    XCTAssert(o1.exists && o1.Id, @"inserted object was not given its primary key");
+    
+    SchemaUniqueObject* o2 = [SchemaUniqueObject new];
+    o2.code = @"U1";
+    o2.name = @"merged";
+    XCTAssert([SchemaUniqueObject upsert:o2 onConflict:@[@"code"] update:@[@"name"]], @"upsert failed to merge into an existing row");
+    XCTAssert([[SchemaUniqueObject query] count] == 1, @"upsert inserted a duplicate row");
+    XCTAssert([((SchemaUniqueObject*)[[SchemaUniqueObject query] fetch].firstObject).name isEqualToString:@"merged"], @"upsert did not update the existing row");
+    XCTAssert([o2.Id isEqual:o1.Id], @"merged object did not take the primary key of the existing row");
+    XCTAssert(!o2.dirty && o2.modifiedFieldNames.count == 0, @"merged object was left with changes to write");
+    
+    // a merge which does not update a property leaves the object holding the stored value rather than its own
+    SchemaUniqueObject* o6 = [SchemaUniqueObject new];
+    o6.code = @"U1";
+    o6.name = @"not stored";
+    XCTAssert([SchemaUniqueObject upsert:o6 onConflict:@[@"code"] update:@[]], @"upsert failed to leave an existing row alone");
+    XCTAssert([o6.name isEqualToString:@"merged"], @"merged object did not load the values held by the existing row");
+    XCTAssert(!o6.dirty, @"merged object was left with changes to write");
+    
+    // the merged object refers to the existing row, so committing it again must not insert a second one
+    o2.name = @"recommitted";
+    XCTAssert([o2 commit], @"failed to commit a merged object");
+    XCTAssert([[SchemaUniqueObject query] count] == 1, @"commit of a merged object inserted a duplicate row");
+    
+    // an upsert rolled back with its transaction leaves the object as it was
+    SchemaUniqueObject* o5 = [SchemaUniqueObject new];
+    o5.code = @"U9";
+    o5.name = @"rolled back";
+    [SRKTransaction transaction:^{
+        [SchemaUniqueObject upsert:o5 onConflict:@[@"code"] update:@[@"name"]];
+        SRKFailTransaction();
+    } withRollback:^{
+        
+    }];
+    XCTAssert(o5.Id == nil, @"upsert rolled back by the transaction left its primary key on the object");
+    XCTAssert([[SchemaUniqueObject query] count] == 1, @"upsert was not rolled back with the transaction");
+    
+    SchemaUniqueObject* o3 = [SchemaUniqueObject new];
+    o3.code = @"U1";
+    o3.name = @"ignored";
+    SchemaUniqueObject* o4 = [SchemaUniqueObject new];
+    o4.code = @"U2";
+    o4.name = @"second";
+    XCTAssert([SchemaUniqueObject upsertAll:@[o3, o4] onConflict:@[@"code"] update:@[@"name"] where:@"excluded.name != 'ignored'"], @"bulk upsert failed");
+    XCTAssert([[SchemaUniqueObject query] count] == 2, @"bulk upsert did not insert the new row");
+    XCTAssert([[[SchemaUniqueObject query] where:@"name = 'recommitted'"] count] == 1, @"conditional upsert overwrote the existing row");
+    
+    [SharkORM rawQuery:@"DELETE FROM SchemaUniqueObject;"];
+    
+}
+
+- (void)test_clustered_storage_without_prikey_index {
+    
+    // reference the objects to create the tables
+    SRKQuery* qry = [SchemaObject query];
+    qry = [SchemaClusteredObject query];
+    
+    SRKRawResults* results = [SharkORM rawQuery:@"SELECT * FROM sqlite_master WHERE type='index' AND name='idx_SchemaObject_prikey'"];
+    XCTAssert([results rowCount] == 0, @"redundant primary key index was created");
+    
+    results = [SharkORM rawQuery:@"SELECT * FROM sqlite_master WHERE type='table' AND name='SchemaClusteredObject' AND sql LIKE '%PRIMARY KEY (code)%WITHOUT ROWID%'"];
+    XCTAssert([results rowCount] == 1, @"clustered table was not created WITHOUT ROWID");
+    
+    results = [SharkORM rawQuery:@"SELECT * FROM sqlite_master WHERE type='index' AND tbl_name='SchemaClusteredObject' AND sql LIKE 'CREATE UNIQUE INDEX%(Id)%'"];
+    XCTAssert([results rowCount] == 1, @"Id of a table clustered on a natural key was not given a unique index");
+    
+    SchemaClusteredObject* o = [SchemaClusteredObject new];
+    o.code = @"C1";
+    o.name = @"clustered";
+    XCTAssert([o commit] && o.Id, @"failed to insert into a clustered table");
+    
+    o.name = @"updated";
+    XCTAssert([o commit], @"failed to update a clustered table");
+    
+    SchemaClusteredObject* o2 = [SchemaClusteredObject objectWithPrimaryKeyValue:o.Id];
+    XCTAssert([o2.name isEqualToString:@"updated"], @"failed to retrieve an object from a clustered table by its Id");
+    XCTAssert([[[SchemaClusteredObject query] where:@"code = 'C1'"] count] == 1, @"failed to retrieve an object from a clustered table by its key");
+    
+    // a new object with the same natural key has a different Id, so there is no row for it to update
+    SchemaClusteredObject* duplicate = [SchemaClusteredObject new];
+    duplicate.code = @"C1";
+    duplicate.name = @"duplicate";
+    duplicate.commitOptions.raiseErrors = NO;
+    XCTAssert(![duplicate commit] && !duplicate.exists, @"a duplicate natural key was reported as committed");
+    XCTAssert([((SchemaClusteredObject*)[[[SchemaClusteredObject query] where:@"code = 'C1'"] fetch].firstObject).name isEqualToString:@"updated"], @"a duplicate natural key overwrote the existing row");
+    
+    [SharkORM rawQuery:@"DELETE FROM SchemaClusteredObject;"];
+    
+}
+
+- (void)test_clustered_storage_refuses_virtual_indexes {
+    
+    self.currentError = nil;
+    SRKQuery* qry = [SchemaClusteredTextObject query];
+    qry = nil;
+    
+    XCTAssert(self.currentError != nil, @"full text index on a clustered table was not reported");
+    
+    SRKRawResults* results = [SharkORM rawQuery:@"SELECT * FROM sqlite_master WHERE name = 'SchemaClusteredTextObject_fts'"];
+    XCTAssert([results rowCount] == 0, @"full text index was created on a clustered table");
+    
+    SchemaClusteredTextObject* o = [SchemaClusteredTextObject new];
+    o.code = @"T1";
+    o.name = @"text";
+    XCTAssert([o commit], @"failed to insert into a clustered table that asked for a full text index");
+    
+    [SharkORM rawQuery:@"DELETE FROM SchemaClusteredTextObject;"];
+    
+}
+
+- (void)test_string_keys_refuse_virtual_indexes {
+    
+    self.currentError = nil;
+    SRKQuery* qry = [SchemaStringTextObject query];
+    qry = nil;
+    
+    XCTAssert(self.currentError != nil, @"full text index on a string keyed table was not reported");
+    
+    SRKRawResults* results = [SharkORM rawQuery:@"SELECT * FROM sqlite_master WHERE name = 'SchemaStringTextObject_fts'"];
+    XCTAssert([results rowCount] == 0, @"full text index was created on a string keyed table, whose rowid is not stable");
+    
+    SchemaStringTextObject* o = [SchemaStringTextObject new];
+    o.name = @"text";
+    XCTAssert([o commit], @"failed to insert into a string keyed table that asked for a full text index");
+    
+    [SharkORM rawQuery:@"DELETE FROM SchemaStringTextObject;"];
+    
+}
+
 @end
@@ -7,6 +7,12 @@
 
 #import "BaseTestCase.h"
 
+@interface TransactionCacheObject : SRKObject
+
+@property (strong) NSString* value;
+
+@end
+
 @interface Transactions : BaseTestCase
 
 @end
@@ -7,6 +7,16 @@
 
 #import "Transactions.h"
 
+@implementation TransactionCacheObject
+
+@dynamic value;
+
++ (NSString *)storageDatabaseForClass {
+    return @"TransactionCache";
+}
+
+@end
+
 @implementation Transactions
 
 - (void)test_Simple_Object_Insert {
@@ -865,6 +875,291 @@
     
 }
 
+- (void)test_nested_transaction_savepoints {
+    
+    [self cleardown];
+    
+    __block BOOL nestedRollback = NO;
+    __block BOOL outerRollback = NO;
+    
+    Person* p1 = [Person new];
+    p1.Name = @"Adrian";
+    [p1 commit];
+    
+    [SRKTransaction transaction:^{
+        
+        p1.Name = @"Sarah";
+        [p1 commit];
+        
+        [SRKTransaction transaction:^{
+            
+            p1.Name = @"Nested";
+            [p1 commit];
+            
+            Person* p2 = [Person new];
+            p2.Name = @"Failed";
+            [p2 commit];
+            
+            SRKFailTransaction();
+            
+        } withRollback:^{
+            nestedRollback = YES;
+        }];
+        
+        [SRKTransaction transaction:^{
+            
+            Person* p3 = [Person new];
+            p3.Name = @"Kept";
+            [p3 commit];
+            
+        } withRollback:^{
+            
+        }];
+        
+    } withRollback:^{
+        outerRollback = YES;
+    }];
+    
+    XCTAssert(nestedRollback, @"nested rollback block was not called");
+    XCTAssert(!outerRollback, @"a failed nested transaction rolled back the outer transaction");
+    XCTAssert([p1.Name isEqualToString:@"Sarah"], @"object was not restored to its value at the savepoint");
+    XCTAssert([[[Person query] where:@"Name = 'Sarah'"] count] == 1, @"outer transaction changes were lost");
+    XCTAssert([[[Person query] where:@"Name = 'Failed'"] count] == 0, @"failed nested transaction was committed");
+    XCTAssert([[[Person query] where:@"Name = 'Kept'"] count] == 1, @"successful nested transaction was not committed");
+    
+    [self cleardown];
+    
+}
+
+- (void)test_database_only_rollback {
+    
+    [self cleardown];
+    
+    Person* p1 = [Person new];
+    p1.Name = @"Adrian";
+    [p1 commit];
+    
+    [SRKTransaction transaction:^{
+        
+        p1.Name = @"Sarah";
+        [p1 commit];
+        
+        for (int i = 0; i < 100; i++) {
+            Person* p = [Person new];
+            p.Name = @"Bulk";
+            [p commit];
+        }
+        
+        SRKFailTransaction();
+        
+    } rollbackMode:SRKTransactionRollbackDatabaseOnly withRollback:^{
+        
+    }];
+    
+    XCTAssert([[[Person query] where:@"Name = 'Bulk'"] count] == 0, @"database changes were not rolled back");
+    XCTAssert([[[Person query] where:@"Name = 'Adrian'"] count] == 1, @"database changes were not rolled back");
+    XCTAssert([p1.Name isEqualToString:@"Sarah"], @"object values were restored in database only mode");
+    
+    [self cleardown];
+    
+}
+
+- (void)test_database_only_rollback_of_insert {
+    
+    [self cleardown];
+    
+    Person* p = [Person new];
+    p.Name = @"Adrian";
+    
+    [SRKTransaction transaction:^{
+        
+        [p commit];
+        SRKFailTransaction();
+        
+    } rollbackMode:SRKTransactionRollbackDatabaseOnly withRollback:^{
+        
+    }];
+    
+    XCTAssert([[Person query] count] == 0, @"insert was not rolled back");
+    XCTAssert(!p.exists && p.Id == nil, @"object still looked persisted after its insert was rolled back");
+    
+    // the object is new again, so a later commit inserts it
+    XCTAssert([p commit] && p.exists, @"failed to commit an object after its insert was rolled back");
+    XCTAssert([[Person query] count] == 1, @"object was not inserted after its insert was rolled back");
+    
+    [self cleardown];
+    
+}
 
+- (void)test_transaction_does_not_block_other_databases {
+    
+    [self cleardown];
+    
+    [SharkORM openDatabaseNamed:@"TransactionCache"];
+    [SharkORM rawQuery:@"DELETE FROM Person;"];
+    [[[TransactionCacheObject query] fetch] remove];
+    
+    dispatch_semaphore_t started = dispatch_semaphore_create(0);
+    dispatch_semaphore_t release = dispatch_semaphore_create(0);
+    dispatch_semaphore_t finished = dispatch_semaphore_create(0);
+    __block BOOL transactionOpen = NO;
+    
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        [SRKTransaction transaction:^{
+            Person* p = [Person new];
+            p.Name = @"Adrian";
+            [p commit];
+            transactionOpen = YES;
+            dispatch_semaphore_signal(started);
+            // hold the transaction on the Persistence database open, but never forever if the other database is blocked
+            dispatch_semaphore_wait(release, dispatch_time(DISPATCH_TIME_NOW, 5 * NSEC_PER_SEC));
+            transactionOpen = NO;
+        } withRollback:^{
+            
+        }];
+        dispatch_semaphore_signal(finished);
+    });
+    
+    dispatch_semaphore_wait(started, DISPATCH_TIME_FOREVER);
+    
+    TransactionCacheObject* c = [TransactionCacheObject new];
+    c.value = @"cached";
+    XCTAssert([c commit], @"failed to commit into another database whilst a transaction was open");
+    XCTAssert([[TransactionCacheObject query] count] == 1, @"failed to query another database whilst a transaction was open");
+    XCTAssert(transactionOpen, @"a transaction on one database blocked writes and reads on another");
+    
+    dispatch_semaphore_signal(release);
+    dispatch_semaphore_wait(finished, DISPATCH_TIME_FOREVER);
+    
+    // once the transaction has finished, its own database is available again
+    XCTAssert([[Person query] count] == 1, @"transaction was not committed");
+    
+    [[[TransactionCacheObject query] fetch] remove];
+    [SharkORM closeDatabaseNamed:@"TransactionCache"];
+    [self cleardown];
+    
+}
+
+- (void)test_group_commit_flush_within_transaction {
+    
+    [self cleardown];
+    
+    [SharkORM settings].groupCommitWindow = 5;
+    
+    [SRKTransaction transaction:^{
+        
+        Person* p = [Person new];
+        p.Name = @"Adrian";
+        [p commit];
+        
+        // queued by another thread, outside of this transaction
+        dispatch_sync(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            Person* queued = [Person new];
+            queued.Name = @"Queued";
+            [queued commit];
+        });
+        
+        // the remove flushes the group commit, which must neither wait on the transaction this thread is holding nor pull the queued object into it
+        [p remove];
+        
+        SRKFailTransaction();
+        
+    } withRollback:^{
+        
+    }];
+    
+    [SharkORM flush];
+    [SharkORM settings].groupCommitWindow = 0;
+    
+    XCTAssert([[[Person query] where:@"Name = 'Adrian'"] count] == 0, @"transaction was not rolled back");
+    XCTAssert([[[Person query] where:@"Name = 'Queued'"] count] == 1, @"queued object was rolled back with a transaction it was not part of");
+    
+    [self cleardown];
+    
+}
+
+- (void)test_exception_within_transaction_releases_database {
+    
+    [self cleardown];
+    
+    @try {
+        [SRKTransaction transaction:^{
+            Person* p = [Person new];
+            p.Name = @"Adrian";
+            [p commit];
+            @throw [NSException exceptionWithName:@"TransactionTest" reason:@"thrown within a transaction" userInfo:nil];
+        } withRollback:^{
+            
+        }];
+    } @catch (NSException* exception) {
+        
+    }
+    
+    XCTAssert([[Person query] count] == 0, @"changes made before the exception were not rolled back");
+    
+    // another thread must be able to write to the database once the transaction has gone
+    dispatch_semaphore_t written = dispatch_semaphore_create(0);
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        Person* p = [Person new];
+        p.Name = @"Neil";
+        [p commit];
+        dispatch_semaphore_signal(written);
+    });
+    
+    XCTAssert(dispatch_semaphore_wait(written, dispatch_time(DISPATCH_TIME_NOW, 5 * NSEC_PER_SEC)) == 0, @"database was left locked by the failed transaction");
+    XCTAssert([[Person query] count] == 1, @"write after the failed transaction was lost");
+    
+    [self cleardown];
+    
+}
+
+- (void)test_exception_within_nested_transaction_unwinds_savepoint {
+    
+    [self cleardown];
+    
+    __block BOOL outerRollback = NO;
+    __block Person* thrown = nil;
+    
+    [SRKTransaction transaction:^{
+        
+        Person* p = [Person new];
+        p.Name = @"Outer";
+        [p commit];
+        
+        @try {
+            [SRKTransaction transaction:^{
+                thrown = [Person new];
+                thrown.Name = @"Thrown";
+                [thrown commit];
+                @throw [NSException exceptionWithName:@"TransactionTest" reason:@"thrown within a nested transaction" userInfo:nil];
+            } withRollback:^{
+                
+            }];
+        } @catch (NSException* exception) {
+            
+        }
+        
+        // the savepoint was unwound, so the next nested transaction is opened at the same depth and can still be committed
+        [SRKTransaction transaction:^{
+            Person* kept = [Person new];
+            kept.Name = @"Kept";
+            [kept commit];
+        } withRollback:^{
+            
+        }];
+        
+    } withRollback:^{
+        outerRollback = YES;
+    }];
+    
+    XCTAssert(!outerRollback, @"an exception caught within the outer transaction rolled it back");
+    XCTAssert([[[Person query] where:@"Name = 'Thrown'"] count] == 0, @"changes made before the exception in the nested transaction were committed");
+    XCTAssert([[[Person query] where:@"Name = 'Outer'"] count] == 1, @"outer transaction was not committed");
+    XCTAssert([[[Person query] where:@"Name = 'Kept'"] count] == 1, @"nested transaction after the exception was not committed");
+    XCTAssert(!thrown.exists && !thrown.Id, @"object written before the exception was not restored");
+    
+    [self cleardown];
+    
+}
 
 @end